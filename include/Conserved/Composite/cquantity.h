@@ -189,6 +189,13 @@ class any_quantity final
 	// friend bool operator!=(any_quantity_cref lhs, any_quantity_cref rhs);
 };
 inline any_quantity any_quantity::neutral() const { return any_quantity(impl->neutral()); }
+/**
+ * @brief rebuild a conserved quantity from its type_tag and the values written by vquantity::serialize.
+ *
+ * @param group_count number of values to read, checked against the number of groups of the type.
+ * Throws std::invalid_argument if no quantity type with this tag is known.
+ */
+any_quantity make_quantity(const std::string &tag, const int64_t *values, size_t group_count);
 /**
  * @brief compute the squared "distance" between two conserved quantities. 
  * 
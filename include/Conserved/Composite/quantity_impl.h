@@ -20,7 +20,10 @@
 #include <fmt/ranges.h>
 #include <ios>
 #include <memory>
+#include <stdexcept>
+#include <string>
 #include <type_traits>
+#include <utility>
 #include <vector>
 
 namespace quantit
@@ -92,6 +95,15 @@ class vquantity
 	virtual auto format_to(fmt::format_context &ctx) const -> decltype(ctx.out()) = 0;
 	virtual double distance(const vquantity &) const = 0;
 	virtual int64_t distance2(const vquantity &) const = 0;
+	/**
+	 * @brief identifier of the concrete type, the tags of its groups separated by commas.
+	 * Empty when one of the groups doesn't specialize conserved::group_serializer.
+	 */
+	virtual std::string type_tag() const = 0;
+	/**
+	 * @brief append the value of each group to out, in order.
+	 */
+	virtual void serialize(std::vector<int64_t> &out) const = 0;
 	virtual ~vquantity() {}
 
   protected:
@@ -107,6 +119,13 @@ inline bool operator!=(const vquantity &left, const vquantity &right) { return l
 inline bool operator<(const vquantity &left, const vquantity &right) { return left.is_lesser(right); }
 inline bool operator>(const vquantity &left, const vquantity &right) { return left.is_greater(right); }
 
+using quantity_factory = std::unique_ptr<vquantity> (*)(const int64_t *values);
+/**
+ * @brief make a concrete quantity type known to make_quantity, under the given tag.
+ * Every quantity whose groups are all storable registers itself, this need not be called explicitly.
+ */
+bool register_quantity_type(const std::string &tag, quantity_factory factory, size_t group_count);
+
 /**
  * @brief template implementation of the concrete composite group types.
  * This template of class is used by the type any_quantity, any_quantity_ref and any_quantity_cref
@@ -166,6 +185,12 @@ class quantity final : public vquantity
 	double distance(const quantity &) const;
 	int64_t distance2(const vquantity &) const override;
 	int64_t distance2(const quantity &) const;
+	std::string type_tag() const override;
+	void serialize(std::vector<int64_t> &out) const override;
+	/**
+	 * @brief build a quantity from the values written by serialize.
+	 */
+	static std::unique_ptr<vquantity> deserialize(const int64_t *values);
 	friend struct fmt::formatter<quantit::quantity<Groups...>>;
 	auto format_to(fmt::format_context &ctx) const -> decltype(ctx.out()) override
 	{
@@ -180,7 +205,60 @@ class quantity final : public vquantity
 	 *
 	 */
 	std::tuple<Groups...> val;
+
+	static std::string tag();
+	template <size_t... I>
+	static std::unique_ptr<vquantity> deserialize_impl(const int64_t *values, std::index_sequence<I...>);
+	static bool register_type();
+	static const bool registered;
 };
+template <class... T>
+std::string quantity<T...>::tag()
+{
+	std::string out;
+	if constexpr (conserved::all_serializable_v<T...>)
+		((out += (out.empty() ? "" : ",") + conserved::group_serializer<T>::tag()), ...);
+	return out;
+}
+template <class... T>
+std::string quantity<T...>::type_tag() const
+{
+	(void)registered; // odr-use, so that every instantiated type is known to make_quantity.
+	return tag();
+}
+template <class... T>
+void quantity<T...>::serialize(std::vector<int64_t> &out) const
+{
+	if constexpr (conserved::all_serializable_v<T...>)
+		for_each(val, [&out](auto &&vl)
+		         { out.push_back(conserved::group_serializer<std::decay_t<decltype(vl)>>::value(vl)); });
+	else
+		throw std::logic_error("this quantity has a group without a specialization of conserved::group_serializer");
+}
+template <class... T>
+template <size_t... I>
+std::unique_ptr<vquantity> quantity<T...>::deserialize_impl(const int64_t *values, std::index_sequence<I...>)
+{
+	return std::make_unique<quantity<T...>>(conserved::group_serializer<T>::make(values[I])...);
+}
+template <class... T>
+std::unique_ptr<vquantity> quantity<T...>::deserialize(const int64_t *values)
+{
+	if constexpr (conserved::all_serializable_v<T...>)
+		return deserialize_impl(values, std::index_sequence_for<T...>{});
+	else
+		throw std::logic_error("this quantity has a group without a specialization of conserved::group_serializer");
+}
+template <class... T>
+bool quantity<T...>::register_type()
+{
+	if constexpr (conserved::all_serializable_v<T...>)
+		return register_quantity_type(tag(), &quantity<T...>::deserialize, sizeof...(T));
+	else
+		return false;
+}
+template <class... T>
+const bool quantity<T...>::registered = quantity<T...>::register_type();
 template <class... Qts>
 bool quantity<Qts...>::same_type(const vquantity &other) const
 { // dynamic cast on pointers return a null pointer which convert to false when the types are incompatible.
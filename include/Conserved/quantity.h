@@ -19,6 +19,7 @@
 #include <fmt/core.h>
 #include <fmt/format.h>
 #include <ostream>
+#include <string>
 
 #include "doctest/doctest_proxy.h"
 namespace quantit
@@ -259,6 +260,23 @@ void swap(C<N> &lhs, C<N> &rhs) noexcept
 	lhs.swap(rhs);
 }
 
+template <uint16_t N>
+struct group_serializer<C<N>>
+{
+	static constexpr bool supported = true;
+	static std::string tag() { return fmt::format("C{}", N); }
+	static int64_t value(C<N> grp) { return grp.get_val(); }
+	static C<N> make(int64_t value) { return C<N>(static_cast<int16_t>(value)); }
+};
+template <>
+struct group_serializer<Z>
+{
+	static constexpr bool supported = true;
+	static std::string tag() { return "Z"; }
+	static int64_t value(Z grp) { return grp.get_val(); }
+	static Z make(int64_t value) { return Z(static_cast<int16_t>(value)); }
+};
+
 // using is_conversed_QuantiT =     and_<default_to_neutral<T>, has_op<T>, has_inverse_<T>,
 //         has_comparatorequal<T>, has_comparatornotequal<T>, is_Abelian<T>>;
 static_assert(has_constexpr_equal<Z>::value, "debug");
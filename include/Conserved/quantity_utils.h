@@ -155,6 +155,20 @@ using all_conserved_QuantiT = and_<is_conserved_QuantiT<T>...>;
 template <class... T>
 constexpr bool all_group_v = all_conserved_QuantiT<T...>::value;
 
+/**
+ * @brief conversion of a group to and from an integer, used to store the conserved quantities in checkpoint files.
+ *
+ * Specialize it for your group to make it storable: supported must be true, tag() must identify the group uniquely,
+ * value(grp) and make(value) must be inverse of each other. See QuantiT/Conserved/quantity.h for C<N> and Z.
+ */
+template <class T>
+struct group_serializer
+{
+	static constexpr bool supported = false;
+};
+template <class... T>
+constexpr bool all_serializable_v = (group_serializer<T>::supported && ...);
+
 #if __cplusplus == 202002L
 template <class T>
 concept a_group = is_conserved_QuantiT_v<T>;
@@ -0,0 +1,138 @@
+/*
+ * File: MPO_apply.h
+ * Project: QuantiT
+ * File Created: Sunday, 18th October 2026 6:40:31 pm
+ * Author: Alexandre Foley (Alexandre.foley@usherbrooke.ca)
+ * Copyright (c) 2026 Alexandre Foley
+ * Licensed under GPL v3
+ */
+
+#ifndef INCLUDE_MPO_APPLY_H
+#define INCLUDE_MPO_APPLY_H
+
+#include "MPT.h"
+#include <limits>
+#include <torch/torch.h>
+
+#include "doctest/doctest_proxy.h"
+
+namespace quantit
+{
+
+/**
+ * @brief Product of a MPO with a MPS, truncated while it is computed by the zip-up algorithm.
+ *
+ * The state is brought in right canonical form, then the MPO and the state are contracted one site at a time from
+ * left to right. The combined bond of each site is truncated by a singular value decomposition before the next site is
+ * contracted, such that the untruncated product is never formed. The output is not normalized and its orthogonality
+ * center is on the last site.
+ *
+ * @param op the operator
+ * @param state the state, left unchanged
+ * @param tol the sum of the squared singular values discarded on each bond is at most tol squared, as with svd.
+ * @param max_bond maximum bond dimension of the output
+ */
+MPS zip_up(const MPO &op, const MPS &state, double tol, size_t max_bond = std::numeric_limits<size_t>::max());
+bMPS zip_up(const bMPO &op, const bMPS &state, double tol, size_t max_bond = std::numeric_limits<size_t>::max());
+
+/**
+ * @brief Product of a MPO with a MPS, optimized variationally at fixed maximum bond dimension.
+ *
+ * Starts from the zip-up product, then sweeps two-site updates that maximize the overlap of the output with the exact
+ * product. The environments of the overlap are kept in the same layout as the dmrg environments, with the output as
+ * the bra and the input state as the ket. The sweeps stop when the squared norm of the output changes by less than
+ * convergence relative to its value, it is the missing weight of the exact product that changes. The output has its
+ * orthogonality center on the first site.
+ *
+ * @param tol the sum of the squared singular values discarded on each bond is at most tol squared, as with svd.
+ * @param max_bond maximum bond dimension of the output
+ * @param max_sweeps maximum number of back and forth sweeps
+ * @param convergence relative change of the squared norm of the output that stops the sweeps
+ */
+MPS variational_apply(const MPO &op, const MPS &state, double tol,
+                      size_t max_bond = std::numeric_limits<size_t>::max(), size_t max_sweeps = 4,
+                      double convergence = 1e-10);
+bMPS variational_apply(const bMPO &op, const bMPS &state, double tol,
+                       size_t max_bond = std::numeric_limits<size_t>::max(), size_t max_sweeps = 4,
+                       double convergence = 1e-10);
+
+/**
+ * @brief <state|op op|state>, without forming the MPO of op op.
+ *
+ * The environments carry the bond of both copies of the MPO, their size is the square of the MPO bond dimension times
+ * the square of the state's. Equivalent to the squared norm of zip_up(op,state,0), whose cost is dominated by the
+ * singular value decomposition of the product with the untruncated bond.
+ */
+torch::Tensor expectation_squared(const MPO &op, const MPS &state);
+btensor expectation_squared(const bMPO &op, const bMPS &state);
+/**
+ * @brief Energy variance <H^2> - <H>^2 of the state, normalized by its norm.
+ */
+torch::Tensor energy_variance(const MPO &hamil, const MPS &state);
+btensor energy_variance(const bMPO &hamil, const bMPS &state);
+
+qtt_TEST_CASE("MPO MPS product")
+{
+	constexpr int64_t L = 6;
+	auto T = torch::rand({3, 2, 3, 2}, torch::kFloat64);
+	MPO H(L, T);
+	{
+		using namespace torch::indexing;
+		H[0] = H[0].index({Slice(0, 1), Ellipsis});
+		H[L - 1] = H[L - 1].index({Ellipsis, Slice(0, 1), Slice()});
+	}
+	auto state = random_MPS(4, H, torch::kFloat64);
+	auto probe = random_MPS(3, H, torch::kFloat64);
+	auto exact = zip_up(H, state, 0);
+	qtt_REQUIRE(exact.check_ranks());
+	// <probe|H|state> from the product and from the MPO directly
+	qtt_CHECK(torch::allclose(contract(exact, probe), contract(state, probe, H)));
+	auto exact_norm = contract(exact, exact);
+	qtt_CHECK(torch::allclose(exact_norm, contract(state, exact, H)));
+	// squared distance to the exact product.
+	auto distance = [&](const MPS &approx)
+	{ return (contract(approx, approx) - 2 * contract(approx, exact) + exact_norm).item().toDouble(); };
+	qtt_SUBCASE("truncated")
+	{
+		auto zipped = zip_up(H, state, 0, 3);
+		auto fitted = variational_apply(H, state, 0, 3);
+		qtt_REQUIRE(fitted.check_ranks());
+		for (int64_t i = 0; i < L; ++i)
+		{
+			qtt_CHECK(zipped[i].sizes()[2] <= 3);
+			qtt_CHECK(fitted[i].sizes()[2] <= 3);
+		}
+		qtt_CHECK(distance(fitted) <= distance(zipped) + 1e-10 * exact_norm.item().toDouble());
+	}
+	qtt_SUBCASE("squared operator")
+	{
+		// <state|H H|state>, H isn't hermitian.
+		qtt_CHECK(torch::allclose(expectation_squared(H, state), contract(exact, state, H)));
+	}
+	qtt_SUBCASE("untruncated fit")
+	{
+		auto fitted = variational_apply(H, state, 0);
+		qtt_CHECK(std::abs(distance(fitted)) <= 1e-8 * exact_norm.item().toDouble());
+	}
+}
+qtt_TEST_CASE("block MPO MPS product")
+{
+	using cval = quantity<conserved::Z>;
+	constexpr int64_t L = 6;
+	auto H = details::random_Z_bMPO(L, torch::kFloat64);
+	// a charged state, the edges of the environments of H H|state> carry its charge.
+	auto state = random_MPS(4, H, cval(2), torch::kFloat64);
+	auto exact = zip_up(H, state, 0);
+	qtt_REQUIRE(exact.check_ranks());
+	auto norm = contract(state, state).item().toDouble();
+	auto E = contract(state, state, H).item().toDouble() / norm;
+	// <state|H H|state>, H isn't hermitian.
+	auto squared = contract(exact, state, H).item().toDouble();
+	qtt_CHECK(expectation_squared(H, state).item().toDouble() == doctest::Approx(squared).epsilon(1e-10));
+	qtt_CHECK(energy_variance(H, state).item().toDouble() ==
+	          doctest::Approx(squared / norm - E * E).epsilon(1e-8).scale(E * E));
+}
+
+} // namespace quantit
+
+#endif // INCLUDE_MPO_APPLY_H
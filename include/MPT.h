@@ -18,6 +18,8 @@
 #include "property.h"
 #include <algorithm>
 #include <fmt/core.h>
+#include <limits>
+#include <optional>
 #include <random>
 #include <torch/torch.h>
 #include <type_traits>
@@ -39,6 +41,7 @@ class MPT;
 class bMPS;
 class bMPO;
 class bMPT;
+class sparse_MPO;
 
 MPS random_MPS(size_t length, size_t bond_dim, size_t phys_dim, torch::TensorOptions opt = {});
 MPS random_MPS(size_t bond_dim, const MPO &hamil, torch::TensorOptions opt = {});
@@ -74,8 +77,12 @@ namespace details
  */
 torch::Tensor dmrg_impl(const MPO &hamiltonian, const MPT &two_sites_hamil, MPS &in_out_state,
                         const dmrg_options &options, env_holder &Env, dmrg_logger &logger);
+torch::Tensor dmrg_impl(const sparse_MPO &hamiltonian, MPS &in_out_state, const dmrg_options &options, env_holder &Env,
+                        dmrg_logger &logger);
+// first_iteration and previous_energy continue the sweeps of a checkpoint, see dmrg_resume.
 btensor dmrg_impl(const bMPO &hamiltonian, const bMPT &two_sites_hamil, bMPS &in_out_state, const dmrg_options &options,
-                  benv_holder &Env, dmrg_logger &logger);
+                  benv_holder &Env, dmrg_logger &logger, size_t first_iteration = 0,
+                  std::optional<btensor> previous_energy = std::nullopt);
 } // namespace details
 // matrix product tensors base type. require concrete derived class to implement MPT empty_copy(const S&)
 /**
@@ -398,6 +405,8 @@ class MPS final
 	friend torch::Tensor details::dmrg_impl(const MPO &hamiltonian, const MPT &twosites_hamil, MPS &in_out_state,
 	                                        const dmrg_options &options, env_holder &Env,
 	                                        dmrg_logger &logger); // allow dmrg to manipulate the oc.
+	friend torch::Tensor details::dmrg_impl(const sparse_MPO &hamiltonian, MPS &in_out_state,
+	                                        const dmrg_options &options, env_holder &Env, dmrg_logger &logger);
 	static MPS empty_copy(const MPS &in) { return MPS(in.size(), in.oc); }
 
   private:
@@ -529,8 +538,16 @@ class bMPS final : public vector_lift<bMPS, btensor> // specialization for rank
 	bMPS() : vector_lift<bMPS, btensor>(), orthogonality_center(0) {}
 	bMPS(size_type size) : vector_lift<bMPS, btensor>(size), orthogonality_center(0) {}
 	bMPS(size_type size, size_t oc) : vector_lift<bMPS, btensor>(size), orthogonality_center(std::min(oc, size - 1)) {}
-	bMPS(const bMPS &other) : vector_lift(other), orthogonality_center(other.orthogonality_center) {}
-	bMPS(bMPS &&other) noexcept : vector_lift(std::move(other)), orthogonality_center(other.orthogonality_center) {}
+	bMPS(const bMPS &other)
+	    : vector_lift(other), orthogonality_center(other.orthogonality_center), spectra(other.spectra),
+	      in_gauge(other.in_gauge), keep(other.keep)
+	{
+	}
+	bMPS(bMPS &&other) noexcept
+	    : vector_lift(std::move(other)), orthogonality_center(other.orthogonality_center),
+	      spectra(std::move(other.spectra)), in_gauge(std::move(other.in_gauge)), keep(other.keep)
+	{
+	}
 	bMPS(std::vector<Tens> initl, size_t oc = 0)
 	    : vector_lift<bMPS, btensor>(std::move(initl)), orthogonality_center(oc)
 	{
@@ -588,6 +605,9 @@ class bMPS final : public vector_lift<bMPS, btensor> // specialization for rank
 		vector_lift<bMPS, btensor>::swap(other);
 		using std::swap;
 		swap(other.orthogonality_center.value, orthogonality_center.value);
+		swap(other.spectra, spectra);
+		swap(other.in_gauge, in_gauge);
+		swap(other.keep, keep);
 	}
 
 	bMPS &operator=(bMPS other)
@@ -607,16 +627,223 @@ class bMPS final : public vector_lift<bMPS, btensor> // specialization for rank
 
 	/**
 	 * move the orthogonality center to the position i on the chain.
+	 *
+	 * When the spectra are kept, a bond whose spectrum was computed with the current tensors of its two sites is
+	 * crossed by multiplying the tensors with the spectrum and its inverse, without singular value decomposition.
 	 */
 	void move_oc(int i);
 	friend btensor details::dmrg_impl(const bMPO &hamiltonian, const bMPT &two_sites_hamil, bMPS &in_out_state,
-	                                  const dmrg_options &options, benv_holder &Env,
-	                                  dmrg_logger &logger); // allow dmrg to manipulate the oc.
-	static bMPS empty_copy(const bMPS &in) { return bMPS(in.size(), in.oc); }
+	                                  const dmrg_options &options, benv_holder &Env, dmrg_logger &logger,
+	                                  size_t first_iteration,
+	                                  std::optional<btensor> previous_energy); // allow dmrg to manipulate the oc.
+	static bMPS empty_copy(const bMPS &in)
+	{
+		bMPS out(in.size(), in.oc);
+		out.keep_spectra(in.keep);
+		return out;
+	}
+
+	/**
+	 * @brief keep the singular values of the bonds computed by move_oc and dmrg, such that the entanglement can be read
+	 * without decomposition.
+	 *
+	 * The spectrum of bond i is between the sites i and i+1. A non-const access to a tensor discards the spectra of its
+	 * two bonds, an iterator or a change of the length of the chain discards all of them. The algorithms that replace
+	 * the tensors of a bond with assign_bond keep the spectra of the other bonds, they are those of the last time the
+	 * bond was decomposed. Disabling discards the spectra.
+	 */
+	void keep_spectra(bool enable = true);
+	bool keeps_spectra() const { return keep; }
+	/**
+	 * @brief singular values of the bond between the sites bond and bond+1, nullopt if they aren't known.
+	 */
+	const std::optional<btensor> &spectrum(size_t bond) const;
+	/**
+	 * @brief replace the tensors of the sites bond and bond+1, with the singular values of their bond.
+	 *
+	 * Doesn't move the orthogonality center. The caller is responsible for the canonical form: left is left canonical
+	 * times the spectrum and right is right canonical, or left is left canonical and right is the spectrum times right
+	 * canonical.
+	 */
+	void assign_bond(size_t bond, Tens left, Tens right, Tens values);
+	/**
+	 * @brief inplace conversion of the tensors, the kept spectra are converted along with them and stay usable by
+	 * move_oc.
+	 */
+	template <class... Args>
+	bMPS &to_(Args &&...args)
+	{
+		vector_lift::to_(args...);
+		for (auto &values : spectra)
+			if (values)
+				values = values->to(args...);
+		return *this;
+	}
+
+	// Non-const access to the tensors, the spectra of the affected bonds are discarded.
+	using vector_lift<bMPS, btensor>::operator[];
+	using vector_lift<bMPS, btensor>::at;
+	using vector_lift<bMPS, btensor>::front;
+	using vector_lift<bMPS, btensor>::back;
+	using vector_lift<bMPS, btensor>::data;
+	using vector_lift<bMPS, btensor>::begin;
+	using vector_lift<bMPS, btensor>::end;
+	using vector_lift<bMPS, btensor>::rbegin;
+	using vector_lift<bMPS, btensor>::rend;
+	reference operator[](size_t i)
+	{
+		discard_spectra(i);
+		return vector_lift::operator[](i);
+	}
+	reference at(size_t i)
+	{
+		discard_spectra(i);
+		return vector_lift::at(i);
+	}
+	reference front()
+	{
+		discard_spectra(0);
+		return vector_lift::front();
+	}
+	reference back()
+	{
+		discard_spectra(size() - 1);
+		return vector_lift::back();
+	}
+	Tens *data() noexcept
+	{
+		reset_spectra();
+		return vector_lift::data();
+	}
+	iterator begin() noexcept
+	{
+		reset_spectra();
+		return vector_lift::begin();
+	}
+	iterator end() noexcept
+	{
+		reset_spectra();
+		return vector_lift::end();
+	}
+	reverse_iterator rbegin() noexcept
+	{
+		reset_spectra();
+		return vector_lift::rbegin();
+	}
+	reverse_iterator rend() noexcept
+	{
+		reset_spectra();
+		return vector_lift::rend();
+	}
+	// modifiers of the length of the chain.
+	void clear() noexcept
+	{
+		vector_lift::clear();
+		reset_spectra();
+	}
+	iterator insert(const_iterator pos, const Tens &val)
+	{
+		auto out = vector_lift::insert(pos, val);
+		reset_spectra();
+		return out;
+	}
+	iterator insert(const_iterator pos, Tens &&val)
+	{
+		auto out = vector_lift::insert(pos, std::move(val));
+		reset_spectra();
+		return out;
+	}
+	iterator insert(const_iterator pos, size_type count, Tens &&val)
+	{
+		auto out = vector_lift::insert(pos, count, std::move(val));
+		reset_spectra();
+		return out;
+	}
+	template <class InputIT>
+	iterator insert(const_iterator pos, InputIT first, InputIT last)
+	{
+		auto out = vector_lift::insert(pos, first, last);
+		reset_spectra();
+		return out;
+	}
+	iterator insert(const_iterator pos, std::initializer_list<Tens> list)
+	{
+		auto out = vector_lift::insert(pos, list);
+		reset_spectra();
+		return out;
+	}
+	template <class... Args>
+	iterator emplace(const_iterator pos, Args &&...args)
+	{
+		auto out = vector_lift::emplace(pos, std::forward<Args>(args)...);
+		reset_spectra();
+		return out;
+	}
+	iterator erase(const_iterator pos)
+	{
+		auto out = vector_lift::erase(pos);
+		reset_spectra();
+		return out;
+	}
+	iterator erase(const_iterator first, const_iterator last)
+	{
+		auto out = vector_lift::erase(first, last);
+		reset_spectra();
+		return out;
+	}
+	void push_back(const Tens &val)
+	{
+		vector_lift::push_back(val);
+		reset_spectra();
+	}
+	void push_back(Tens &&val)
+	{
+		vector_lift::push_back(std::move(val));
+		reset_spectra();
+	}
+	template <class... Args>
+	auto emplace_back(Args &&...args)
+	{
+		vector_lift::emplace_back(std::forward<Args>(args)...);
+		reset_spectra();
+		return vector_lift::back();
+	}
+	void pop_back()
+	{
+		vector_lift::pop_back();
+		reset_spectra();
+	}
+	void resize(size_type count)
+	{
+		vector_lift::resize(count);
+		reset_spectra();
+	}
+	void resize(size_type count, const Tens &value)
+	{
+		vector_lift::resize(count, value);
+		reset_spectra();
+	}
 
   private:
 	size_t &oc = orthogonality_center.value; // private direct access to the value variable.
+	/**
+	 * spectra[i] holds the singular values of the bond between the sites i and i+1, empty unless the spectra are kept.
+	 * in_gauge[i] is true when they were computed with the current tensors of the sites i and i+1.
+	 */
+	std::vector<std::optional<btensor>> spectra;
+	std::vector<bool> in_gauge;
+	bool keep = false;
+	void reset_spectra();
+	void discard_spectra(size_t site);
+	void record_spectrum(size_t bond, Tens values);
+	bool move_with_spectrum(size_t bond, int step);
 };
+/**
+ * @brief von Neumann entanglement entropy of the bond between the sites bond and bond+1, from the kept spectrum.
+ *
+ * Throws std::logic_error if the spectrum of the bond isn't known, see bMPS::keep_spectra.
+ */
+double entanglement_entropy(const bMPS &state, size_t bond);
 inline void swap(bMPS &lhs, bMPS &rhs) { lhs.swap(rhs); }
 
 /**
@@ -726,6 +953,81 @@ btensor contract(const bMPS &a, const bMPS &b, const bMPO &obs, btensor left_edg
 btensor contract(const bMPS &a, const bMPS &b, btensor left_edge, const btensor &right_edge);
 btensor contract(const bMPS &a, const bMPS &b);
 
+/**
+ * @brief order in which the sites of a chain are contracted.
+ *
+ * sequential: fold the sites from left to right into the left edge, each step depends on the previous one.
+ * tree: form the transfer matrix of every site, then multiply neighbouring transfer matrices pairwise in a balanced
+ * binary tree. The products of a level of the tree are independent and computed in parallel on torch's intra-op thread
+ * pool. The transfer matrix is the square of the environment, a product of two of them costs about the cube of the
+ * environment's size: the tree order only pays off for long chains of small bond dimension.
+ * automatic: choose the order with the smallest estimated time, given the bond dimensions and the number of threads.
+ */
+enum class contraction_order
+{
+	sequential,
+	tree,
+	automatic
+};
+torch::Tensor contract(const MPS &a, const MPS &b, const MPO &obs, contraction_order order);
+torch::Tensor contract(const MPS &a, const MPS &b, contraction_order order);
+btensor contract(const bMPS &a, const bMPS &b, const bMPO &obs, contraction_order order);
+btensor contract(const bMPS &a, const bMPS &b, contraction_order order);
+
+/**
+ * @brief Reduce the bond dimension of a MPO with canonicalizing SVD sweeps.
+ *
+ * A left to right sweep brings the MPO in left canonical form, then a right to left sweep truncates every bond. In
+ * canonical form, the singular values of a bond are those of the whole operator: the weight of the discarded singular
+ * values on each bond is at most tol times the square of the Frobenius norm of the operator. The block svd preserves the
+ * conserved quantities of the bonds.
+ *
+ * @param hamil MPO to compress in place
+ * @param tol relative truncation error tolerated on each bond
+ * @param max_bond maximum bond dimension
+ */
+MPO &compress(MPO &hamil, double tol, size_t max_bond = std::numeric_limits<size_t>::max());
+bMPO &compress(bMPO &hamil, double tol, size_t max_bond = std::numeric_limits<size_t>::max());
+
+namespace details
+{
+/**
+ * @brief Random MPO conserving a Z charge, with a physical index of charges +1 and -1, for the tests.
+ *
+ * The MPO isn't hermitian. Its edges are restricted to their first element, such that it is a valid operator for a
+ * finite chain.
+ */
+inline bMPO random_Z_bMPO(size_t length, torch::TensorOptions opt = {})
+{
+	using cval = quantity<conserved::Z>;
+	auto T = quantit::rand({{{1, cval(1)}, {1, cval(-1)}},
+	                        {{3, cval(-1)}, {2, cval(1)}},
+	                        {{1, cval(-1)}, {1, cval(1)}},
+	                        {{3, cval(1)}, {2, cval(-1)}}},
+	                       cval(0), opt);
+	bMPO out(length, T);
+	out[0] = out[0].basic_create_view({0, -1, -1, -1}, true);
+	out[length - 1] = out[length - 1].basic_create_view({-1, -1, 0, -1}, true);
+	return out;
+}
+/**
+ * @brief Conserved quantity of a block MPS: the product of the physical quantities, in the convention of random_MPS.
+ *
+ * The bond quantities cancel between neighbouring sites, what remains are the selection rules and the edges.
+ */
+inline any_quantity total_quantity(const bMPS &state)
+{
+	any_quantity out = state.front().section_conserved_qtt(0, 0).inverse() *
+	                   state.back().section_conserved_qtt(2, 0).inverse();
+	for (const auto &site : state)
+	{
+		any_quantity_cref sel = site.selection_rule;
+		out *= sel;
+	}
+	return out;
+}
+} // namespace details
+
 qtt_TEST_CASE("MPT manipulations")
 {
 	MPT amps({torch::rand({1, 2, 3}), torch::rand({3, 2, 6}), torch::rand({6, 2, 4})});
@@ -821,6 +1123,124 @@ qtt_TEST_CASE("MPO basic manipulation")
 		}
 	}
 }
+qtt_TEST_CASE("MPO compression")
+{
+	constexpr int64_t L = 4;
+	auto T = torch::rand({3, 2, 3, 2}, torch::kFloat64);
+	MPO H(L, T);
+	{
+		using namespace torch::indexing;
+		H[0] = H[0].index({Slice(0, 1), Ellipsis});
+		H[L - 1] = H[L - 1].index({Ellipsis, Slice(0, 1), Slice()});
+	}
+	// direct sum of H with itself: 2H with a redundant bond dimension of 6.
+	MPO doubled(L);
+	doubled[0] = torch::cat({H[0], H[0]}, 2);
+	doubled[L - 1] = torch::cat({H[L - 1], H[L - 1]}, 0);
+	for (int64_t i = 1; i < L - 1; ++i)
+	{
+		using namespace torch::indexing;
+		doubled[i] = torch::zeros({6, 2, 6, 2}, torch::kFloat64);
+		doubled[i].index_put_({Slice(0, 3), Slice(), Slice(0, 3), Slice()}, H[i]);
+		doubled[i].index_put_({Slice(3, 6), Slice(), Slice(3, 6), Slice()}, H[i]);
+	}
+	auto state = random_MPS(4, H, torch::kFloat64);
+	auto E = contract(state, state, H);
+	qtt_REQUIRE_NOTHROW(compress(doubled, 1e-14));
+	qtt_CHECK(doubled.check_ranks());
+	for (int64_t i = 1; i < L; ++i)
+		qtt_CHECK(doubled[i].sizes()[0] <= 3);
+	qtt_CHECK(torch::allclose(contract(state, state, doubled), 2 * E));
+	// dense operator, with indices (wl, s'0, s0, s'1, s1, ..., wr, sL-1).
+	auto to_dense = [](const MPO &O)
+	{
+		auto out = O[0];
+		for (size_t i = 1; i < O.size(); ++i)
+			out = torch::tensordot(out, O[i], {-2}, {0});
+		return out;
+	};
+	qtt_SUBCASE("tolerance")
+	{
+		auto exact = to_dense(doubled);
+		auto norm2 = exact.pow(2).sum().item().toDouble();
+		double tol = 1e-2;
+		compress(doubled, tol);
+		// each of the L-1 bonds discards a weight of at most tol times the squared norm.
+		auto error = (exact - to_dense(doubled)).pow(2).sum().item().toDouble();
+		qtt_CHECK(error <= (L - 1) * tol * norm2);
+	}
+	qtt_SUBCASE("maximum bond")
+	{
+		auto exact = to_dense(doubled);
+		compress(doubled, 0, 2);
+		for (int64_t i = 1; i < L; ++i)
+			qtt_CHECK(doubled[i].sizes()[0] <= 2);
+		// the error of the canonical truncation is bounded by the sum of the errors of the best rank 2 approximations
+		// of the operator on every bond.
+		double bound = 0;
+		for (int64_t k = 0; k < L - 1; ++k)
+		{
+			using namespace torch::indexing;
+			auto s = std::get<1>(torch::svd(exact.flatten(0, 2 + 2 * k).flatten(1)));
+			bound += s.index({Slice(2, None)}).pow(2).sum().item().toDouble();
+		}
+		auto error = (exact - to_dense(doubled)).pow(2).sum().item().toDouble();
+		qtt_CHECK(error <= bound * (1 + 1e-10) + 1e-12);
+	}
+	qtt_SUBCASE("block tensors")
+	{
+		using cval = quantity<conserved::Z>;
+		auto bH = details::random_Z_bMPO(L, torch::kFloat64);
+		// direct sum of bH with itself, the bonds of random_Z_bMPO repeated twice.
+		auto doubled_shape = btensor({{{1, cval(1)}, {1, cval(-1)}, {1, cval(1)}, {1, cval(-1)}},
+		                              {{3, cval(-1)}, {2, cval(1)}},
+		                              {{1, cval(-1)}, {1, cval(1)}, {1, cval(-1)}, {1, cval(1)}},
+		                              {{3, cval(1)}, {2, cval(-1)}}},
+		                             cval(0), torch::TensorOptions(torch::kFloat64));
+		bMPO bdoubled(L);
+		bdoubled[0] = from_basic_tensor_like(doubled_shape.basic_create_view({0, -1, -1, -1}, true),
+		                                     torch::cat({bH[0].to_dense(), bH[0].to_dense()}, 2));
+		bdoubled[L - 1] = from_basic_tensor_like(doubled_shape.basic_create_view({-1, -1, 0, -1}, true),
+		                                         torch::cat({bH[L - 1].to_dense(), bH[L - 1].to_dense()}, 0));
+		for (int64_t i = 1; i < L - 1; ++i)
+		{
+			using namespace torch::indexing;
+			auto dense = torch::zeros({4, 5, 4, 5}, torch::kFloat64);
+			dense.index_put_({Slice(0, 2), Slice(), Slice(0, 2), Slice()}, bH[i].to_dense());
+			dense.index_put_({Slice(2, 4), Slice(), Slice(2, 4), Slice()}, bH[i].to_dense());
+			bdoubled[i] = from_basic_tensor_like(doubled_shape, dense);
+		}
+		qtt_REQUIRE(bdoubled.check_ranks());
+		auto bstate = random_MPS(4, bH, cval(1), torch::kFloat64);
+		auto bE = contract(bstate, bstate, bH).item().toDouble();
+		auto original = bdoubled;
+		qtt_REQUIRE_NOTHROW(compress(bdoubled, 1e-14));
+		qtt_CHECK(bdoubled.check_ranks());
+		// the quantities of the physical indices are untouched, those of the bonds are taken from the original bonds.
+		const auto quantities = [](const btensor &tens, size_t dim)
+		{
+			std::vector<any_quantity> out;
+			for (size_t s = 0; s < tens.section_number(dim); ++s)
+				out.push_back(tens.section_conserved_qtt(dim, s));
+			return out;
+		};
+		for (int64_t i = 0; i < L; ++i)
+		{
+			qtt_CHECK(btensor::check_tensor(bdoubled[i]) == "");
+			qtt_CHECK(quantities(bdoubled[i], 1) == quantities(original[i], 1));
+			qtt_CHECK(quantities(bdoubled[i], 3) == quantities(original[i], 3));
+			for (size_t dim : {0, 2})
+			{
+				auto bond = quantities(original[i], dim);
+				for (const auto &q : quantities(bdoubled[i], dim))
+					qtt_CHECK(std::find(bond.begin(), bond.end(), q) != bond.end());
+			}
+			if (i > 0)
+				qtt_CHECK(bdoubled[i].sizes()[0] < original[i].sizes()[0]);
+		}
+		qtt_CHECK(contract(bstate, bstate, bdoubled).item().toDouble() == doctest::Approx(2 * bE).epsilon(1e-10));
+	}
+}
 qtt_TEST_CASE("btensor networks")
 {
 	using cval = quantity<conserved::Z, conserved::Z>;
@@ -832,6 +1252,36 @@ qtt_TEST_CASE("btensor networks")
 		auto X = random_MPS(4, 4, phys_ind, cval(4, 0)); // random MPS with 4 electrons, and bond dimension of 4.
 		qtt_CHECK(X.check_ranks());
 	}
+	qtt_SUBCASE("bond spectra")
+	{
+		constexpr size_t L = 6;
+		auto X = random_MPS(L, 4, phys_ind, cval(6, 0), torch::kFloat64);
+		const bMPS &const_X = X;
+		auto norm = contract(X, X).item().toDouble();
+		X.keep_spectra();
+		X.move_oc(L - 1); // singular value decompositions
+		X.move_oc(0);     // from the spectra
+		for (size_t bond = 0; bond + 1 < L; ++bond)
+		{
+			qtt_REQUIRE(X.spectrum(bond).has_value());
+			auto values = X.spectrum(bond)->to_dense();
+			// the spectrum of the normalized state is the Schmidt decomposition
+			qtt_CHECK(values.square().sum().item().toDouble() == doctest::Approx(norm));
+			qtt_CHECK(entanglement_entropy(X, bond) >= 0);
+		}
+		// the sites right of the center are right canonical
+		for (size_t i = 1; i < L; ++i)
+		{
+			auto id = tensordot(const_X[i], const_X[i].conj(), {1, 2}, {1, 2}).to_dense();
+			qtt_CHECK(torch::allclose(id, torch::eye(id.size(0), id.options())));
+		}
+		qtt_CHECK(contract(X, X).item().toDouble() == doctest::Approx(norm));
+		X[2]; // non-const access discards the spectra of the bonds of the site.
+		qtt_CHECK(X.spectrum(0).has_value());
+		qtt_CHECK_FALSE(X.spectrum(1).has_value());
+		qtt_CHECK_FALSE(X.spectrum(2).has_value());
+		qtt_CHECK(X.spectrum(3).has_value());
+	}
 	qtt_SUBCASE("bMPO")
 	{
 		btensor rside({{{1, cval(0, 0)},
@@ -900,6 +1350,38 @@ qtt_TEST_CASE("contraction equivalence tests")
 	// fmt::print("{}\n", aver_norm2);
 	qtt_CHECK(torch::allclose(aver, aver_test));
 }
+qtt_TEST_CASE("tree contraction")
+{
+	constexpr int64_t L = 7; // odd length, the last transfer matrix of a level has no partner.
+	auto T = torch::rand({3, 2, 3, 2}, torch::kFloat64);
+	MPO H(L, T);
+	{
+		using namespace torch::indexing;
+		H[0] = H[0].index({Slice(0, 1), Ellipsis});
+		H[L - 1] = H[L - 1].index({Ellipsis, Slice(0, 1), Slice()});
+	}
+	auto a = random_MPS(3, H, torch::kFloat64);
+	auto b = random_MPS(2, H, torch::kFloat64);
+	for (auto order : {contraction_order::tree, contraction_order::automatic, contraction_order::sequential})
+	{
+		qtt_CHECK(torch::allclose(contract(a, b, order), contract(a, b)));
+		qtt_CHECK(torch::allclose(contract(a, b, H, order), contract(a, b, H)));
+	}
+	qtt_SUBCASE("block tensors")
+	{
+		using cval = quantity<conserved::Z>;
+		auto bH = details::random_Z_bMPO(L, torch::kFloat64);
+		auto ba = random_MPS(3, bH, cval(1), torch::kFloat64);
+		auto bb = random_MPS(2, bH, cval(1), torch::kFloat64);
+		const auto overlap = contract(ba, bb).item().toDouble();
+		const auto expectation = contract(ba, bb, bH).item().toDouble();
+		for (auto order : {contraction_order::tree, contraction_order::automatic, contraction_order::sequential})
+		{
+			qtt_CHECK(contract(ba, bb, order).item().toDouble() == doctest::Approx(overlap));
+			qtt_CHECK(contract(ba, bb, bH, order).item().toDouble() == doctest::Approx(expectation));
+		}
+	}
+}
 
 /**
  * @brief template struct to determine the correct tensor train network to use given another tensor train network or
@@ -0,0 +1,179 @@
+/*
+ * File: auto_MPO.h
+ * Project: QuantiT
+ * File Created: Sunday, 18th October 2026 4:05:12 pm
+ * Author: Alexandre Foley (Alexandre.foley@usherbrooke.ca)
+ * Copyright (c) 2026 Alexandre Foley
+ * Licensed under GPL v3
+ */
+
+#ifndef INCLUDE_AUTO_MPO_H
+#define INCLUDE_AUTO_MPO_H
+
+#include "MPT.h"
+#include "blockTensor/btensor.h"
+#include "operators.h"
+#include <c10/util/complex.h>
+#include <map>
+#include <torch/torch.h>
+#include <tuple>
+#include <vector>
+
+#include "doctest/doctest_proxy.h"
+
+namespace quantit
+{
+
+/**
+ * @brief A local operator acting on a given site of the chain.
+ * Fermionic operators anticommute with the other fermionic operators of the chain, the Jordan-Wigner string is inserted
+ * by auto_MPO.
+ */
+struct site_operator
+{
+	torch::Tensor op;
+	size_t site;
+	bool fermionic = false;
+};
+
+/**
+ * @brief Build a MPO from a sum of products of local operators.
+ *
+ * Each term is a coefficient multiplying a product of operators, in the order supplied. The operators of a term are
+ * reordered by site, with a sign for every exchange of two fermionic operators, the operators on the same site are
+ * multiplied together and the fermion string is inserted on the sites to the left of each fermionic operator. Terms
+ * must contain an even number of fermionic operators.
+ *
+ * The bond dimension is minimized independently on each bond: the coefficients of the terms crossing the bond form a
+ * matrix between the distinct operator strings on each side, whose rank is the number of bond states needed for those
+ * terms. The rank is found by a singular value decomposition of each conserved quantity sector of that matrix, which
+ * makes long-range couplings with a low rank structure (such as exponentially decaying couplings) as cheap as first
+ * neighbor ones. Two more states are used on each bond: one for the terms entirely on the left and one for those
+ * entirely on the right.
+ *
+ * With the block tensor MPO, the conserved quantities of the bond states are taken from the selection rules of the
+ * operators, no thresholding of a dense MPO is involved.
+ */
+class auto_MPO
+{
+	size_t length;
+	int64_t local_dim;
+	torch::Tensor fermion_string;
+	std::vector<std::tuple<c10::complex<double>, std::vector<site_operator>>> terms;
+
+	/**
+	 * @brief table of the distinct site operators, the identity first, and the terms as a sequence of indices in that
+	 * table, one per site, with the duplicated terms summed. Operators share an entry of the table when no element
+	 * differs by more than cutoff.
+	 */
+	std::tuple<std::vector<torch::Tensor>, std::map<std::vector<size_t>, c10::complex<double>>> canonical_terms(
+	    torch::ScalarType work_type, double cutoff) const;
+	torch::ScalarType work_type() const;
+
+  public:
+	/**
+	 * @param length number of sites in the chain
+	 * @param local_dim dimension of the local hilbert space
+	 * @param fermion_string Jordan-Wigner string operator, required for terms with fermionic operators.
+	 */
+	auto_MPO(size_t length, int64_t local_dim, torch::Tensor fermion_string = torch::Tensor());
+
+	/**
+	 * @brief add coefficient * ops[0] * ops[1] * ... to the hamiltonian.
+	 */
+	auto_MPO &add(torch::Scalar coefficient, std::vector<site_operator> ops);
+
+	size_t size() const { return length; }
+	size_t term_count() const { return terms.size(); }
+
+	/**
+	 * @brief build the MPO
+	 *
+	 * @param opt options of the output tensors. complex coefficients or operators promote the type to complex.
+	 * @param cutoff singular values smaller than cutoff times the largest one, and MPO entries smaller than cutoff are
+	 * discarded.
+	 */
+	MPO to_MPO(torch::TensorOptions opt = {}, double cutoff = 1e-12) const;
+	/**
+	 * @brief build the MPO with the conservation law specified by the rank 1 block tensor phys_shape. All the operators
+	 * must have a well defined selection rule.
+	 */
+	bMPO to_bMPO(const btensor &phys_shape, torch::TensorOptions opt = {}, double cutoff = 1e-12) const;
+};
+
+qtt_TEST_CASE("auto MPO")
+{
+	// contract a short MPO into its full matrix
+	auto full_matrix = [](const MPO &H)
+	{
+		auto out = H[0];
+		for (size_t i = 1; i < H.size(); ++i)
+		{
+			auto d = H[i].sizes()[1];
+			auto p = out.sizes()[1];
+			out = torch::tensordot(out, H[i], {2}, {0})
+			          .permute({0, 1, 3, 4, 2, 5})
+			          .reshape({out.sizes()[0], p * d, H[i].sizes()[2], p * d});
+		}
+		return out.reshape({out.sizes()[1], out.sizes()[3]});
+	};
+	auto [sx, isy, sz, lo, id] = pauli();
+	auto hi = lo.t();
+	constexpr size_t L = 5;
+	qtt_SUBCASE("first neighbor Heisenberg")
+	{
+		auto_MPO builder(L, 2);
+		for (size_t i = 0; i + 1 < L; ++i)
+		{
+			builder.add(-0.5, {{hi, i}, {lo, i + 1}});
+			builder.add(-0.5, {{lo, i}, {hi, i + 1}});
+			builder.add(-0.25, {{sz, i}, {sz, i + 1}});
+		}
+		auto H = builder.to_MPO(torch::kFloat64);
+		qtt_CHECK(H[2].sizes()[0] == 5);
+		qtt_CHECK(torch::allclose(full_matrix(H), full_matrix(Heisenberg(torch::tensor(1.0), L).to(torch::kFloat64))));
+		qtt_SUBCASE("conserved quantities")
+		{
+			using cvals = quantity<conserved::Z>;
+			auto phys = btensor({{{1, cvals(-1)}, {1, cvals(1)}}}, cvals(0));
+			auto bH = builder.to_bMPO(phys, torch::kFloat64);
+			MPO dense(bH.size());
+			for (size_t i = 0; i < bH.size(); ++i)
+				dense[i] = bH[i].to_dense();
+			qtt_CHECK(torch::allclose(full_matrix(dense), full_matrix(H)));
+		}
+	}
+	qtt_SUBCASE("exponentially decaying coupling")
+	{
+		auto_MPO builder(L, 2);
+		auto expected = torch::zeros({1 << L, 1 << L}, torch::kFloat64);
+		for (size_t i = 0; i < L; ++i)
+			for (size_t j = i + 1; j < L; ++j)
+			{
+				auto J = std::pow(0.5, j - i);
+				builder.add(J, {{sz, i}, {sz, j}});
+				MPO term(L, id.to(torch::kFloat64).reshape({1, 2, 1, 2}));
+				term[i] = sz.to(torch::kFloat64).reshape({1, 2, 1, 2}) * J;
+				term[j] = sz.to(torch::kFloat64).reshape({1, 2, 1, 2});
+				expected += full_matrix(term);
+			}
+		auto H = builder.to_MPO(torch::kFloat64);
+		// the coupling matrix has rank 1 on every bond.
+		qtt_CHECK(H[2].sizes()[0] == 3);
+		qtt_CHECK(torch::allclose(full_matrix(H), expected));
+	}
+	qtt_SUBCASE("fermion anticommutation")
+	{
+		auto [c_up, c_dn, F, f_id] = fermions();
+		auto cd_up = c_up.t();
+		auto_MPO builder(3, 4, F);
+		builder.add(1, {{cd_up, 0, true}, {c_up, 2, true}});
+		builder.add(1, {{c_up, 2, true}, {cd_up, 0, true}});
+		qtt_CHECK(torch::allclose(full_matrix(builder.to_MPO(torch::kFloat64)), torch::zeros({64, 64}, torch::kFloat64)));
+		qtt_CHECK_THROWS_AS(builder.add(1, {{c_up, 1, true}}).to_MPO(), std::invalid_argument);
+	}
+}
+
+} // namespace quantit
+
+#endif // INCLUDE_AUTO_MPO_H
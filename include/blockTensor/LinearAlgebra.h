@@ -17,6 +17,7 @@
 #include <fmt/core.h>
 #include <fmt/ranges.h>
 #include <ostream>
+#include <stdexcept>
 
 namespace quantit
 {
@@ -94,6 +95,33 @@ inline std::tuple<btensor, btensor, btensor> svd(const btensor &tensor, int spli
 	return svd(tensor, static_cast<size_t>(split));
 }
 
+/**
+ * @brief Parameters of the randomized range finder used by the truncating svd on large blocks.
+ *
+ * A block is decomposed from a sample of its range when the number of singular values that can be kept is smaller
+ * than rank_fraction times its smallest dimension. The sample has oversampling columns more than the number of
+ * values kept, and is refined by power_iterations applications of \f$ A A^\dagger \f$. A rank_fraction of zero
+ * always use the exact decomposition, rank_fraction must be in [0,1].
+ */
+struct randomized_svd_options
+{
+	double rank_fraction;
+	size_t oversampling;
+	size_t power_iterations;
+
+	constexpr static size_t def_oversampling = 10;
+	constexpr static size_t def_power_iterations = 2;
+
+	explicit randomized_svd_options(double _rank_fraction = 0, size_t _oversampling = def_oversampling,
+	                                size_t _power_iterations = def_power_iterations)
+	    : rank_fraction(_rank_fraction), oversampling(_oversampling), power_iterations(_power_iterations)
+	{
+		// beyond one, the sample would have more columns than the block has singular values.
+		if (!(rank_fraction >= 0 and rank_fraction <= 1))
+			throw std::invalid_argument(
+			    fmt::format("the rank fraction of the randomized svd must be in [0,1], got {}", rank_fraction));
+	}
+};
 /**
  * @brief truncating svd for tensor network methods, treats the tensor as a matrix, with the index before the split
  * treated as the row of the matrix and the indices at and after the split as the column indices.
@@ -110,18 +138,22 @@ inline std::tuple<btensor, btensor, btensor> svd(const btensor &tensor, int spli
  * @param max_size maximum number of singular value kept
  * @param pow power used in the computation of the truncation error. When optimizing the energy of a MPS, 2 is the right
  * choice.
+ * @param randomized when to decompose a block from a random sample of its range instead of exactly. The weight of the
+ * singular values a sampled block doesn't resolve is not counted in the truncation error.
  * @return std::tuple<btensor,btensor,btensor> U,d,V
  */
 std::tuple<btensor, btensor, btensor> svd(const btensor &A, size_t split, btensor::Scalar tol, size_t min_size,
-                                          size_t max_size, btensor::Scalar pow = 2);
+                                          size_t max_size, btensor::Scalar pow = 2,
+                                          const randomized_svd_options &randomized = randomized_svd_options());
 /**
  * @brief overload for implicit conversion disambiguation, see svd(cont
- * btensor&,size_t,btensor::Scalar,size_t,size_t,btensor::Scalar)
+ * btensor&,size_t,btensor::Scalar,size_t,size_t,btensor::Scalar,const randomized_svd_options&)
  */
 inline std::tuple<btensor, btensor, btensor> svd(const btensor &A, int split, btensor::Scalar tol, size_t min_size,
-                                                 size_t max_size, btensor::Scalar pow = 2)
+                                                 size_t max_size, btensor::Scalar pow = 2,
+                                                 const randomized_svd_options &randomized = randomized_svd_options())
 {
-	return svd(A, static_cast<size_t>(split), tol, min_size, max_size, pow);
+	return svd(A, static_cast<size_t>(split), tol, min_size, max_size, pow, randomized);
 }
 /**
  * @brief truncating svd for tensor network methods, treats the tensor as a matrix, with the index before the split
@@ -301,6 +333,15 @@ qtt_TEST_CASE("btensor Linear algebra")
 					}
 				}
 			}
+			{
+				// a sector made of a single block doesn't need to be copied.
+				auto reordered_block = LA_helpers::reorder_by_cvals(A);
+				auto [compact_tensor, other_indices, row_block_slices, col_block_slices] =
+				    LA_helpers::compact_dense_single(reordered_block.begin() + 6, reordered_block.end());
+				qtt_CHECK(compact_tensor.is_same(std::get<1>(reordered_block.back())));
+				qtt_CHECK(row_block_slices.size() == 1);
+				qtt_CHECK(col_block_slices.size() == 1);
+			}
 			{
 				btensor B;
 				qtt_REQUIRE_NOTHROW(B = A.reshape({1})); // joins dimensions 2 and 1
@@ -470,6 +511,46 @@ qtt_TEST_CASE("btensor Linear algebra")
 			// fmt::print("d\n{}\n\n", shape_from(d, dummy));
 			// fmt::print("V\n{}\n\n", shape_from(V, dummy));
 		}
+		qtt_SUBCASE("tall and skinny sector")
+		{
+			// large enough and rectangular enough to be decomposed from its gram matrix.
+			using cqt = conserved::C<2>;
+			btensor X = quantit::rand({{{128, cqt(0)}}, {{8, cqt(0)}}}, cqt(0), torch::kFloat64);
+			auto [U, d, V] = svd(X, 1);
+			auto block = std::get<1>(*X.begin());
+			auto [tU, td, tV] = torch::svd(block);
+			qtt_CHECK(torch::allclose(std::get<1>(*d.begin()), td));
+			qtt_CHECK(allclose(tensordot(U.mul(d), V.conj(), {1}, {1}), X));
+			qtt_CHECK(tensordot(V, V.conj(), {0, 1}, {0, 1}).item().toDouble() == doctest::Approx(8));
+			qtt_CHECK(tensordot(U, U.conj(), {0, 1}, {0, 1}).item().toDouble() == doctest::Approx(8));
+		}
+		qtt_SUBCASE("truncation keeps the largest singular values")
+		{
+			using cqt = conserved::C<2>;
+			btensor X = quantit::rand({{{2, cqt(-2)}, {2, cqt(0)}, {2, cqt(2)}},
+			                          {{1, cqt(1)}, {1, cqt(-1)}},
+			                          {{1, cqt(1)}, {1, cqt(-1)}},
+			                          {{2, cqt(2)}, {2, cqt(0)}, {2, cqt(-2)}}},
+			                         cqt(0));
+			auto spectrum = [](const btensor &d)
+			{
+				std::vector<torch::Tensor> blocks;
+				for (const auto &block : d)
+					blocks.push_back(std::get<1>(block));
+				return std::get<0>(torch::cat(blocks).sort(-1, true));
+			};
+			auto full = spectrum(std::get<1>(svd(X, 2)));
+			auto kept = spectrum(std::get<1>(svd(X, 2, 0.0, 1, 3)));
+			qtt_REQUIRE(kept.sizes()[0] == 3);
+			qtt_CHECK(torch::allclose(kept, full.index({torch::indexing::Slice(0, 3)})));
+			// the sample covers the whole range of the blocks, the randomized decomposition must be exact.
+			auto [rU, rd, rV] = svd(X, 2, 0.0, 1, 3, 2, randomized_svd_options(1.0));
+			auto sampled = spectrum(rd);
+			qtt_REQUIRE(sampled.sizes()[0] == 3);
+			qtt_CHECK(torch::allclose(sampled, kept));
+			qtt_CHECK(tensordot(rU, rU.conj(), {0, 1, 2}, {0, 1, 2}).item().toDouble() == doctest::Approx(3));
+			qtt_CHECK_THROWS_AS(randomized_svd_options(1.5), std::invalid_argument);
+		}
 		qtt_SUBCASE("truncating tensor singular decomposition")
 		{
 			btensor U, d, V;
@@ -1338,6 +1338,25 @@ btensor from_basic_tensor(const btensor::vec_list_t &shape_spec, any_quantity se
                           const torch::Tensor &values, const torch::Scalar cutoff = 1e-16, c10::TensorOptions = {});
 btensor from_basic_tensor_like(const btensor &shape, const torch::Tensor &values, const torch::Scalar cutoff = 1e-16,
                                c10::TensorOptions = {});
+/**
+ * @brief create a btensor from a list of its non-zero elements, inferring the sections and conserved quantities of one
+ * dimension.
+ *
+ * The conserved quantity of each index along the missing dimension is deduced from the elements, such that they
+ * satisfy the selection rule. Consecutive indices with the same quantity form a section, the indices without any
+ * element get the neutral quantity. Elements with the same coordinates are summed.
+ *
+ * @param indices coordinates of the elements, of shape (rank, N) like torch::sparse_coo_tensor.
+ * @param values value of the elements, of shape (N).
+ * @param partial_shape shape of every dimension but the missing one, in order, and the selection rule of the output.
+ * @param missing_dim dimension to infer.
+ * @param missing_size size of the missing dimension, deduced from the largest index when negative.
+ * @param cutoff elements of smaller magnitude are ignored.
+ * @return btensor
+ */
+btensor from_coo(const torch::Tensor &indices, const torch::Tensor &values, const btensor &partial_shape,
+                 int64_t missing_dim, int64_t missing_size = -1, const torch::Scalar cutoff = 1e-16,
+                 c10::TensorOptions opt = {});
 
 inline torch::Tensor zeros_like(const torch_shape &shape, c10::TensorOptions opt = {})
 {
@@ -1810,6 +1829,23 @@ qtt_TEST_CASE("btensor")
 		          any_quantity(cqt(1)));
 		qtt_CHECK_NOTHROW(B.basic_index_put_({-1,0,-1},C));
 	}
+	qtt_SUBCASE("from coordinates")
+	{
+		auto B = quantit::rand(
+		    {{{2, cqt(0)}, {3, cqt(1)}}, {{1, cqt(4)}, {2, cqt(1)}, {2, cqt(0)}}, {{2, cqt(0)}, {1, cqt(1)}}},
+		    selection_rule);
+		auto dense = B.to_dense();
+		auto indices = dense.nonzero().t();
+		auto values = dense.index({indices[0], indices[1], indices[2]});
+		auto partial_shape = B.shape_from({-1, 0, -1}).set_selection_rule_(selection_rule);
+		btensor C;
+		qtt_REQUIRE_NOTHROW(C = from_coo(indices, values, partial_shape, 1, B.sizes()[1]));
+		qtt_CHECK(btensor::check_tensor(C) == "");
+		qtt_CHECK(torch::equal(C.to_dense(), dense));
+		// index 0 of the missing dimension would need the quantity 0 with the first element and 4 with the second.
+		auto conflicting = torch::tensor({0, 2, 0, 0, 0, 0}, torch::kInt64).reshape({3, 2});
+		qtt_CHECK_THROWS_AS(from_coo(conflicting, torch::ones({2}), partial_shape, 1), std::logic_error);
+	}
 	qtt_SUBCASE("batched matrix multiply")
 	{
 		// B and C are compatible
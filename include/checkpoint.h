@@ -0,0 +1,105 @@
+/*
+ * File: checkpoint.h
+ * Project: QuantiT
+ * File Created: Sunday, 18th October 2026 9:52:18 pm
+ * Author: Alexandre Foley (Alexandre.foley@usherbrooke.ca)
+ * Copyright (c) 2026 Alexandre Foley
+ * Licensed under GPL v3
+ */
+
+#ifndef INCLUDE_CHECKPOINT_H
+#define INCLUDE_CHECKPOINT_H
+
+#include "MPT.h"
+#include "blockTensor/btensor.h"
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "doctest/doctest_proxy.h"
+
+namespace quantit
+{
+
+/**
+ * @brief Content of a checkpoint file: a list of block tensors, with a kind and integer metadata to interpret them.
+ *
+ * The file is made of a header of 64 bytes, the metadata and the block data. The header holds a magic string, the
+ * version of the format, a byte order mark and the position and size of the two other parts. The metadata is a list
+ * of 64 bits integers: the kind, the user metadata and for each tensor its rank, scalar type, sections, conserved
+ * quantities, selection rule and the position of each block in the payload. The conserved quantities are stored with
+ * the tag of their type, see vquantity::type_tag. The payload is the contiguous data of every block, each block
+ * aligned on 64 bytes.
+ */
+struct checkpoint
+{
+	std::string kind;
+	std::vector<int64_t> metadata;
+	std::vector<btensor> tensors;
+};
+
+/**
+ * @brief write the checkpoint to path.
+ *
+ * The file is first written next to path under a name unique to the write, synced to the disk, then renamed over it,
+ * and the directory is synced: an interrupted write or a crash of the system leaves either the previous file or the new
+ * one intact. Concurrent writes to the same path each leave a complete file, the last rename wins. The blocks are
+ * copied to the CPU one at a time.
+ */
+void save_checkpoint(const std::filesystem::path &path, const checkpoint &content);
+/**
+ * @brief read a checkpoint from path.
+ *
+ * @param memory_map when true, the file is mapped in memory and the blocks are views of the mapping, which is
+ * released when the last block referencing it is destroyed. The mapping is private: modifying a block in place doesn't
+ * modify the file. When false, or when memory mapping is unavailable, each block is read in its own tensor.
+ */
+checkpoint load_checkpoint(const std::filesystem::path &path, bool memory_map = true);
+
+void save(const btensor &tensor, const std::filesystem::path &path);
+void save(const bMPS &state, const std::filesystem::path &path);
+void save(const bMPO &op, const std::filesystem::path &path);
+btensor load_btensor(const std::filesystem::path &path, bool memory_map = true);
+bMPS load_bMPS(const std::filesystem::path &path, bool memory_map = true);
+bMPO load_bMPO(const std::filesystem::path &path, bool memory_map = true);
+
+qtt_TEST_CASE("checkpoint")
+{
+	using cval = quantity<conserved::Z, conserved::Z>;
+	qtt_SUBCASE("conserved quantities")
+	{
+		any_quantity qt = cval(3, -1);
+		std::vector<int64_t> values;
+		qt.get().serialize(values);
+		qtt_REQUIRE(values.size() == 2);
+		qtt_CHECK(qt.get().type_tag() == "Z,Z");
+		qtt_CHECK(make_quantity(qt.get().type_tag(), values.data(), values.size()).get() == qt.get());
+		qtt_CHECK_THROWS_AS(make_quantity("Z,Z", values.data(), 1), std::invalid_argument);
+		qtt_CHECK_THROWS_AS(make_quantity("unknown", values.data(), 2), std::invalid_argument);
+	}
+	auto phys_ind = sparse_zeros({{{1, cval(0, 0)}, {1, cval(1, -1)}, {1, cval(1, 1)}, {1, cval(2, 0)}}}, cval(0, 0));
+	auto state = random_MPS(5, 8, phys_ind, cval(4, 0));
+	state.move_oc(2);
+	auto path = std::filesystem::temp_directory_path() / "quantit_checkpoint_test.qtt";
+	save(state, path);
+	for (bool memory_map : {true, false})
+	{
+		auto loaded = load_bMPS(path, memory_map);
+		qtt_REQUIRE(loaded.size() == state.size());
+		qtt_CHECK(size_t(loaded.orthogonality_center) == size_t(state.orthogonality_center));
+		for (size_t i = 0; i < state.size(); ++i)
+		{
+			qtt_CHECK(loaded[i].get_cvals() == state[i].get_cvals());
+			qtt_CHECK(loaded[i].selection_rule->get() == state[i].selection_rule->get());
+			qtt_CHECK(loaded[i].blocks().size() == state[i].blocks().size());
+			qtt_CHECK(torch::equal(loaded[i].to_dense(), state[i].to_dense()));
+		}
+	}
+	qtt_CHECK_THROWS_AS(load_bMPO(path), std::invalid_argument);
+	std::filesystem::remove(path);
+}
+
+} // namespace quantit
+
+#endif // INCLUDE_CHECKPOINT_H
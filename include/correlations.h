@@ -0,0 +1,135 @@
+/*
+ * File: correlations.h
+ * Project: QuantiT
+ * File Created: Sunday, 18th October 2026 8:02:47 pm
+ * Author: Alexandre Foley (Alexandre.foley@usherbrooke.ca)
+ * Copyright (c) 2026 Alexandre Foley
+ * Licensed under GPL v3
+ */
+
+#ifndef INCLUDE_CORRELATIONS_H
+#define INCLUDE_CORRELATIONS_H
+
+#include "MPT.h"
+#include "blockTensor/btensor.h"
+#include "operators.h"
+#include <optional>
+#include <torch/torch.h>
+#include <vector>
+
+#include "doctest/doctest_proxy.h"
+
+namespace quantit
+{
+
+/**
+ * @brief A two-point correlator: left on site i, right on site j and string on every site strictly between them, such
+ * as the Jordan-Wigner string of fermionic correlators. No string means the identity. The operators have the index
+ * ordering (out, in).
+ */
+template <class Tensor>
+struct two_point_operator
+{
+	Tensor left;
+	Tensor right;
+	std::optional<Tensor> string = std::nullopt;
+};
+
+/**
+ * @brief <O_i> on every site i, for each operator O, normalized by the norm of the state.
+ *
+ * The environments of the norm are computed once from each side of the chain, each expectation value then costs a
+ * single site contraction. Return a vector of the chain's length for each operator.
+ */
+std::vector<torch::Tensor> expectation_values(const MPS &state, const std::vector<torch::Tensor> &ops);
+std::vector<torch::Tensor> expectation_values(const bMPS &state, const std::vector<btensor> &ops);
+
+/**
+ * @brief matrix of <left_i right_j> for every pair of sites, for each correlator, normalized by the norm of the state.
+ *
+ * The left environments of the norm are computed once. At each site i, a branch is started with each of left and right
+ * inserted, then every branch is carried to the right, closing it with the other operator and the right environment of
+ * the norm at every site j > i. The whole matrix costs O(N^2) single site contractions for a chain of N sites.
+ * The diagonal is the expectation value of the product left*right. The elements i > j are the site ordered product:
+ * right_j, string, left_i. For fermionic operators, it differs from left_i right_j by the exchange sign.
+ */
+std::vector<torch::Tensor> correlations(const MPS &state, const std::vector<two_point_operator<torch::Tensor>> &ops);
+std::vector<torch::Tensor> correlations(const bMPS &state, const std::vector<two_point_operator<btensor>> &ops);
+
+qtt_TEST_CASE("correlations")
+{
+	constexpr size_t L = 5;
+	auto [sx, isy, sz, lo, id] = pauli();
+	sx = sx.to(torch::kFloat64);
+	sz = sz.to(torch::kFloat64);
+	id = id.to(torch::kFloat64);
+	auto state = random_MPS(L, 4, 2, torch::kFloat64);
+	auto norm = contract(state, state);
+	// product of operators on the given sites, as a MPO of bond dimension 1.
+	auto product = [&](const std::vector<std::tuple<torch::Tensor, size_t>> &ops)
+	{
+		MPO out(L, id.reshape({1, 2, 1, 2}));
+		for (const auto &[op, site] : ops)
+			out[site] = torch::matmul(op, out[site].reshape({2, 2})).reshape({1, 2, 1, 2});
+		return (contract(state, state, out) / norm).item().toDouble();
+	};
+	auto one_point = expectation_values(state, {sx, sz});
+	qtt_REQUIRE(one_point.size() == 2);
+	for (size_t i = 0; i < L; ++i)
+	{
+		qtt_CHECK(one_point[0][i].item().toDouble() == doctest::Approx(product({{sx, i}})));
+		qtt_CHECK(one_point[1][i].item().toDouble() == doctest::Approx(product({{sz, i}})));
+	}
+	auto two_point = correlations(state, {{sx, sz}, {sx, sx, sz}});
+	qtt_REQUIRE(two_point.size() == 2);
+	for (size_t i = 0; i < L; ++i)
+		for (size_t j = 0; j < L; ++j)
+		{
+			auto expected = i == j ? product({{sz, i}, {sx, i}}) : product({{sx, i}, {sz, j}});
+			qtt_CHECK(two_point[0][i][j].item().toDouble() == doctest::Approx(expected));
+		}
+	qtt_SUBCASE("string")
+	{
+		std::vector<std::tuple<torch::Tensor, size_t>> ops{{sx, 0}, {sx, 3}, {sz, 1}, {sz, 2}};
+		qtt_CHECK(two_point[1][0][3].item().toDouble() == doctest::Approx(product(ops)));
+		qtt_CHECK(two_point[1][3][0].item().toDouble() == doctest::Approx(product(ops)));
+	}
+	qtt_SUBCASE("conserved quantities")
+	{
+		// S+_i S-_j: the branches carry the charge of one operator, and the expectation value of S+ alone is empty.
+		using cval = quantity<conserved::Z>;
+		auto phys = btensor({{{1, cval(1)}, {1, cval(-1)}}}, cval(0), torch::TensorOptions(torch::kFloat64));
+		auto op_shape = shape_from(phys, phys.conj());
+		auto block_op = [&](const torch::Tensor &op)
+		{
+			btensor shape = op_shape;
+			return from_basic_tensor_like(shape.set_selection_rule_(find_selection_rule(op, shape)), op);
+		};
+		auto lower = lo.to(torch::kFloat64);
+		auto raise = lower.t().contiguous();
+		auto bstate = random_MPS(L, 4, phys, cval(1), torch::kFloat64);
+		std::vector<torch::Tensor> dense_tensors;
+		for (const auto &tens : bstate)
+			dense_tensors.push_back(tens.to_dense());
+		MPS dense_state(std::move(dense_tensors));
+		auto block_one_point = expectation_values(bstate, {block_op(raise), block_op(sz)});
+		auto dense_one_point = expectation_values(dense_state, {raise, sz});
+		auto block_two_point = correlations(bstate, {{block_op(raise), block_op(lower)}});
+		auto dense_two_point = correlations(dense_state, {{raise, lower}});
+		for (size_t i = 0; i < L; ++i)
+		{
+			qtt_CHECK(block_one_point[0][i].item().toDouble() == 0);
+			qtt_CHECK(block_one_point[1][i].item().toDouble() ==
+			          doctest::Approx(dense_one_point[1][i].item().toDouble()));
+			for (size_t j = 0; j < L; ++j)
+				qtt_CHECK(block_two_point[0][i][j].item().toDouble() ==
+				          doctest::Approx(dense_two_point[0][i][j].item().toDouble()));
+		}
+		// the state isn't an eigenstate of the hopping, some correlations don't vanish.
+		qtt_CHECK(block_two_point[0].abs().max().item().toDouble() > 1e-8);
+	}
+}
+
+} // namespace quantit
+
+#endif // INCLUDE_CORRELATIONS_H
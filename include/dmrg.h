@@ -14,11 +14,20 @@
 #ifndef E8650E72_8C05_4D74_98C7_61F4FD428B39
 #define E8650E72_8C05_4D74_98C7_61F4FD428B39
 
+#include "MPO_apply.h"
 #include "MPT.h"
 #include "dmrg_logger.h"
 #include "dmrg_options.h"
+#include "sparse_MPO.h"
+#include <algorithm>
+#include <bitset>
 #include <cmath>
+#include <filesystem>
+#include <functional>
+#include <future>
 #include <limits>
+#include <optional>
+#include <random>
 #include <torch/torch.h>
 #include "doctest/doctest_proxy.h"
 
@@ -38,10 +47,19 @@ torch::Tensor dmrg( MPO &hamiltonian, MPS &in_out_state, const dmrg_options &opt
                    dmrg_logger &logger = dummy_logger);
 btensor dmrg( bMPO &hamiltonian, bMPS &in_out_state, const dmrg_options &options,
                    dmrg_logger &logger = dummy_logger);
+/**
+ * DMRG with a sparse MPO: the environments and the effective hamiltonian are applied term by term, skipping the zero
+ * entries of the operator matrices. Same sweeps and result as dmrg with the equivalent dense MPO, mixed precision
+ * included. The gradient of the hamiltonian isn't supported.
+ */
+torch::Tensor dmrg(const sparse_MPO &hamiltonian, MPS &in_out_state, const dmrg_options &options,
+                   dmrg_logger &logger = dummy_logger);
 
 /**
  * Apply the DMRG algorithm to solve the ground state of the input hamiltonian given as a MPO.
  * uses a random starting MPS with minimum_bond bond dimension.
+ * With the block tensor MPO, options.idmrg_warm_start instead grows the starting MPS with infinite DMRG, inserting pairs
+ * of sites at the centre of the chain. This requires a MPO with the same bond dimension everywhere in the bulk.
  * return the ground state energy and optimized MPS.
  */
 std::tuple<torch::Tensor, MPS> dmrg( MPO &hamiltonian, const dmrg_options &options,
@@ -49,13 +67,123 @@ std::tuple<torch::Tensor, MPS> dmrg( MPO &hamiltonian, const dmrg_options &optio
 std::tuple<btensor, bMPS> dmrg( bMPO &hamiltonian, any_quantity_cref state_constraint , const dmrg_options &options,
                                     dmrg_logger &logger = dummy_logger);
 
+/**
+ * Resume the block tensor DMRG from a checkpoint written by dmrg when options.checkpoint_path is set.
+ * The hamiltonian, the state and its environments are read from the file, the environments aren't recomputed. The
+ * sweeps continue from the iteration following the checkpoint with the supplied options: maximum_iterations counts the
+ * sweeps done before the checkpoint. The sweeps always resume in the precision of the hamiltonian,
+ * options.mixed_precision is ignored: a checkpoint written during the single precision warm-up ends it.
+ * return the ground state energy and optimized MPS.
+ */
+std::tuple<btensor, bMPS> dmrg_resume(const std::filesystem::path &path, const dmrg_options &options,
+                                      dmrg_logger &logger = dummy_logger);
+
+/**
+ * Real-space parallel DMRG (Stoudenmire and White, 2013): the chain is cut in num_segments segments of contiguous sites,
+ * each of which is swept by its own thread. The segments exchange their boundary environments and the singular values
+ * of the bonds between them. Each segment must have at least two sites.
+ * With a single segment, this is the same as dmrg. The threads each use torch's intra-op thread pool, consider reducing
+ * its size with torch::set_num_threads when using many segments.
+ * Uses the supplied MPS in_out_state as a starting point, and store the optimized MPS there.
+ * The associated energy is the return value.
+ */
+torch::Tensor parallel_dmrg(MPO &hamiltonian, MPS &in_out_state, size_t num_segments, const dmrg_options &options,
+                            dmrg_logger &logger = dummy_logger);
+btensor parallel_dmrg(bMPO &hamiltonian, bMPS &in_out_state, size_t num_segments, const dmrg_options &options,
+                      dmrg_logger &logger = dummy_logger);
+
+/**
+ * Excited states DMRG: minimize the energy of the hamiltonian penalized by the projectors on the reference states,
+ * H + weight * sum_k |reference_k><reference_k|. With weight larger than the gap, the result is the lowest eigenstate
+ * orthogonal to the references. Obtain successive levels by adding each state found to the references.
+ * The overlap with each reference is tracked by environments updated along with the hamiltonian's, such that the
+ * penalty doesn't require a full contraction of the networks at each step.
+ * The references must be in the same quantum number sector as in_out_state, states in other sectors are orthogonal
+ * and needn't be penalized.
+ * Uses the supplied MPS in_out_state as a starting point, and store the optimized MPS there.
+ * The return value is the energy of the hamiltonian, without the penalty.
+ */
+torch::Tensor excited_dmrg(MPO &hamiltonian, MPS &in_out_state, const std::vector<MPS> &references, double weight,
+                           const dmrg_options &options, dmrg_logger &logger = dummy_logger);
+btensor excited_dmrg(bMPO &hamiltonian, bMPS &in_out_state, const std::vector<bMPS> &references, double weight,
+                     const dmrg_options &options, dmrg_logger &logger = dummy_logger);
+
+/**
+ * A single ground state search of batch_dmrg.
+ * hamiltonian is the index of the job's hamiltonian in the list supplied to batch_dmrg. When a modifier is given, the job
+ * instead solves modifier(hamiltonians[hamiltonian]) and shares nothing with the other jobs.
+ */
+struct dmrg_job
+{
+	size_t hamiltonian;
+	any_quantity state_constraint;
+	dmrg_options options;
+	std::function<bMPO(const bMPO &)> modifier;
+};
+/**
+ * Outcome of a dmrg_job: the ground state energy, the optimized MPS and the sweep log.
+ */
+struct dmrg_job_result
+{
+	btensor energy;
+	bMPS state;
+	dmrg_log_sweeptime logger;
+};
+/**
+ * Run many independent ground state searches concurrently, e.g. for a scan of parameters or of quantum numbers.
+ * Each job starts from a random MPS with the job's minimum_bond bond dimension.
+ * The jobs that refer to the same hamiltonian (without a modifier) share its two sites hamiltonian and the edges of
+ * their environments.
+ * The number of concurrent jobs is chosen such that, together with torch's intra-op thread pool, the number of threads
+ * doesn't exceed the hardware's. A nonzero max_concurrent_jobs further limits it.
+ * Gradient computation is not supported, the job's state_gradient and hamil_gradient options are ignored.
+ * The jobs that write checkpoints must each have their own checkpoint_path, std::invalid_argument is thrown otherwise.
+ * The results are in the order of the jobs.
+ */
+std::vector<dmrg_job_result> batch_dmrg(const std::vector<bMPO> &hamiltonians, const std::vector<dmrg_job> &jobs,
+                                        size_t max_concurrent_jobs = 0);
+
+/**
+ * Parameters of the time evolution with tdvp.
+ * cutoff, maximum_bond and minimum_bond control the truncation of the two sites update, as in dmrg. The exponential of
+ * the effective hamiltonians is computed in a Krylov subspace of at most krylov_dimension vectors, stopping earlier
+ * once the estimated error is below krylov_tolerance.
+ */
+struct tdvp_options
+{
+	double cutoff = 1e-10;
+	size_t maximum_bond = std::numeric_limits<size_t>::max();
+	size_t minimum_bond = 1;
+	size_t krylov_dimension = 20;
+	double krylov_tolerance = 1e-12;
+	bool two_sites = true; // the single site variant doesn't change the bond dimension.
+};
+/**
+ * Time evolution of in_out_state with the time dependent variational principle (Haegeman et al., 2016): each time step
+ * applies exp(-i dt H) with a left to right and a right to left sweep of half a step. The sites (or pairs of sites)
+ * are evolved forward in time and the bond (or site) left behind is evolved backward, both with the Krylov exponential
+ * of the effective hamiltonian. The environments are the dmrg environments, updated along the sweeps and kept from
+ * one time step to the next.
+ * A purely imaginary dt = -i tau gives the imaginary time evolution exp(-tau H). For any other dt, real states are
+ * promoted to complex. The norm of the state is kept by the truncation.
+ * observer, if any, is called after each time step with the step number and the state, whose orthogonality center is
+ * then on the first site.
+ */
+MPS &tdvp(const MPO &hamiltonian, MPS &in_out_state, torch::Scalar dt, size_t steps, const tdvp_options &options = {},
+          const std::function<void(size_t, const MPS &)> &observer = {});
+bMPS &tdvp(const bMPO &hamiltonian, bMPS &in_out_state, torch::Scalar dt, size_t steps,
+           const tdvp_options &options = {}, const std::function<void(size_t, const bMPS &)> &observer = {});
+
 namespace details
 {
 
 btensor dmrg_impl(const bMPO &hamiltonian, const bMPT &two_sites_hamil, bMPS &in_out_state, const dmrg_options &options,
-                  benv_holder &Env, dmrg_logger &logger);
+                  benv_holder &Env, dmrg_logger &logger, size_t first_iteration,
+                  std::optional<btensor> previous_energy);
 torch::Tensor dmrg_impl(const MPO &hamiltonian, const MPT &twosites_hamil, MPS &in_out_state,
                         const dmrg_options &options, env_holder &Env, dmrg_logger &logger);
+torch::Tensor dmrg_impl(const sparse_MPO &hamiltonian, MPS &in_out_state, const dmrg_options &options, env_holder &Env,
+                        dmrg_logger &logger);
 std::tuple<torch::Tensor, torch::Tensor, torch::Tensor> eig2x2Mat(const torch::Tensor &a0, const torch::Tensor &a1,
                                                                   const torch::Tensor &b);
 std::tuple<btensor, btensor, btensor> eig2x2Mat(const btensor &a0, const btensor &a1, const btensor &b);
@@ -96,6 +224,172 @@ qtt_TEST_CASE("btensor dmrg run test")
 	qtt_CHECK_NOTHROW(std::tie(E, state) = dmrg(Hamil, cval(1), opt));
 	// fmt::print("E {}\n\n",E);
 }
+qtt_TEST_CASE("dmrg checkpoint")
+{
+	using cval = quantity<conserved::Z>;
+	auto Hamil = details::random_Z_bMPO(6);
+	auto start = random_MPS(4, Hamil, cval(0));
+	dmrg_options opt;
+	opt.convergence_criterion = 0; // run every sweep, such that the interrupted and complete runs do the same work.
+	opt.maximum_iterations = 6;
+	auto state = start;
+	auto E = dmrg(Hamil, state, opt);
+	// interrupted after 3 sweeps, the last checkpoint may be from an earlier sweep if a write was still underway.
+	auto path = std::filesystem::temp_directory_path() /
+	            fmt::format("quantit_dmrg_checkpoint_test_{:016x}.qtt", std::mt19937_64((std::random_device())())());
+	auto interrupted_opt = opt;
+	interrupted_opt.maximum_iterations = 3;
+	interrupted_opt.checkpoint_path = path.string();
+	interrupted_opt.checkpoint_sweeps = 1;
+	auto interrupted = start;
+	qtt_REQUIRE_NOTHROW(dmrg(Hamil, interrupted, interrupted_opt));
+	qtt_REQUIRE(std::filesystem::exists(path));
+	btensor resumed_E;
+	bMPS resumed;
+	qtt_REQUIRE_NOTHROW(std::tie(resumed_E, resumed) = dmrg_resume(path, opt));
+	qtt_CHECK(size_t(resumed.orthogonality_center) == size_t(state.orthogonality_center));
+	qtt_CHECK(std::abs((resumed_E - E).item().toDouble()) <= 1e-8 * std::abs(E.item().toDouble()));
+	qtt_SUBCASE("mixed precision")
+	{
+		// records the precision of the state after every sweep.
+		struct : public dmrg_default_logger
+		{
+			std::vector<c10::ScalarType> types;
+			using dmrg_default_logger::log_bond_dims;
+			void log_bond_dims(const bMPS &state) override
+			{
+				types.push_back(c10::typeMetaToScalarType(state[0].options().dtype()));
+			}
+		} logger;
+		auto double_hamil = Hamil.to(torch::kFloat64);
+		auto mixed = start.to(torch::kFloat64);
+		auto mixed_opt = interrupted_opt;
+		mixed_opt.mixed_precision = true;
+		mixed_opt.precision_switch_criterion = 0; // the whole interrupted run is the warm-up.
+		qtt_REQUIRE_NOTHROW(dmrg(double_hamil, mixed, mixed_opt));
+		mixed_opt.maximum_iterations = opt.maximum_iterations;
+		mixed_opt.checkpoint_path.clear();
+		// the resumed sweeps are all in double precision, the warm-up isn't run again.
+		qtt_REQUIRE_NOTHROW(dmrg_resume(path, mixed_opt, logger));
+		qtt_REQUIRE_FALSE(logger.types.empty());
+		for (auto type : logger.types)
+			qtt_CHECK(type == torch::kFloat64);
+	}
+	std::filesystem::remove(path);
+}
+qtt_TEST_CASE("dmrg environment storage")
+{
+	using cval = quantity<conserved::Z>;
+	auto Hamil = details::random_Z_bMPO(8);
+	auto start = random_MPS(4, Hamil, cval(0));
+	dmrg_options opt;
+	opt.convergence_criterion = 0;
+	opt.maximum_iterations = 4;
+	auto state = start;
+	auto E = dmrg(Hamil, state, opt);
+	// with a window of a single update, most environments go through the files during each sweep.
+	auto directory = std::filesystem::temp_directory_path() / "quantit_dmrg_environment_test";
+	auto stored_opt = opt;
+	stored_opt.environment_path = directory.string();
+	stored_opt.environment_window = 0;
+	// counts the environment files of the run after every sweep.
+	struct : public dmrg_default_logger
+	{
+		std::filesystem::path directory;
+		std::vector<size_t> counts;
+		void it_log_all(size_t, const btensor &, const bMPS &) override
+		{
+			// the files of the run are in its subdirectory, the files being written are named *.tmp.
+			size_t count = 0;
+			for (const auto &run : std::filesystem::directory_iterator(directory))
+				for (const auto &entry : std::filesystem::directory_iterator(run.path()))
+					count += entry.path().filename().string().rfind("environment_", 0) == 0 and
+					         entry.path().extension() == ".qtt";
+			counts.push_back(count);
+		}
+	} logger;
+	logger.directory = directory;
+	auto stored = start;
+	btensor stored_E;
+	qtt_REQUIRE_NOTHROW(stored_E = dmrg(Hamil, stored, stored_opt, logger));
+	qtt_CHECK(std::abs((stored_E - E).item().toDouble()) <= 1e-8 * std::abs(E.item().toDouble()));
+	// the environments far from the orthogonality center are in files of the run's subdirectory during the sweeps.
+	qtt_REQUIRE(logger.counts.size() == opt.maximum_iterations);
+	for (auto count : logger.counts)
+		qtt_CHECK(count > 0);
+	qtt_CHECK(std::filesystem::is_empty(directory)); // the files are removed at the end.
+	// concurrent runs with the same path don't share files.
+	auto concurrent_hamil = Hamil; // dmrg sets the gradient tracking of its hamiltonian.
+	auto concurrent = start;
+	auto concurrent_run =
+	    std::async(std::launch::async, [&]() { return dmrg(concurrent_hamil, concurrent, stored_opt); });
+	stored = start;
+	qtt_REQUIRE_NOTHROW(stored_E = dmrg(Hamil, stored, stored_opt));
+	auto concurrent_E = concurrent_run.get();
+	qtt_CHECK(std::abs((stored_E - E).item().toDouble()) <= 1e-8 * std::abs(E.item().toDouble()));
+	qtt_CHECK(std::abs((concurrent_E - E).item().toDouble()) <= 1e-8 * std::abs(E.item().toDouble()));
+	qtt_CHECK(std::filesystem::is_empty(directory));
+	std::filesystem::remove(directory);
+}
+qtt_TEST_CASE("dmrg kept spectra")
+{
+	using cval = quantity<conserved::Z>;
+	constexpr size_t L = 6;
+	auto Hamil = details::random_Z_bMPO(L, torch::kFloat64);
+	auto state = random_MPS(4, Hamil, cval(0), torch::kFloat64);
+	state.keep_spectra();
+	dmrg_options opt;
+	opt.maximum_iterations = 2;
+	qtt_REQUIRE_NOTHROW(dmrg(Hamil, state, opt));
+	// the local updates record the spectrum of every bond they decompose with assign_bond.
+	for (size_t bond = 0; bond + 1 < L; ++bond)
+		qtt_REQUIRE(state.spectrum(bond).has_value());
+	state.to_(torch::kFloat32);
+	for (size_t bond = 0; bond + 1 < L; ++bond)
+		qtt_CHECK(state.spectrum(bond)->options().dtype() == torch::kFloat32);
+	auto norm = contract(state, state).item().toDouble();
+	state.move_oc(L - 1);
+	state.move_oc(0);
+	qtt_CHECK(contract(state, state).item().toDouble() == doctest::Approx(norm).epsilon(1e-4));
+	const bMPS &const_state = state;
+	for (size_t i = 1; i < L; ++i)
+	{
+		auto id = tensordot(const_state[i], const_state[i].conj(), {1, 2}, {1, 2}).to_dense();
+		qtt_CHECK(torch::allclose(id, torch::eye(id.size(0), id.options()), 1e-4, 1e-4));
+		// the moves through the spectra don't promote the tensors back to double precision.
+		qtt_CHECK(const_state[i].options().dtype() == torch::kFloat32);
+	}
+}
+qtt_TEST_CASE("idmrg warm start")
+{
+	using cval = quantity<conserved::Z>;
+	auto phys = btensor({{{1, cval(1)}, {1, cval(-1)}}}, cval(0), torch::TensorOptions(torch::kFloat64));
+	dmrg_options opt;
+	opt.maximum_iterations = 10;
+	auto warm_opt = opt;
+	warm_opt.idmrg_warm_start = true;
+	// the even length is grown by pairs only, the odd one ends with a single site.
+	for (auto [length, target] : {std::make_tuple(size_t(4), cval(0)), std::make_tuple(size_t(5), cval(1))})
+	{
+		bMPO Hamil = Heisenberg(torch::tensor(1.0), length, phys);
+		Hamil.to_(torch::kFloat64);
+		// without sweeps, dmrg returns the grown state.
+		auto grown_opt = warm_opt;
+		grown_opt.maximum_iterations = 0;
+		bMPS grown;
+		qtt_REQUIRE_NOTHROW(std::tie(std::ignore, grown) = dmrg(Hamil, target, grown_opt));
+		qtt_CHECK(grown.check_ranks());
+		qtt_CHECK(details::total_quantity(grown) == any_quantity(target));
+		btensor E, cold_E;
+		bMPS state, cold_state;
+		qtt_REQUIRE_NOTHROW(std::tie(E, state) = dmrg(Hamil, target, warm_opt));
+		qtt_CHECK(state.check_ranks());
+		qtt_CHECK(details::total_quantity(state) == any_quantity(target));
+		// the same ground state as the sweeps from a random state.
+		qtt_REQUIRE_NOTHROW(std::tie(cold_E, cold_state) = dmrg(Hamil, target, opt));
+		qtt_CHECK(E.item().toDouble() == doctest::Approx(cold_E.item().toDouble()).epsilon(1e-6));
+	}
+}
 qtt_TEST_CASE("dmrg run test")
 {
 	auto T = torch::rand({2, 5, 2, 5});
@@ -112,6 +406,278 @@ qtt_TEST_CASE("dmrg run test")
 	// std::tie(E,state) = dmrg(Hamil,opt);
 	qtt_CHECK_NOTHROW(std::tie(E, state) = dmrg(Hamil, opt));
 }
+qtt_TEST_CASE("mixed precision dmrg")
+{
+	auto T = torch::rand({2, 5, 2, 5}, torch::kFloat64);
+	MPO Hamil(5, T);
+	dmrg_options opt;
+	opt.maximum_iterations = 10;
+	opt.mixed_precision = true;
+	{
+		using namespace torch::indexing;
+		Hamil[0] = Hamil[0].index({Slice(0, 1), Ellipsis});
+		Hamil[Hamil.size() - 1] = Hamil[Hamil.size() - 1].index({Ellipsis, Slice(0, 1), Slice()});
+	}
+	MPS state = random_MPS(opt.minimum_bond, Hamil, torch::kFloat64);
+	// records the precision of the state after every sweep.
+	struct : public dmrg_default_logger
+	{
+		std::vector<c10::ScalarType> types;
+		using dmrg_default_logger::log_bond_dims;
+		void log_bond_dims(const MPS &state) override { types.push_back(state[0].scalar_type()); }
+	} logger;
+	torch::Tensor E;
+	qtt_REQUIRE_NOTHROW(E = dmrg(Hamil, state, opt, logger));
+	// the first sweeps are in single precision, the following ones in double precision.
+	qtt_REQUIRE_FALSE(logger.types.empty());
+	qtt_CHECK(logger.types.front() == torch::kFloat32);
+	qtt_CHECK(std::is_partitioned(logger.types.begin(), logger.types.end(),
+	                              [](c10::ScalarType type) { return type == torch::kFloat32; }));
+	// the sweeps must always finish in the precision of the input.
+	for (const auto &tens : state)
+		qtt_CHECK(tens.scalar_type() == torch::kFloat64);
+	qtt_CHECK(Hamil[0].scalar_type() == torch::kFloat64);
+}
+qtt_TEST_CASE("sparse MPO dmrg")
+{
+	MPO Hamil = Heisenberg(torch::tensor(1.0), 8).to(torch::kFloat64);
+	sparse_MPO sparse_hamil(Hamil);
+	dmrg_options opt;
+	opt.maximum_iterations = 20;
+	MPS state = random_MPS(opt.minimum_bond, Hamil, torch::kFloat64);
+	MPS sparse_state = state.to(torch::kFloat64, false, true);
+	torch::Tensor E, sparse_E;
+	qtt_REQUIRE_NOTHROW(E = dmrg(Hamil, state, opt));
+	qtt_REQUIRE_NOTHROW(sparse_E = dmrg(sparse_hamil, sparse_state, opt));
+	qtt_CHECK(sparse_E.item().toDouble() == doctest::Approx(E.item().toDouble()).epsilon(1e-6));
+	// the sweeps are those of the dense MPO, with the single precision warm-up.
+	opt.mixed_precision = true;
+	MPS mixed_state = random_MPS(opt.minimum_bond, Hamil, torch::kFloat64);
+	qtt_REQUIRE_NOTHROW(sparse_E = dmrg(sparse_hamil, mixed_state, opt));
+	qtt_CHECK(sparse_E.item().toDouble() == doctest::Approx(E.item().toDouble()).epsilon(1e-6));
+	for (const auto &tens : mixed_state)
+		qtt_CHECK(tens.scalar_type() == torch::kFloat64);
+}
+qtt_TEST_CASE("variance stopping criterion")
+{
+	MPO Hamil = Heisenberg(torch::tensor(1.0), 8).to(torch::kFloat64);
+	dmrg_options opt;
+	opt.cutoff = 1e-12;
+	opt.maximum_iterations = 20;
+	opt.variance_criterion = 1e-8;
+	MPS state = random_MPS(opt.minimum_bond, Hamil, torch::kFloat64);
+	torch::Tensor E;
+	qtt_REQUIRE_NOTHROW(E = dmrg(Hamil, state, opt));
+	qtt_CHECK((energy_variance(Hamil, state) / (E * E)).abs().item().toDouble() < 1e-6);
+}
+qtt_TEST_CASE("tdvp")
+{
+	constexpr size_t L = 6;
+	MPO Hamil = Heisenberg(torch::tensor(1.0), L).to(torch::kFloat64);
+	dmrg_options opt;
+	opt.cutoff = 1e-12;
+	opt.maximum_iterations = 20;
+	MPS ground = random_MPS(opt.minimum_bond, Hamil, torch::kFloat64);
+	auto E = dmrg(Hamil, ground, opt).item().toDouble();
+	qtt_SUBCASE("imaginary time")
+	{
+		MPS state = random_MPS(4, Hamil, torch::kFloat64);
+		qtt_REQUIRE_NOTHROW(tdvp(Hamil, state, c10::complex<double>(0, -0.1), 100));
+		qtt_CHECK(state[0].scalar_type() == torch::kFloat64);
+		auto E_tau = (contract(state, state, Hamil) / contract(state, state)).item().toDouble();
+		qtt_CHECK(E_tau == doctest::Approx(E).epsilon(1e-6));
+	}
+	qtt_SUBCASE("real time")
+	{
+		for (bool two_sites : {true, false})
+		{
+			MPS state = ground;
+			tdvp_options t_opt;
+			t_opt.two_sites = two_sites;
+			// the ground state only acquires a phase.
+			qtt_REQUIRE_NOTHROW(tdvp(Hamil, state, 0.05, 4, t_opt));
+			auto complex_ground = ground.to(torch::kComplexDouble);
+			qtt_CHECK(contract(state, complex_ground).abs().item().toDouble() == doctest::Approx(1).epsilon(1e-8));
+			auto E_t = contract(state, state, Hamil.to(torch::kComplexDouble)).real().item().toDouble();
+			qtt_CHECK(E_t == doctest::Approx(E).epsilon(1e-8));
+		}
+	}
+	qtt_SUBCASE("conserved quantities")
+	{
+		// the krylov exponential and the rescaling of the split with block tensors.
+		using cval = quantity<conserved::Z>;
+		auto phys = btensor({{{1, cval(1)}, {1, cval(-1)}}}, cval(0), torch::TensorOptions(torch::kFloat64));
+		bMPO bHamil = Heisenberg(torch::tensor(1.0), L, phys);
+		bHamil.to_(torch::kFloat64);
+		auto [bE, bground] = dmrg(bHamil, cval(0), opt);
+		qtt_REQUIRE(bE.item().toDouble() == doctest::Approx(E).epsilon(1e-6));
+		auto complex_hamil = bHamil.to(torch::kComplexDouble);
+		auto complex_ground = bground.to(torch::kComplexDouble);
+		auto bE_0 = contract(bground, bground, bHamil).item().toDouble();
+		for (bool two_sites : {true, false})
+		{
+			bMPS state = bground;
+			tdvp_options t_opt;
+			t_opt.two_sites = two_sites;
+			// the ground state only acquires a phase, and stays in its charge sector.
+			qtt_REQUIRE_NOTHROW(tdvp(bHamil, state, 0.05, 4, t_opt));
+			qtt_CHECK(contract(state, complex_ground).abs().item().toDouble() == doctest::Approx(1).epsilon(1e-8));
+			auto E_t = contract(state, state, complex_hamil).item().toComplexDouble().real();
+			qtt_CHECK(E_t == doctest::Approx(bE_0).epsilon(1e-8));
+		}
+	}
+}
+qtt_TEST_CASE("parallel dmrg run test")
+{
+	auto T = torch::rand({2, 5, 2, 5}, torch::kFloat64);
+	T = T + T.permute({0, 3, 2, 1}); // hermitian
+	MPO Hamil(8, T);
+	dmrg_options opt;
+	opt.maximum_iterations = 20;
+	opt.convergence_criterion = 1e-8;
+	{
+		using namespace torch::indexing;
+		Hamil[0] = Hamil[0].index({Slice(0, 1), Ellipsis});
+		Hamil[Hamil.size() - 1] = Hamil[Hamil.size() - 1].index({Ellipsis, Slice(0, 1), Slice()});
+	}
+	MPS state = random_MPS(opt.minimum_bond, Hamil, torch::kFloat64);
+	state.move_oc(state.size() - 1);
+	state.move_oc(0);
+	state[0] /= sqrt(contract(state, state));
+	qtt_CHECK_THROWS_AS(parallel_dmrg(Hamil, state, 5, opt), std::invalid_argument);
+	qtt_REQUIRE_NOTHROW(parallel_dmrg(Hamil, state, 3, opt));
+	qtt_CHECK(state.check_ranks());
+	qtt_CHECK(size_t(state.orthogonality_center) == 0);
+	qtt_CHECK(torch::allclose(contract(state, state), torch::ones({}, torch::kFloat64)));
+	// the assembled state must have the energy of the serial dmrg.
+	auto [E_serial, serial_state] = dmrg(Hamil, opt);
+	auto E_parallel = contract(state, state, Hamil);
+	qtt_CHECK(std::abs((E_parallel - E_serial).item().toDouble()) <= 1e-6 * std::abs(E_serial.item().toDouble()));
+}
+qtt_TEST_CASE("excited state dmrg")
+{
+	auto T = torch::rand({2, 5, 2, 5});
+	T = T + T.permute({0, 3, 2, 1}); // hermitian
+	MPO Hamil(5, T);
+	dmrg_options opt;
+	opt.maximum_iterations = 10;
+	{
+		using namespace torch::indexing;
+		Hamil[0] = Hamil[0].index({Slice(0, 1), Ellipsis});
+		Hamil[Hamil.size() - 1] = Hamil[Hamil.size() - 1].index({Ellipsis, Slice(0, 1), Slice()});
+	}
+	// matrix of the operator represented by a MPO, the first site is the most significant digit of the indices.
+	auto dense_matrix = [](const MPO &mpo)
+	{
+		auto out = mpo[0][0].to(torch::kFloat64); // (out, w, in)
+		for (size_t i = 1; i < mpo.size(); ++i)
+		{
+			auto next = tensordot(out, mpo[i].to(torch::kFloat64), {1}, {0}).permute({0, 2, 3, 1, 4});
+			out = next.reshape({next.sizes()[0] * next.sizes()[1], next.sizes()[2],
+			                    next.sizes()[3] * next.sizes()[4]});
+		}
+		return out.squeeze(1);
+	};
+	// normalized overlap of two states.
+	auto overlap = [](const auto &a, const auto &b)
+	{
+		return std::abs(contract(a, b).item().toDouble()) /
+		       std::sqrt(std::abs((contract(a, a) * contract(b, b)).item().toDouble()));
+	};
+	torch::Tensor E0, E1;
+	MPS ground;
+	qtt_REQUIRE_NOTHROW(std::tie(E0, ground) = dmrg(Hamil, opt));
+	MPS excited = random_MPS(opt.minimum_bond, Hamil);
+	qtt_REQUIRE_NOTHROW(E1 = excited_dmrg(Hamil, excited, {ground}, 1000, opt));
+	qtt_CHECK(excited.check_ranks());
+	// the first excited state: orthogonal to the ground state, with the second lowest eigenvalue.
+	auto spectrum = torch::linalg_eigvalsh(dense_matrix(Hamil));
+	auto width = (spectrum[-1] - spectrum[0]).item().toDouble();
+	auto tol = 1e-3 * width;
+	qtt_CHECK(E0.item().toDouble() == doctest::Approx(spectrum[0].item().toDouble()).epsilon(1e-3).scale(width));
+	qtt_CHECK(E1.item().toDouble() >= E0.item().toDouble() - tol);
+	qtt_CHECK(overlap(excited, ground) < 1e-3);
+	qtt_CHECK(E1.item().toDouble() == doctest::Approx(spectrum[1].item().toDouble()).epsilon(1e-3).scale(width));
+	MPS too_short = random_MPS(4, 2, 2);
+	qtt_CHECK_THROWS_AS(excited_dmrg(Hamil, excited, {too_short}, 1000, opt), std::invalid_argument);
+	qtt_SUBCASE("conserved quantities")
+	{
+		using cval = quantity<conserved::Z>;
+		constexpr size_t L = 5;
+		auto phys = btensor({{{1, cval(1)}, {1, cval(-1)}}}, cval(0), torch::TensorOptions(torch::kFloat64));
+		bMPO bHamil = Heisenberg(torch::tensor(1.0), L, phys);
+		bHamil.to_(torch::kFloat64);
+		btensor bE0, bE1;
+		bMPS bground;
+		qtt_REQUIRE_NOTHROW(std::tie(bE0, bground) = dmrg(bHamil, cval(1), opt));
+		bMPS bexcited = random_MPS(opt.minimum_bond, bHamil, cval(1), torch::kFloat64);
+		qtt_REQUIRE_NOTHROW(bE1 = excited_dmrg(bHamil, bexcited, {bground}, 1000, opt));
+		qtt_CHECK(bexcited.check_ranks());
+		// spectrum of the sector with one more spin up than down: index 0 of a site has the charge +1.
+		auto matrix = dense_matrix(Heisenberg(torch::tensor(1.0), L));
+		std::vector<int64_t> sector;
+		for (int64_t i = 0; i < (int64_t(1) << L); ++i)
+			if (int64_t(L) - 2 * int64_t(std::bitset<L>(i).count()) == 1)
+				sector.push_back(i);
+		auto indices = torch::tensor(sector, torch::kInt64);
+		auto sector_spectrum = torch::linalg_eigvalsh(matrix.index_select(0, indices).index_select(1, indices));
+		auto sector_width = (sector_spectrum[-1] - sector_spectrum[0]).item().toDouble();
+		qtt_CHECK(bE0.item().toDouble() ==
+		          doctest::Approx(sector_spectrum[0].item().toDouble()).epsilon(1e-6).scale(sector_width));
+		qtt_CHECK(bE1.item().toDouble() >= bE0.item().toDouble() - 1e-6 * sector_width);
+		qtt_CHECK(overlap(bexcited, bground) < 1e-3);
+		qtt_CHECK(bE1.item().toDouble() ==
+		          doctest::Approx(sector_spectrum[1].item().toDouble()).epsilon(1e-4).scale(sector_width));
+	}
+}
+qtt_TEST_CASE("batch dmrg")
+{
+	using cval = quantity<conserved::Z>;
+	auto Hamil = details::random_Z_bMPO(5);
+	dmrg_options opt;
+	opt.maximum_iterations = 10;
+	std::vector<dmrg_job> jobs(3, dmrg_job{0, any_quantity(cval(1)), opt, {}});
+	jobs[1].state_constraint = any_quantity(cval(-1));
+	jobs[2].modifier = [](const bMPO &H)
+	{
+		auto out = H;
+		out[0] = out[0].mul(2);
+		return out;
+	};
+	std::vector<dmrg_job_result> results;
+	qtt_REQUIRE_NOTHROW(results = batch_dmrg({Hamil}, jobs, 2));
+	qtt_REQUIRE(results.size() == jobs.size());
+	for (const auto &result : results)
+		qtt_CHECK(result.state.check_ranks());
+	dmrg_job bad_job{1, any_quantity(cval(1)), opt, {}};
+	qtt_CHECK_THROWS_AS(batch_dmrg({Hamil}, {bad_job}), std::invalid_argument);
+	qtt_SUBCASE("checkpoints")
+	{
+		auto directory = std::filesystem::temp_directory_path() /
+		                 fmt::format("quantit_batch_checkpoint_test_{:016x}", std::mt19937_64((std::random_device())())());
+		std::filesystem::create_directories(directory);
+		auto checkpoint_opt = opt;
+		checkpoint_opt.convergence_criterion = 0;
+		checkpoint_opt.maximum_iterations = 3;
+		checkpoint_opt.checkpoint_sweeps = 1;
+		checkpoint_opt.checkpoint_path = (directory / "job.qtt").string();
+		std::vector<dmrg_job> checkpointed(2, dmrg_job{0, any_quantity(cval(1)), checkpoint_opt, {}});
+		checkpointed[1].state_constraint = any_quantity(cval(-1));
+		qtt_CHECK_THROWS_AS(batch_dmrg({Hamil}, checkpointed, 2), std::invalid_argument);
+		checkpointed[1].options.checkpoint_path = (directory / "job_1.qtt").string();
+		qtt_REQUIRE_NOTHROW(results = batch_dmrg({Hamil}, checkpointed, 2));
+		// each file holds the state of its own job, in the job's charge sector.
+		for (size_t j = 0; j < checkpointed.size(); ++j)
+		{
+			btensor E;
+			bMPS state;
+			qtt_REQUIRE_NOTHROW(std::tie(E, state) = dmrg_resume(checkpointed[j].options.checkpoint_path, opt));
+			qtt_CHECK(state.check_ranks());
+			qtt_CHECK(details::total_quantity(state) == checkpointed[j].state_constraint);
+		}
+		std::filesystem::remove_all(directory);
+	}
+}
 qtt_TEST_CASE("2x2 eigen value problem")
 {
 	// setup: a random answer from which we construct a matrix
@@ -138,6 +704,16 @@ qtt_TEST_CASE("2x2 eigen value problem")
 	qtt_CHECK(torch::allclose(T_E0, E0));
 }
 
+qtt_TEST_CASE("2x2 eigen value problem proportional to the identity")
+{
+	// the degenerate case must not produce nans.
+	auto a = torch::rand({}, torch::kFloat64);
+	auto [E, o_coeff, n_coeff] = details::eig2x2Mat(a, a, torch::zeros({}, torch::kFloat64));
+	qtt_CHECK(torch::allclose(E, a));
+	qtt_CHECK(o_coeff.item().toDouble() == 0);
+	qtt_CHECK(n_coeff.item().toDouble() == 1);
+}
+
 qtt_TEST_CASE("Btensor two sites MPO")
 {
 	torch::set_default_dtype(torch::scalarTypeToTypeMeta(
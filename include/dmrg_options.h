@@ -9,6 +9,7 @@
 
 #ifndef INCLUDE_DMRG_OPTIONS_H
 #define INCLUDE_DMRG_OPTIONS_H
+#include <string>
 namespace quantit
 {
 
@@ -22,6 +23,22 @@ struct dmrg_options
 	bool state_gradient; // will default to off! I can't think of a situation where we might want to compute a
 	bool hamil_gradient; // will default to off! I can't think of a situation where we might want to compute a
 	                       // gradient through DMRG, but who knows.
+	bool mixed_precision; // run the first sweeps in single precision, and finish in the precision of the input.
+	double precision_switch_criterion; // energy change below which the sweeps are promoted back to double precision.
+	bool idmrg_warm_start; // grow the initial state with infinite dmrg instead of starting from a random state.
+	double randomized_svd_fraction; // use the randomized svd on the blocks where maximum_bond is below that fraction
+	                                // of the block's smallest dimension, in [0,1].
+	double variance_criterion; // when positive, stop the sweeps once the energy variance relative to the squared energy
+	                           // is below this value, instead of using convergence_criterion.
+	std::string checkpoint_path; // when not empty, the block tensor dmrg writes checkpoints of its sweeps to this file,
+	                             // see dmrg_resume. Excited state searches aren't checkpointed. Concurrent runs need
+	                             // distinct paths, batch_dmrg rejects jobs that share one.
+	size_t checkpoint_sweeps;    // write a checkpoint every that many sweeps, 0 to disable.
+	double checkpoint_seconds;   // write a checkpoint when that many seconds passed since the last one, 0 to disable.
+	std::string environment_path; // when not empty, the block tensor dmrg stores the environments far from the
+	                              // orthogonality center in files of this directory. Each run uses its own
+	                              // subdirectory, concurrent runs can share the path.
+	size_t environment_window;    // number of upcoming updates whose environments are kept in memory.
 
 	// default values for constructors.
 	// if a constructor doesn't require user input for some member, it use the values found in the following definition.
@@ -32,21 +49,47 @@ struct dmrg_options
 	    4; // I have found that dmrg behave better if we prevent bond dimension from going too low.
 	constexpr static size_t def_max_it = 1000;
 	constexpr static bool def_pytorch_gradient = false;
+	constexpr static bool def_mixed_precision = false;
+	constexpr static double def_precision_switch = 1e-3; // well above the single precision noise floor on the energy.
+	constexpr static bool def_idmrg_warm_start = false;
+	constexpr static double def_randomized_svd_fraction = 0; // always exact.
+	constexpr static double def_variance_criterion = 0;      // stop on the energy change.
+	constexpr static size_t def_checkpoint_sweeps = 0;
+	constexpr static double def_checkpoint_seconds = 0;
+	constexpr static size_t def_environment_window = 4;
 
 	dmrg_options(double _cutoff, double _convergence_criterion)
 	    : cutoff(_cutoff), convergence_criterion(_convergence_criterion), maximum_bond(def_max_bond),
-	      minimum_bond(def_min_bond), maximum_iterations(def_max_it), state_gradient(def_pytorch_gradient), hamil_gradient(def_pytorch_gradient)
+	      minimum_bond(def_min_bond), maximum_iterations(def_max_it), state_gradient(def_pytorch_gradient), hamil_gradient(def_pytorch_gradient),
+	      mixed_precision(def_mixed_precision), precision_switch_criterion(def_precision_switch),
+	      idmrg_warm_start(def_idmrg_warm_start), randomized_svd_fraction(def_randomized_svd_fraction),
+	      variance_criterion(def_variance_criterion), checkpoint_path(),
+	      checkpoint_sweeps(def_checkpoint_sweeps), checkpoint_seconds(def_checkpoint_seconds), environment_path(),
+	      environment_window(def_environment_window)
 	{
 	}
 	dmrg_options(size_t _max_bond, size_t _min_bond, size_t _max_iterations)
 	    : cutoff(def_cutoff), convergence_criterion(def_conv_crit), maximum_bond(_max_bond), minimum_bond(_min_bond),
-	      maximum_iterations(_max_iterations), state_gradient(def_pytorch_gradient), hamil_gradient(def_pytorch_gradient)
+	      maximum_iterations(_max_iterations), state_gradient(def_pytorch_gradient), hamil_gradient(def_pytorch_gradient),
+	      mixed_precision(def_mixed_precision), precision_switch_criterion(def_precision_switch),
+	      idmrg_warm_start(def_idmrg_warm_start), randomized_svd_fraction(def_randomized_svd_fraction),
+	      variance_criterion(def_variance_criterion), checkpoint_path(),
+	      checkpoint_sweeps(def_checkpoint_sweeps), checkpoint_seconds(def_checkpoint_seconds), environment_path(),
+	      environment_window(def_environment_window)
 	{
 	}
 	dmrg_options(double _cutoff, double _convergence_criterion, size_t _max_bond, size_t _min_bond,
-	             size_t _max_iterations, bool _state_gradient = def_pytorch_gradient,bool _hamil_gradient = def_pytorch_gradient)
+	             size_t _max_iterations, bool _state_gradient = def_pytorch_gradient,bool _hamil_gradient = def_pytorch_gradient,
+	             bool _mixed_precision = def_mixed_precision, double _precision_switch = def_precision_switch,
+	             bool _idmrg_warm_start = def_idmrg_warm_start,
+	             double _randomized_svd_fraction = def_randomized_svd_fraction,
+	             double _variance_criterion = def_variance_criterion)
 	    : cutoff(_cutoff), convergence_criterion(_convergence_criterion), maximum_bond(_max_bond),
-	      minimum_bond(_min_bond), maximum_iterations(_max_iterations), state_gradient(_state_gradient), hamil_gradient(_hamil_gradient)
+	      minimum_bond(_min_bond), maximum_iterations(_max_iterations), state_gradient(_state_gradient), hamil_gradient(_hamil_gradient),
+	      mixed_precision(_mixed_precision), precision_switch_criterion(_precision_switch),
+	      idmrg_warm_start(_idmrg_warm_start), randomized_svd_fraction(_randomized_svd_fraction),
+	      variance_criterion(_variance_criterion), checkpoint_path(), checkpoint_sweeps(def_checkpoint_sweeps),
+	      checkpoint_seconds(def_checkpoint_seconds), environment_path(), environment_window(def_environment_window)
 	{
 	}
 	dmrg_options() : dmrg_options(def_cutoff, def_conv_crit) {}
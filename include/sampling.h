@@ -0,0 +1,82 @@
+/*
+ * File: sampling.h
+ * Project: QuantiT
+ * File Created: Sunday, 18th October 2026 9:14:05 pm
+ * Author: Alexandre Foley (Alexandre.foley@usherbrooke.ca)
+ * Copyright (c) 2026 Alexandre Foley
+ * Licensed under GPL v3
+ */
+
+#ifndef INCLUDE_SAMPLING_H
+#define INCLUDE_SAMPLING_H
+
+#include "MPT.h"
+#include "blockTensor/btensor.h"
+#include <cmath>
+#include <torch/torch.h>
+
+#include "doctest/doctest_proxy.h"
+
+namespace quantit
+{
+
+/**
+ * @brief Draw independent configurations of the physical indices with the probabilities given by the state.
+ *
+ * The orthogonality center of a copy of the state is moved to the first site, the sites to its right are then right
+ * canonical and the probability of the value of a site given the values to its left is the norm of a single site
+ * contraction. The samples are drawn site by site from these conditional probabilities, without markov chain and
+ * therefore without autocorrelation. A batch of samples is drawn at once: the left vectors of the samples are stacked
+ * along a batch index, such that each site costs one batched contraction for the whole batch. The site tensors of a
+ * bMPS are converted to dense tensors for this contraction.
+ *
+ * @param state the state, need not be normalized. It is left unchanged.
+ * @param n_samples number of samples
+ * @param batch_size number of samples drawn at once, limits the memory used to batch_size*bond*phys elements.
+ * @return torch::Tensor integer tensor of shape (n_samples, length), the values are the indices of the physical
+ * dimension of each site.
+ */
+torch::Tensor sample(const MPS &state, size_t n_samples, size_t batch_size = 4096);
+torch::Tensor sample(const bMPS &state, size_t n_samples, size_t batch_size = 4096);
+
+qtt_TEST_CASE("sampling")
+{
+	torch::manual_seed(0);
+	qtt_SUBCASE("distribution")
+	{
+		constexpr int64_t L = 4;
+		constexpr int64_t n_samples = 20000;
+		auto state = random_MPS(L, 3, 2, torch::kFloat64);
+		// probabilities of every configuration, from the full state vector
+		auto psi = state[0];
+		for (int64_t i = 1; i < L; ++i)
+			psi = torch::tensordot(psi, state[i], {-1}, {0});
+		auto probabilities = psi.reshape({-1}).square();
+		probabilities /= probabilities.sum();
+		auto samples = sample(state, n_samples, 3000); // the last batch is incomplete.
+		qtt_REQUIRE(samples.sizes() == torch::IntArrayRef{n_samples, L});
+		qtt_REQUIRE(samples.scalar_type() == torch::kInt64);
+		auto configuration = torch::zeros({n_samples}, torch::kInt64);
+		for (int64_t i = 0; i < L; ++i)
+			configuration = configuration * 2 + samples.select(1, i);
+		auto frequencies = torch::bincount(configuration, {}, 1 << L).to(torch::kFloat64) / n_samples;
+		// 5 standard deviations of the largest possible statistical error.
+		qtt_CHECK(torch::allclose(frequencies, probabilities, 0, 5 * 0.5 / std::sqrt(n_samples)));
+	}
+	qtt_SUBCASE("conserved quantities")
+	{
+		using cval = quantity<conserved::Z, conserved::Z>;
+		auto phys_ind = sparse_zeros({{{1, cval(0, 0)}, {1, cval(1, -1)}, {1, cval(1, 1)}, {1, cval(2, 0)}}},
+		                             cval(0, 0)); // physical index for electrons
+		auto state = random_MPS(4, 4, phys_ind, cval(4, 0)); // random MPS with 4 electrons, and bond dimension of 4.
+		auto samples = sample(state, 100);
+		auto particles = torch::tensor({0, 1, 1, 2}, torch::kInt64);
+		auto spin = torch::tensor({0, -1, 1, 0}, torch::kInt64);
+		qtt_CHECK(torch::all(particles.index({samples}).sum(1) == 4).item().toBool());
+		qtt_CHECK(torch::all(spin.index({samples}).sum(1) == 0).item().toBool());
+	}
+}
+
+} // namespace quantit
+
+#endif // INCLUDE_SAMPLING_H
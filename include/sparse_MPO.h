@@ -0,0 +1,155 @@
+/*
+ * File: sparse_MPO.h
+ * Project: QuantiT
+ * File Created: Sunday, 18th October 2026 2:12:05 pm
+ * Author: Alexandre Foley (Alexandre.foley@usherbrooke.ca)
+ * Copyright (c) 2026 Alexandre Foley
+ * Licensed under GPL v3
+ */
+
+#ifndef INCLUDE_SPARSE_MPO_H
+#define INCLUDE_SPARSE_MPO_H
+
+#include "MPT.h"
+#include "models.h"
+#include <torch/torch.h>
+#include <vector>
+
+#include "doctest/doctest_proxy.h"
+
+namespace quantit
+{
+
+/**
+ * @brief A non-zero entry of a MPO tensor: the local operator at index op of the site, multiplied by coefficient, on
+ * the left and right bond elements.
+ */
+struct sparse_MPO_term
+{
+	int64_t left;
+	int64_t right;
+	size_t op;
+	torch::Scalar coefficient;
+};
+
+/**
+ * @brief Operator valued representation of a rank 4 MPO tensor.
+ *
+ * Only the non-zero entries of the matrix of operators are stored, as terms. Operators that differ only by a factor are
+ * stored once, such that the products of an operator with the state can be shared by all the terms that use it.
+ * The operators have the index ordering of the physical indices of the dense tensor: (out, in).
+ */
+class sparse_MPO_site
+{
+  public:
+	int64_t left_dim;
+	int64_t right_dim;
+	std::vector<torch::Tensor> operators;
+	std::vector<sparse_MPO_term> terms;
+
+	sparse_MPO_site() : left_dim(0), right_dim(0) {}
+	/**
+	 * @brief extract the non-zero entries of a dense MPO tensor.
+	 *
+	 * @param tensor rank 4 tensor with the usual MPO index ordering: (left, out, right, in)
+	 * @param cutoff entries with no element larger than cutoff in absolute value are dropped, and operators that differ
+	 * by no more than cutoff once normalized are shared. With the default, only identical operators are shared.
+	 */
+	explicit sparse_MPO_site(const torch::Tensor &tensor, double cutoff = 0);
+
+	torch::Tensor to_dense() const;
+};
+
+/**
+ * @brief Matrix product operator stored as a chain of sparse_MPO_site.
+ *
+ * Environments and the effective hamiltonian are applied term by term with the dedicated compute_left_env,
+ * compute_right_env and hamil2site_times_state overloads, which skip the zero entries of the operator matrices. Worth
+ * it for MPO mostly made of zeros, such as those of hamiltonians on 2D cylinders.
+ */
+class sparse_MPO
+{
+	std::vector<sparse_MPO_site> sites;
+
+  public:
+	using iterator = std::vector<sparse_MPO_site>::iterator;
+	using const_iterator = std::vector<sparse_MPO_site>::const_iterator;
+
+	sparse_MPO() = default;
+	explicit sparse_MPO(const MPO &dense, double cutoff = 0);
+
+	MPO to_MPO() const;
+	/**
+	 * @brief copy of the sparse MPO with its operators converted to dtype. The coefficients are left as is.
+	 */
+	sparse_MPO to(torch::ScalarType dtype) const;
+
+	size_t size() const { return sites.size(); }
+	sparse_MPO_site &operator[](size_t i) { return sites[i]; }
+	const sparse_MPO_site &operator[](size_t i) const { return sites[i]; }
+	iterator begin() { return sites.begin(); }
+	iterator end() { return sites.end(); }
+	const_iterator begin() const { return sites.begin(); }
+	const_iterator end() const { return sites.end(); }
+};
+
+/**
+ * @brief update the left environment with the site tensor MPS, term by term.
+ * Same result and index ordering as for the dense MPO tensor.
+ */
+torch::Tensor compute_left_env(const sparse_MPO_site &Hamil, const torch::Tensor &MPS, const torch::Tensor &left_env);
+/**
+ * @brief update the right environment with the site tensor MPS, term by term.
+ * Same result and index ordering as for the dense MPO tensor.
+ */
+torch::Tensor compute_right_env(const sparse_MPO_site &Hamil, const torch::Tensor &MPS,
+                                const torch::Tensor &right_env);
+/**
+ * @brief apply the two sites effective hamiltonian to the two sites state.
+ *
+ * The left site is contracted first and its terms are summed on each element of the middle bond, then the terms of the
+ * right site are grouped by operator and right bond element, such that every distinct product is computed once.
+ */
+torch::Tensor hamil2site_times_state(const torch::Tensor &state, const sparse_MPO_site &left_hamil,
+                                     const sparse_MPO_site &right_hamil, const torch::Tensor &Lenv,
+                                     const torch::Tensor &Renv);
+
+qtt_TEST_CASE("sparse MPO")
+{
+	auto hamil = Heisenberg(torch::tensor(1.0), 6);
+	sparse_MPO sparse_hamil(hamil);
+	qtt_REQUIRE(sparse_hamil.size() == hamil.size());
+	// the bulk of the heisenberg MPO has 8 non-zero entries, with 4 distinct operators.
+	qtt_CHECK(sparse_hamil[2].terms.size() == 8);
+	qtt_CHECK(sparse_hamil[2].operators.size() == 4);
+	auto dense = sparse_hamil.to_MPO();
+	for (size_t i = 0; i < hamil.size(); ++i)
+		qtt_CHECK(torch::allclose(dense[i], hamil[i]));
+	auto state = random_MPS(6, hamil, hamil[0].options());
+	auto Lenv = torch::rand({state[2].sizes()[0], hamil[2].sizes()[0], state[2].sizes()[0]}, state[2].options());
+	auto Renv = torch::rand({state[3].sizes()[2], hamil[3].sizes()[2], state[3].sizes()[2]}, state[3].options());
+	qtt_SUBCASE("environments")
+	{
+		auto L = compute_left_env(sparse_hamil[2], state[2], Lenv);
+		auto dense_L = tensordot(tensordot(tensordot(Lenv, state[2], {0}, {0}), hamil[2], {0, 2}, {0, 3}),
+		                         state[2].conj(), {0, 2}, {0, 1});
+		qtt_CHECK(torch::allclose(L, dense_L));
+		auto R = compute_right_env(sparse_hamil[3], state[3], Renv);
+		auto dense_R = tensordot(tensordot(tensordot(Renv, state[3], {0}, {2}), hamil[3], {0, 3}, {2, 3}),
+		                         state[3].conj(), {3, 0}, {1, 2});
+		qtt_CHECK(torch::allclose(R, dense_R));
+	}
+	qtt_SUBCASE("effective hamiltonian")
+	{
+		auto theta = tensordot(state[2], state[3], {2}, {0});
+		auto twosites = tensordot(hamil[2], hamil[3], {2}, {0}).permute({0, 1, 3, 4, 2, 5});
+		auto dense_out = tensordot(tensordot(tensordot(Lenv, theta, {0}, {0}), twosites, {0, 2, 3}, {0, 4, 5}), Renv,
+		                           {1, 4}, {0, 1});
+		auto out = hamil2site_times_state(theta, sparse_hamil[2], sparse_hamil[3], Lenv, Renv);
+		qtt_CHECK(torch::allclose(out, dense_out));
+	}
+}
+
+} // namespace quantit
+
+#endif // INCLUDE_SPARSE_MPO_H
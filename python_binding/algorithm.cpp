@@ -3,6 +3,8 @@
 #include <pybind11/pybind11.h>
 #include <pybind11/cast.h>
 #include <pybind11/stl.h>
+#include <pybind11/functional.h>
+#include <pybind11/complex.h>
 
 #include "utilities.h"
 #include "dmrg_logger.h"
@@ -27,14 +29,29 @@ void init_algorithms(py::module &m)
 	    .def_readwrite("maximum_iterations", &dmrg_options::maximum_iterations,"maximum number of sweeps before a hard stop")
 	    .def_readwrite("state_gradient", &dmrg_options::state_gradient,"Wether to allow gradient computation of the state through the DMRG")
 	    .def_readwrite("hamil_gradient", &dmrg_options::hamil_gradient,"Wether to allow gradient computation of the hamiltonian through the DMRG")
-	    .def(py::init<double, double, size_t, size_t, size_t, bool, bool>(),
+	    .def_readwrite("mixed_precision", &dmrg_options::mixed_precision,"Wether to run the first sweeps in single precision")
+	    .def_readwrite("precision_switch_criterion", &dmrg_options::precision_switch_criterion,"energy change below which the sweeps are promoted back to double precision")
+	    .def_readwrite("idmrg_warm_start", &dmrg_options::idmrg_warm_start,"Wether to grow the initial state with infinite dmrg instead of starting from a random state")
+	    .def_readwrite("randomized_svd_fraction", &dmrg_options::randomized_svd_fraction,"use the randomized svd on the blocks where max_bond is below that fraction of the block's smallest dimension")
+	    .def_readwrite("variance_criterion", &dmrg_options::variance_criterion,"when positive, stop once the energy variance relative to the squared energy is below this value instead of using the energy change")
+	    .def_readwrite("checkpoint_path", &dmrg_options::checkpoint_path,"when not empty, the block tensor dmrg writes checkpoints of its sweeps to this file in a background thread, see dmrg_resume")
+	    .def_readwrite("checkpoint_sweeps", &dmrg_options::checkpoint_sweeps,"write a checkpoint every that many sweeps, 0 to disable")
+	    .def_readwrite("checkpoint_seconds", &dmrg_options::checkpoint_seconds,"write a checkpoint when that many seconds passed since the last one, 0 to disable")
+	    .def_readwrite("environment_path", &dmrg_options::environment_path,"when not empty, the block tensor dmrg stores the environments far from the orthogonality center in files of this directory")
+	    .def_readwrite("environment_window", &dmrg_options::environment_window,"number of upcoming updates whose environments are kept in memory")
+	    .def(py::init<double, double, size_t, size_t, size_t, bool, bool, bool, double, bool, double, double>(),
 	         py::kw_only(),
 	         py::arg("cutoff") = dmrg_options::def_cutoff,
 	         py::arg("convergence_criterion") = dmrg_options::def_conv_crit,
 	         py::arg("max_bond") = dmrg_options::def_max_bond, py::arg("min_bond") = dmrg_options::def_min_bond,
 	         py::arg("maximum_iterations") = dmrg_options::def_max_it,
 	         py::arg("state_gradient") = dmrg_options::def_pytorch_gradient,
-	         py::arg("hamil_gradient") = dmrg_options::def_pytorch_gradient,"Constructor for dmrg_options");
+	         py::arg("hamil_gradient") = dmrg_options::def_pytorch_gradient,
+	         py::arg("mixed_precision") = dmrg_options::def_mixed_precision,
+	         py::arg("precision_switch_criterion") = dmrg_options::def_precision_switch,
+	         py::arg("idmrg_warm_start") = dmrg_options::def_idmrg_warm_start,
+	         py::arg("randomized_svd_fraction") = dmrg_options::def_randomized_svd_fraction,
+	         py::arg("variance_criterion") = dmrg_options::def_variance_criterion,"Constructor for dmrg_options");
 
 	/**
 	 * Apply the DMRG algorithm to solve the ground state of the input hamiltonian given as a MPO.
@@ -60,6 +77,50 @@ void init_algorithms(py::module &m)
 	// &options,
 	//                                     dmrg_logger &logger = dummy_logger);
 	alg.def("dmrg",[](bMPO& mpo,any_quantity qt, const dmrg_options& opt,dmrg_default_logger& logger){return dmrg(mpo,qt,opt,logger);},"perform dmrg on a random starting MPS with the specified constraint and the supplied MPO",py::arg("MPO"),py::arg("constraint"),py::arg("dmrg_options"),py::arg("dmrg_logger")=dummy_logger);
+	// std::tuple<btensor, bMPS> dmrg_resume(const std::filesystem::path &path, const dmrg_options &options,
+	//                                       dmrg_logger &logger = dummy_logger);
+	alg.def("dmrg_resume",[](const std::string& path, const dmrg_options& opt,dmrg_default_logger& logger){return dmrg_resume(path,opt,logger);},"resume dmrg from a checkpoint file, without recomputing the environments",py::arg("path"),py::arg("dmrg_options"),py::arg("dmrg_logger")=dummy_logger);
+
+	// torch::Tensor parallel_dmrg(MPO &hamiltonian, MPS &in_out_state, size_t num_segments, const dmrg_options &options,
+	//                             dmrg_logger &logger = dummy_logger);
+	alg.def("parallel_dmrg",[](MPO& mpo, MPS& mps, size_t num_segments, const dmrg_options& opt,dmrg_default_logger& logger){return parallel_dmrg(mpo,mps,num_segments,opt,logger);},"perform real-space parallel dmrg on the supplied MPS and MPO, with one thread per segment",py::arg("MPO"),py::arg("MPS"),py::arg("num_segments"),py::arg("dmrg_options"),py::arg("dmrg_logger")=dummy_logger);
+	// btensor parallel_dmrg(bMPO &hamiltonian, bMPS &in_out_state, size_t num_segments, const dmrg_options &options,
+	//                       dmrg_logger &logger = dummy_logger);
+	alg.def("parallel_dmrg",[](bMPO& mpo, bMPS& mps, size_t num_segments, const dmrg_options& opt,dmrg_default_logger& logger){return parallel_dmrg(mpo,mps,num_segments,opt,logger);},"perform real-space parallel dmrg on the supplied MPS and MPO, with one thread per segment",py::arg("MPO"),py::arg("MPS"),py::arg("num_segments"),py::arg("dmrg_options"),py::arg("dmrg_logger")=dummy_logger);
+	// torch::Tensor excited_dmrg(MPO &hamiltonian, MPS &in_out_state, const std::vector<MPS> &references, double weight,
+	//                            const dmrg_options &options, dmrg_logger &logger = dummy_logger);
+	alg.def("excited_dmrg",[](MPO& mpo, MPS& mps, const std::vector<MPS>& references, double weight, const dmrg_options& opt,dmrg_default_logger& logger){return excited_dmrg(mpo,mps,references,weight,opt,logger);},"perform dmrg on the supplied MPS with the MPO penalized by the projectors on the reference states",py::arg("MPO"),py::arg("MPS"),py::arg("references"),py::arg("weight"),py::arg("dmrg_options"),py::arg("dmrg_logger")=dummy_logger);
+	// btensor excited_dmrg(bMPO &hamiltonian, bMPS &in_out_state, const std::vector<bMPS> &references, double weight,
+	//                      const dmrg_options &options, dmrg_logger &logger = dummy_logger);
+	alg.def("excited_dmrg",[](bMPO& mpo, bMPS& mps, const std::vector<bMPS>& references, double weight, const dmrg_options& opt,dmrg_default_logger& logger){return excited_dmrg(mpo,mps,references,weight,opt,logger);},"perform dmrg on the supplied MPS with the MPO penalized by the projectors on the reference states",py::arg("MPO"),py::arg("MPS"),py::arg("references"),py::arg("weight"),py::arg("dmrg_options"),py::arg("dmrg_logger")=dummy_logger);
+	py::class_<tdvp_options>(alg, "tdvp_options")
+	    .def(py::init<>())
+	    .def_readwrite("cutoff", &tdvp_options::cutoff, "truncation of the two sites update")
+	    .def_readwrite("maximum_bond", &tdvp_options::maximum_bond, "maximum bond dimension allowed")
+	    .def_readwrite("minimum_bond", &tdvp_options::minimum_bond, "minimum bond dimension allowed")
+	    .def_readwrite("krylov_dimension", &tdvp_options::krylov_dimension, "maximum size of the Krylov subspace of the exponentials")
+	    .def_readwrite("krylov_tolerance", &tdvp_options::krylov_tolerance, "estimated error at which the Krylov exponentials stop")
+	    .def_readwrite("two_sites", &tdvp_options::two_sites, "Wether to use the two sites update, the single site update keeps the bond dimension");
+	alg.def("tdvp",[](const MPO& mpo, MPS& mps, std::complex<double> dt, size_t steps, const tdvp_options& opt, const std::function<void(size_t, const MPS &)>& observer) -> MPS& {return tdvp(mpo,mps,c10::complex<double>(dt.real(),dt.imag()),steps,opt,observer);},"evolve the MPS by exp(-i dt H) steps times with the time dependent variational principle",py::arg("MPO"),py::arg("MPS"),py::arg("dt"),py::arg("steps"),py::arg("tdvp_options")=tdvp_options(),py::arg("observer")=std::function<void(size_t, const MPS &)>());
+	alg.def("tdvp",[](const bMPO& mpo, bMPS& mps, std::complex<double> dt, size_t steps, const tdvp_options& opt, const std::function<void(size_t, const bMPS &)>& observer) -> bMPS& {return tdvp(mpo,mps,c10::complex<double>(dt.real(),dt.imag()),steps,opt,observer);},"evolve the MPS by exp(-i dt H) steps times with the time dependent variational principle",py::arg("MPO"),py::arg("MPS"),py::arg("dt"),py::arg("steps"),py::arg("tdvp_options")=tdvp_options(),py::arg("observer")=std::function<void(size_t, const bMPS &)>());
+	py::class_<dmrg_job>(alg, "dmrg_job", "a ground state search for batch_dmrg")
+	    .def(py::init([](size_t hamiltonian, const any_quantity &state_constraint, const dmrg_options &options,
+	                     std::function<bMPO(const bMPO &)> modifier)
+	                  { return dmrg_job{hamiltonian, state_constraint, options, modifier}; }),
+	         py::arg("hamiltonian"), py::arg("state_constraint"), py::arg("dmrg_options"),
+	         py::arg("modifier") = std::function<bMPO(const bMPO &)>())
+	    .def_readwrite("hamiltonian", &dmrg_job::hamiltonian)
+	    .def_readwrite("state_constraint", &dmrg_job::state_constraint)
+	    .def_readwrite("options", &dmrg_job::options)
+	    .def_readwrite("modifier", &dmrg_job::modifier);
+	py::class_<dmrg_job_result>(alg, "dmrg_job_result", "energy, state and sweep log of a dmrg_job")
+	    .def_readonly("energy", &dmrg_job_result::energy)
+	    .def_readonly("state", &dmrg_job_result::state)
+	    .def_readonly("logger", &dmrg_job_result::logger);
+	// std::vector<dmrg_job_result> batch_dmrg(const std::vector<bMPO> &hamiltonians, const std::vector<dmrg_job> &jobs,
+	//                                         size_t max_concurrent_jobs = 0);
+	alg.def("batch_dmrg", &batch_dmrg, "run many dmrg ground state searches concurrently", py::arg("hamiltonians"),
+	        py::arg("jobs"), py::arg("max_concurrent_jobs") = 0, py::call_guard<py::gil_scoped_release>());
 }
 
 template <class logger_base = dmrg_default_logger>
@@ -48,13 +48,18 @@ void init_linalg_qtt(py::module &m)
 	               py::arg("max_size") = std::numeric_limits<size_t>::max(), py::arg("pow") = 2);
 	linalg_sub.def("svd",
 	               wrap_scalar([](const btensor &tens, int split, btensor::Scalar tol, size_t min_size, size_t max_size,
-	                              btensor::Scalar pow) { return svd(tens, split, tol, min_size, max_size, pow); }),
+	                              btensor::Scalar pow, double randomized_fraction)
+	                           { return svd(tens, split, tol, min_size, max_size, pow,
+	                                        randomized_svd_options(randomized_fraction)); }),
 	               "compute the tensor singular value decomposition, implicitly reshape to rank 2 according to the "
 	               "split value. truncates the smallest singular values without introducing an absolute reconstruction "
 	               "error larger than "
-	               "the tolerence with a pow-norm. The number of singular value kept is always in [min_size,max_size]",
+	               "the tolerence with a pow-norm. The number of singular value kept is always in [min_size,max_size]. "
+	               "The blocks where max_size is smaller than randomized_fraction times their smallest dimension are "
+	               "decomposed with a randomized svd.",
 	               py::arg("tensor"), py::arg("split"), py::arg("tol"), py::kw_only(), py::arg("min_size") = 1,
-	               py::arg("max_size") = std::numeric_limits<size_t>::max(), py::arg("pow") = 2);
+	               py::arg("max_size") = std::numeric_limits<size_t>::max(), py::arg("pow") = 2,
+	               py::arg("randomized_fraction") = 0.0);
 	// std::tuple<btensor, btensor> eigh(const btensor &tensor, BOOL upper = false);
 	linalg_sub.def(
 	    "eigh", [](const btensor &tens, bool upper) { return eigh(tens, upper); },
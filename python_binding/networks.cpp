@@ -6,6 +6,10 @@
 #include <torch/types.h>
 
 #include "MPT.h"
+#include "MPO_apply.h"
+#include "checkpoint.h"
+#include "correlations.h"
+#include "sampling.h"
 
 using namespace quantit;
 using namespace utils;
@@ -221,11 +225,31 @@ void init_networks(py::module &m)
 	MPS_MPO(pybMPO);
 	MPS_only(pyMPS);
 	MPS_only(pybMPS);
+	pybMPS.def("keep_spectra", &bMPS::keep_spectra,
+	           "keep the singular values of the bonds computed by move_oc and dmrg. Disabling discards them.",
+	           py::arg("enable") = true);
+	pybMPS.def_property_readonly("keeps_spectra", &bMPS::keeps_spectra);
+	pybMPS.def("spectrum", &bMPS::spectrum,
+	           "singular values of the bond between the sites bond and bond+1, None if they aren't known",
+	           py::arg("bond"));
+	sub.def("entanglement_entropy", &quantit::entanglement_entropy,
+	        "von Neumann entanglement entropy of the bond between the sites bond and bond+1, from the kept spectrum",
+	        py::arg("MPS"), py::arg("bond"));
 	// bMPO only.
 	pybMPO.def("coalesce", wrap_scalar([](bMPO &self, btensor::Scalar cutoff) { return self.coalesce(cutoff); }),
 	           "simplify the block representation of the tensors with a gauge transform. Can introduce an "
 	           "approximation smaller or equal to the cutoff on each tensors",
 	           py::arg("cutoff") = 0);
+	pybMPO.def(
+	    "compress", [](bMPO &self, double tol, size_t max_bond) { return compress(self, tol, max_bond); },
+	    "reduce the bond dimension with canonicalizing SVD sweeps, the truncation error tolerated on each bond is tol "
+	    "times the squared norm of the operator",
+	    py::arg("tol"), py::arg("max_bond") = std::numeric_limits<size_t>::max());
+	pyMPO.def(
+	    "compress", [](MPO &self, double tol, size_t max_bond) { return compress(self, tol, max_bond); },
+	    "reduce the bond dimension with canonicalizing SVD sweeps, the truncation error tolerated on each bond is tol "
+	    "times the squared norm of the operator",
+	    py::arg("tol"), py::arg("max_bond") = std::numeric_limits<size_t>::max());
 
 	// MPS random_MPS(size_t length, size_t bond_dim, size_t phys_dim, torch::TensorOptions opt = {});
 	sub.def("random_MPS", TOPT_binder<size_t, size_t, size_t>::bind(&quantit::random_MPS), "Generate a random MPS",
@@ -279,6 +303,97 @@ void init_networks(py::module &m)
 	// btensor contract(const bMPS &a, const bMPS &b);
 	sub.def("contract", py::overload_cast<const bMPS &, const bMPS &>(&quantit::contract),
 	        "contract to a scalar the two given MPS", py::arg("bra"), py::arg("ket"));
+	py::enum_<quantit::contraction_order>(sub, "contraction_order")
+	    .value("sequential", quantit::contraction_order::sequential)
+	    .value("tree", quantit::contraction_order::tree)
+	    .value("automatic", quantit::contraction_order::automatic);
+	sub.def("contract", py::overload_cast<const MPS &, const MPS &, const MPO &, contraction_order>(&quantit::contract),
+	        "contract to a scalar the two given MPS with the MPO, in the given order", py::arg("bra"), py::arg("ket"),
+	        py::arg("operator"), py::arg("order"));
+	sub.def("contract", py::overload_cast<const MPS &, const MPS &, contraction_order>(&quantit::contract),
+	        "contract to a scalar the two given MPS, in the given order", py::arg("bra"), py::arg("ket"),
+	        py::arg("order"));
+	sub.def("contract",
+	        py::overload_cast<const bMPS &, const bMPS &, const bMPO &, contraction_order>(&quantit::contract),
+	        "contract to a scalar the two given MPS with the MPO, in the given order", py::arg("bra"), py::arg("ket"),
+	        py::arg("operator"), py::arg("order"));
+	sub.def("contract", py::overload_cast<const bMPS &, const bMPS &, contraction_order>(&quantit::contract),
+	        "contract to a scalar the two given MPS, in the given order", py::arg("bra"), py::arg("ket"),
+	        py::arg("order"));
+	sub.def("zip_up", py::overload_cast<const MPO &, const MPS &, double, size_t>(&quantit::zip_up),
+	        "product of the MPO with the MPS, truncated on the fly by the zip-up algorithm", py::arg("MPO"),
+	        py::arg("MPS"), py::arg("tol"), py::arg("max_bond") = std::numeric_limits<size_t>::max());
+	sub.def("zip_up", py::overload_cast<const bMPO &, const bMPS &, double, size_t>(&quantit::zip_up),
+	        "product of the MPO with the MPS, truncated on the fly by the zip-up algorithm", py::arg("MPO"),
+	        py::arg("MPS"), py::arg("tol"), py::arg("max_bond") = std::numeric_limits<size_t>::max());
+	sub.def("expectation_values",
+	        py::overload_cast<const MPS &, const std::vector<torch::Tensor> &>(&quantit::expectation_values),
+	        "expectation value of each operator on every site", py::arg("MPS"), py::arg("operators"));
+	sub.def("expectation_values",
+	        py::overload_cast<const bMPS &, const std::vector<btensor> &>(&quantit::expectation_values),
+	        "expectation value of each operator on every site", py::arg("MPS"), py::arg("operators"));
+	sub.def(
+	    "correlations",
+	    [](const MPS &state,
+	       const std::vector<std::tuple<torch::Tensor, torch::Tensor, std::optional<torch::Tensor>>> &ops)
+	    {
+		    std::vector<two_point_operator<torch::Tensor>> correlators;
+		    for (const auto &[left, right, string] : ops)
+			    correlators.push_back({left, right, string});
+		    return correlations(state, correlators);
+	    },
+	    "matrix of the two-point correlations <left_i right_j> for each (left, right, string) triplet. The string is "
+	    "applied on the sites between i and j, None for the identity.",
+	    py::arg("MPS"), py::arg("operators"));
+	sub.def(
+	    "correlations",
+	    [](const bMPS &state, const std::vector<std::tuple<btensor, btensor, std::optional<btensor>>> &ops)
+	    {
+		    std::vector<two_point_operator<btensor>> correlators;
+		    for (const auto &[left, right, string] : ops)
+			    correlators.push_back({left, right, string});
+		    return correlations(state, correlators);
+	    },
+	    "matrix of the two-point correlations <left_i right_j> for each (left, right, string) triplet. The string is "
+	    "applied on the sites between i and j, None for the identity.",
+	    py::arg("MPS"), py::arg("operators"));
+	sub.def("sample", py::overload_cast<const MPS &, size_t, size_t>(&quantit::sample),
+	        "independent samples of the physical indices, drawn site by site from the conditional probabilities",
+	        py::arg("MPS"), py::arg("n_samples"), py::arg("batch_size") = 4096);
+	sub.def("sample", py::overload_cast<const bMPS &, size_t, size_t>(&quantit::sample),
+	        "independent samples of the physical indices, drawn site by site from the conditional probabilities",
+	        py::arg("MPS"), py::arg("n_samples"), py::arg("batch_size") = 4096);
+	sub.def(
+	    "save", [](const btensor &tensor, const std::string &path) { save(tensor, path); },
+	    "write the block tensor to a checkpoint file", py::arg("tensor"), py::arg("path"));
+	sub.def(
+	    "save", [](const bMPS &state, const std::string &path) { save(state, path); },
+	    "write the MPS to a checkpoint file", py::arg("MPS"), py::arg("path"));
+	sub.def(
+	    "save", [](const bMPO &op, const std::string &path) { save(op, path); },
+	    "write the MPO to a checkpoint file", py::arg("MPO"), py::arg("path"));
+	sub.def(
+	    "load_btensor", [](const std::string &path, bool memory_map) { return load_btensor(path, memory_map); },
+	    "read a block tensor from a checkpoint file, the blocks are views of the memory mapped file by default",
+	    py::arg("path"), py::arg("memory_map") = true);
+	sub.def(
+	    "load_bMPS", [](const std::string &path, bool memory_map) { return load_bMPS(path, memory_map); },
+	    "read a MPS from a checkpoint file, the blocks are views of the memory mapped file by default",
+	    py::arg("path"), py::arg("memory_map") = true);
+	sub.def(
+	    "load_bMPO", [](const std::string &path, bool memory_map) { return load_bMPO(path, memory_map); },
+	    "read a MPO from a checkpoint file, the blocks are views of the memory mapped file by default",
+	    py::arg("path"), py::arg("memory_map") = true);
+	sub.def("variational_apply",
+	        py::overload_cast<const MPO &, const MPS &, double, size_t, size_t, double>(&quantit::variational_apply),
+	        "product of the MPO with the MPS, optimized by two-site sweeps at fixed maximum bond dimension",
+	        py::arg("MPO"), py::arg("MPS"), py::arg("tol"), py::arg("max_bond") = std::numeric_limits<size_t>::max(),
+	        py::arg("max_sweeps") = 4, py::arg("convergence") = 1e-10);
+	sub.def("variational_apply",
+	        py::overload_cast<const bMPO &, const bMPS &, double, size_t, size_t, double>(&quantit::variational_apply),
+	        "product of the MPO with the MPS, optimized by two-site sweeps at fixed maximum bond dimension",
+	        py::arg("MPO"), py::arg("MPS"), py::arg("tol"), py::arg("max_bond") = std::numeric_limits<size_t>::max(),
+	        py::arg("max_sweeps") = 4, py::arg("convergence") = 1e-10);
 
 	// bMPS random_bMPS(size_t length, size_t bond_dim, const btensor &phys_dim_spec, any_quantity_cref q_num,
 	//                  unsigned int seed = (std::random_device())(), torch::TensorOptions opt = {});
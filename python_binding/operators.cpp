@@ -3,6 +3,8 @@
 
 #include "operators.h"
 #include "models.h"
+#include "auto_MPO.h"
+#include <pybind11/stl.h>
 #include "utilities.h"
 
 using namespace quantit;
@@ -35,4 +37,34 @@ void init_operators(py::module &m)
 	sub.def("Hubbard",utils::wrap_scalar([](torch::Scalar U,torch::Scalar mu,size_t l){return Hubbard(torch::full({},U),torch::full({},mu),l);}),"build a MPO for a linear Hubbard model with interaction U,chemical potential mu and a given length",py::arg("U"),py::arg("mu"),py::arg("length"));
 	// bMPO Hubbard(torch::Tensor U, torch::Tensor mu, size_t lenght,btensor local_shape)
 	sub.def("Hubbard",utils::wrap_scalar([](torch::Scalar U,torch::Scalar mu,size_t l,const btensor& shape){return Hubbard(torch::full({},U),torch::full({},mu),l,shape);}),"build a MPO for a linear Hubbard model with interaction U,chemical potential mu, a given length and conservation law specified by physical_shape",py::arg("U"),py::arg("mu"),py::arg("length"),py::arg("physical_shape"));
+	py::class_<site_operator>(sub, "site_operator", "a local operator acting on a given site of the chain")
+	    .def(py::init([](torch::Tensor op, size_t site, bool fermionic) { return site_operator{op, site, fermionic}; }),
+	         py::arg("op"), py::arg("site"), py::arg("fermionic") = false)
+	    .def_readwrite("op", &site_operator::op)
+	    .def_readwrite("site", &site_operator::site)
+	    .def_readwrite("fermionic", &site_operator::fermionic);
+	py::class_<auto_MPO>(sub, "auto_MPO",
+	                     "build a MPO from a sum of products of local operators, with a bond dimension minimized on "
+	                     "each bond")
+	    .def(py::init<size_t, int64_t, torch::Tensor>(), py::arg("length"), py::arg("local_dim"),
+	         py::arg("fermion_string") = torch::Tensor())
+	    .def("add",
+	         utils::wrap_scalar([](auto_MPO &self, torch::Scalar coefficient, std::vector<site_operator> ops)
+	                            { self.add(coefficient, std::move(ops)); }),
+	         "add coefficient*ops[0]*ops[1]*... to the hamiltonian", py::arg("coefficient"), py::arg("ops"))
+	    .def("__len__", &auto_MPO::size)
+	    .def(
+	        "to_MPO",
+	        [](const auto_MPO &self, utils::opt<utils::stype> dtype, double cutoff)
+	        { return self.to_MPO(dtype ? torch::TensorOptions(*dtype) : torch::TensorOptions(), cutoff); },
+	        "build the MPO", py::kw_only(), py::arg("dtype") = utils::opt<utils::stype>(), py::arg("cutoff") = 1e-12)
+	    .def(
+	        "to_bMPO",
+	        [](const auto_MPO &self, const btensor &physical_shape, utils::opt<utils::stype> dtype, double cutoff)
+	        {
+		        return self.to_bMPO(physical_shape, dtype ? torch::TensorOptions(*dtype) : torch::TensorOptions(),
+		                            cutoff);
+	        },
+	        "build the MPO with the conservation law specified by physical_shape", py::arg("physical_shape"),
+	        py::kw_only(), py::arg("dtype") = utils::opt<utils::stype>(), py::arg("cutoff") = 1e-12);
 }
\ No newline at end of file
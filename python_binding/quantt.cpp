@@ -295,6 +295,15 @@ PYBIND11_MODULE(quantit, m)
 	      py::arg("shape_tensor"), py::arg("values"), py::arg("cutoff") = 1e-16, py::kw_only(),
 	      py::arg("dtype") = opt<stype>(), py::arg("device") = opt<tdev>(), py::arg("requires_grad") = opt<bool>(),
 	      py::arg("pin_memory") = opt<bool>());
+	m.def("from_coo",
+	      wrap_scalar(TOPT_binder<const torch::Tensor &, const torch::Tensor &, const btensor &, int64_t, int64_t,
+	                              const torch::Scalar>::bind(&quantit::from_coo)),
+	      "Generate a block tensor from the coordinates (rank,N) and values (N) of its non-zero elements. The sections "
+	      "and conserved quantities of the missing dimension are inferred from the elements, the other dimensions and "
+	      "the selection rule are those of the partial shape.",
+	      py::arg("indices"), py::arg("values"), py::arg("partial_shape"), py::arg("missing_dim"),
+	      py::arg("missing_size") = -1, py::arg("cutoff") = 1e-16, py::kw_only(), py::arg("dtype") = opt<stype>(),
+	      py::arg("device") = opt<tdev>(), py::arg("requires_grad") = opt<bool>(), py::arg("pin_memory") = opt<bool>());
 
 	// python implicitly define the other order for the operators with heterogenous types.
 	//  inline btensor operator>(const btensor &A, btensor::Scalar other) { return greater(A, other); }
@@ -410,6 +419,53 @@ PYBIND11_MODULE(quantit, m)
 	// dim
 	uniform_call(
 	    m, pybtensor, "dim", [](const btensor &a) { return a.dim(); }, "the rank of the tensor", py::arg("self"));
+	// structure and blocks in bulk, without copying the blocks.
+	uniform_call(
+	    m, pybtensor, "export_blocks",
+	    [](const btensor &self)
+	    {
+		    const auto rank = static_cast<int64_t>(self.dim());
+		    auto index_opt = torch::TensorOptions().dtype(torch::kInt64);
+		    std::vector<int64_t> section_sizes;
+		    for (int64_t d = 0; d < rank; ++d)
+		    {
+			    auto [sizes_begin, sizes_end] = self.section_sizes(d);
+			    section_sizes.insert(section_sizes.end(), sizes_begin, sizes_end);
+		    }
+		    std::vector<int64_t> selection_rule;
+		    self.selection_rule->get().serialize(selection_rule);
+		    std::vector<int64_t> quantities;
+		    for (any_quantity_cref qt : self.get_cvals())
+			    qt.serialize(quantities);
+		    std::vector<int64_t> block_indices;
+		    std::vector<torch::Tensor> blocks;
+		    block_indices.reserve(rank * (self.end() - self.begin()));
+		    blocks.reserve(self.end() - self.begin());
+		    for (const auto &[index, block] : self)
+		    {
+			    block_indices.insert(block_indices.end(), index.begin(), index.end());
+			    // DLPack refuses tensors that require grad or hold a lazy conjugation or negation, resolving them
+			    // only copies the blocks that have one.
+			    blocks.push_back(block.detach().resolve_conj().resolve_neg());
+		    }
+		    const auto groups = static_cast<int64_t>(selection_rule.size());
+		    py::dict out;
+		    out["quantity_type"] = self.selection_rule->get().type_tag();
+		    out["selection_rule"] = torch::tensor(selection_rule, index_opt);
+		    out["sections_by_dim"] = torch::tensor(self.section_numbers(), index_opt);
+		    out["section_sizes"] = torch::tensor(section_sizes, index_opt);
+		    out["quantities"] =
+		        torch::tensor(quantities, index_opt).reshape({static_cast<int64_t>(section_sizes.size()), groups});
+		    out["block_indices"] =
+		        torch::tensor(block_indices, index_opt).reshape({static_cast<int64_t>(blocks.size()), rank});
+		    out["blocks"] = blocks;
+		    return out;
+	    },
+	    "return the structure of the tensor as integer tensors and its blocks, in a dictionary. The blocks share their "
+	    "memory with the btensor, numpy.from_dlpack and jax.dlpack read them without copy. Keys: quantity_type, "
+	    "selection_rule and quantities (one row per section, ordered by dimension) hold the integer values of the "
+	    "conserved quantities; sections_by_dim, section_sizes, block_indices (one row per block) and blocks.",
+	    py::arg("self"));
 	// btensor add(const btensor &other, Scalar alpha = 1) const;
 	uniform_call(m, pybtensor, "add",
 	             wrap_scalar([](const btensor &self, const btensor &other, c10::Scalar alpha)
@@ -0,0 +1,198 @@
+/*
+ * File: MPO_apply.cpp
+ * Project: QuantiT
+ * File Created: Sunday, 18th October 2026 6:40:31 pm
+ * Author: Alexandre Foley (Alexandre.foley@usherbrooke.ca)
+ * Copyright (c) 2026 Alexandre Foley
+ * Licensed under GPL v3
+ */
+
+#include "MPO_apply.h"
+#include "LinearAlgebra.h"
+#include "blockTensor/LinearAlgebra.h"
+#include "dmrg.h"
+#include <cmath>
+#include <stdexcept>
+#include <vector>
+
+namespace quantit
+{
+
+namespace
+{
+
+template <class MPO_t, class MPS_t>
+void check_apply_args(const MPO_t &op, const MPS_t &state)
+{
+	if (op.size() != state.size())
+		throw std::invalid_argument(
+		    fmt::format("the MPO and the MPS must have the same length, got {} and {}", op.size(), state.size()));
+	if (state.size() == 0)
+		throw std::invalid_argument("cannot apply a MPO to an empty MPS");
+}
+
+template <class MPO_t, class MPS_t>
+MPS_t zip_up_impl(const MPO_t &op, const MPS_t &state, double tol, size_t max_bond)
+{
+	check_apply_args(op, state);
+	const size_t length = state.size();
+	// move_oc replaces the tensors of the copy, the input is left untouched.
+	MPS_t in(state);
+	in.move_oc(0);
+	MPS_t out(length, length - 1);
+	auto left_edge = ones_like(details::edge_shape_prep(op.front(), 0), torch::TensorOptions().requires_grad(false));
+	// carried tensor, index ordering: (a, s', w, b)
+	auto T = tensordot(tensordot(left_edge, op[0], {0}, {0}), in[0], {2}, {1}).permute({2, 0, 1, 3});
+	for (size_t i = 0; i + 1 < length; ++i)
+	{
+		auto [U, d, V] = svd(T, 2, tol, 1, max_bond);
+		out[i] = U;
+		auto carry = V.conj().mul(d).permute({2, 0, 1}); // (k, w, b)
+		T = tensordot(tensordot(carry, in[i + 1], {2}, {0}), op[i + 1], {1, 2}, {0, 3}).permute({0, 2, 3, 1});
+	}
+	auto right_edge = ones_like(details::edge_shape_prep(op.back(), 2), torch::TensorOptions().requires_grad(false));
+	out[length - 1] = tensordot(T, right_edge, {2}, {0});
+	return out;
+}
+
+/**
+ * Environments of <bra|op|ket>, with the index ordering of the dmrg environments: (ket, op, bra)
+ */
+template <class Tens>
+Tens mixed_left_env(const Tens &op, const Tens &ket, const Tens &bra, const Tens &left_env)
+{
+	auto out = tensordot(left_env, ket, {0}, {0});
+	out = tensordot(out, op, {0, 2}, {0, 3});
+	return tensordot(out, bra.conj(), {0, 2}, {0, 1});
+}
+template <class Tens>
+Tens mixed_right_env(const Tens &op, const Tens &ket, const Tens &bra, const Tens &right_env)
+{
+	auto out = tensordot(right_env, ket, {0}, {2});
+	out = tensordot(out, op, {0, 3}, {2, 3});
+	return tensordot(out, bra.conj(), {3, 0}, {1, 2});
+}
+/**
+ * Projection of op|ket> on the basis of the environments of the bra, on the sites (i,i+1).
+ * output index ordering: (a, s1, s2, b)
+ */
+template <class Tens>
+Tens local_product(const Tens &left_env, const Tens &ket_l, const Tens &ket_r, const Tens &op_l, const Tens &op_r,
+                   const Tens &right_env)
+{
+	auto out = tensordot(left_env, ket_l, {0}, {0});  // (w, a', s1, m)
+	out = tensordot(out, op_l, {0, 2}, {0, 3});       // (a', m, s1', w1)
+	out = tensordot(out, ket_r, {1}, {0});            // (a', s1', w1, s2, b)
+	out = tensordot(out, op_r, {2, 3}, {0, 3});       // (a', s1', b, s2', w2)
+	return tensordot(out, right_env, {2, 4}, {0, 1}); // (a', s1', s2', b')
+}
+
+template <class MPO_t, class MPS_t>
+MPS_t variational_apply_impl(const MPO_t &op, const MPS_t &state, double tol, size_t max_bond, size_t max_sweeps,
+                             double convergence)
+{
+	using Tens = typename MPS_t::Tens;
+	auto out = zip_up_impl(op, state, tol, max_bond);
+	const size_t length = state.size();
+	if (length < 2)
+		return out;
+	out.move_oc(0);
+	// env[i] is the environment of the bond to the left of site i, env[length] that of the right edge.
+	std::vector<Tens> left_env(length + 1);
+	std::vector<Tens> right_env(length + 1);
+	left_env[0] =
+	    ones_like(shape_from(details::edge_shape_prep(state.front(), 0), details::edge_shape_prep(op.front(), 0),
+	                         details::edge_shape_prep(out.front(), 0).inverse_cvals()),
+	              torch::TensorOptions().requires_grad(false));
+	right_env[length] =
+	    ones_like(shape_from(details::edge_shape_prep(state.back(), 2), details::edge_shape_prep(op.back(), 2),
+	                         details::edge_shape_prep(out.back(), 2).inverse_cvals()),
+	              torch::TensorOptions().requires_grad(false));
+	for (size_t i = length - 1; i > 0; --i)
+		right_env[i] = mixed_right_env(op[i], state[i], out[i], right_env[i + 1]);
+	double norm2 = 0;
+	for (size_t sweep = 0; sweep < max_sweeps; ++sweep)
+	{
+		double prev_norm2 = norm2;
+		for (size_t i = 0; i + 1 < length; ++i)
+		{
+			auto theta = local_product(left_env[i], state[i], state[i + 1], op[i], op[i + 1], right_env[i + 2]);
+			auto [u, d, v] = svd(theta, 2, tol, 1, max_bond);
+			out[i] = u;
+			out[i + 1] = v.mul(d).conj().permute({2, 0, 1});
+			left_env[i + 1] = mixed_left_env(op[i], state[i], out[i], left_env[i]);
+		}
+		for (size_t i = length - 1; i > 0; --i)
+		{
+			auto theta = local_product(left_env[i - 1], state[i - 1], state[i], op[i - 1], op[i], right_env[i + 1]);
+			auto [u, d, v] = svd(theta, 2, tol, 1, max_bond);
+			out[i - 1] = u.mul(d);
+			out[i] = v.conj().permute({2, 0, 1});
+			right_env[i] = mixed_right_env(op[i], state[i], out[i], right_env[i + 1]);
+			if (i == 1)
+				norm2 = (d * d).sum().item().toDouble();
+		}
+		if (std::abs(norm2 - prev_norm2) <= convergence * norm2)
+			break;
+	}
+	return out;
+}
+
+template <class MPO_t, class MPS_t>
+auto expectation_squared_impl(const MPO_t &op, const MPS_t &state)
+{
+	check_apply_args(op, state);
+	// environment index ordering: (ket, first op, second op, bra)
+	auto op_left = details::edge_shape_prep(op.front(), 0);
+	auto state_left = details::edge_shape_prep(state.front(), 0);
+	auto env = ones_like(shape_from(state_left, op_left, op_left, state_left.inverse_cvals()),
+	                     torch::TensorOptions().requires_grad(false));
+	for (size_t i = 0; i < state.size(); ++i)
+	{
+		env = tensordot(env, state[i], {0}, {0});              // (w1, w2, a', s, b)
+		env = tensordot(env, op[i], {0, 3}, {0, 3});           // (w2, a', b, s', w1)
+		env = tensordot(env, op[i], {0, 3}, {0, 3});           // (a', b, w1, s'', w2)
+		env = tensordot(env, state[i].conj(), {0, 3}, {0, 1}); // (b, w1, w2, b')
+	}
+	auto op_right = details::edge_shape_prep(op.back(), 2);
+	auto state_right = details::edge_shape_prep(state.back(), 2);
+	auto right_edge = ones_like(shape_from(state_right, op_right, op_right, state_right.inverse_cvals()),
+	                            torch::TensorOptions().requires_grad(false));
+	return tensordot(env, right_edge, {0, 1, 2, 3}, {0, 1, 2, 3});
+}
+
+template <class MPO_t, class MPS_t>
+auto energy_variance_impl(const MPO_t &hamil, const MPS_t &state)
+{
+	auto norm = contract(state, state);
+	auto E = contract(state, state, hamil) / norm;
+	return expectation_squared_impl(hamil, state) / norm - E * E;
+}
+
+} // namespace
+
+MPS zip_up(const MPO &op, const MPS &state, double tol, size_t max_bond)
+{
+	return zip_up_impl(op, state, tol, max_bond);
+}
+bMPS zip_up(const bMPO &op, const bMPS &state, double tol, size_t max_bond)
+{
+	return zip_up_impl(op, state, tol, max_bond);
+}
+MPS variational_apply(const MPO &op, const MPS &state, double tol, size_t max_bond, size_t max_sweeps,
+                      double convergence)
+{
+	return variational_apply_impl(op, state, tol, max_bond, max_sweeps, convergence);
+}
+bMPS variational_apply(const bMPO &op, const bMPS &state, double tol, size_t max_bond, size_t max_sweeps,
+                       double convergence)
+{
+	return variational_apply_impl(op, state, tol, max_bond, max_sweeps, convergence);
+}
+
+torch::Tensor expectation_squared(const MPO &op, const MPS &state) { return expectation_squared_impl(op, state); }
+btensor expectation_squared(const bMPO &op, const bMPS &state) { return expectation_squared_impl(op, state); }
+torch::Tensor energy_variance(const MPO &hamil, const MPS &state) { return energy_variance_impl(hamil, state); }
+btensor energy_variance(const bMPO &hamil, const bMPS &state) { return energy_variance_impl(hamil, state); }
+
+} // namespace quantit
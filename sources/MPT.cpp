@@ -16,10 +16,15 @@
 #include "blockTensor/LinearAlgebra.h"
 #include "blockTensor/btensor.h"
 #include "dmrg.h"
+#include <ATen/Parallel.h>
+#include <algorithm>
+#include <cmath>
 #include <exception>
 #include <fmt/core.h>
 #include <fmt/ranges.h>
+#include <numeric>
 #include <random>
+#include <vector>
 // TODO: remove all explicit torch:: function call. Can ADL be my friend here?
 namespace quantit
 {
@@ -76,40 +81,149 @@ void bMPS::move_oc(int i)
 {
 	if (not(i >= 0 and i < size()))
 		throw std::invalid_argument(" Proposed orthogonality center falls outside the MPS");
-
+	// modifications through the base class, only the spectra of the bonds that are crossed are updated.
+	auto &tensors = static_cast<vector_lift<bMPS, btensor> &>(*this);
 	while (i < orthogonality_center)
 	{
 		// move right
-		auto &curr_oc = (*this)[orthogonality_center];
-		auto &next_oc = (*this)[orthogonality_center - 1];
+		const size_t bond = oc - 1;
+		if (not move_with_spectrum(bond, -1))
+		{
+			auto &curr_oc = tensors[orthogonality_center];
+			auto &next_oc = tensors[orthogonality_center - 1];
 
-		auto [u, d, v] = quantit::svd(curr_oc, 1);
-		curr_oc =
-		    v.conj().permute({2, 0, 1}); // needs testing. svd documentation makes no mention of complex numbers case.
+			auto [u, d, v] = quantit::svd(curr_oc, 1);
+			// needs testing. svd documentation makes no mention of complex numbers case.
+			curr_oc = v.conj().permute({2, 0, 1});
 
-		// testing shows that v is only transposed in the complex number case as well.
-		auto ud = u.mul(d);
-		next_oc = tensordot(next_oc, ud, {2}, {0});
+			// testing shows that v is only transposed in the complex number case as well.
+			auto ud = u.mul(d);
+			next_oc = tensordot(next_oc, ud, {2}, {0});
+			record_spectrum(bond, std::move(d));
+		}
 		--oc;
 	}
 
 	while (i > orthogonality_center)
 	{
 		// move left
-		auto &curr_oc = (*this)[orthogonality_center];
-		auto &next_oc = (*this)[orthogonality_center + 1];
-		// TODO: use QuantiT's SVD implementation. takes care of the reshaping
-		auto [u, d, v] = svd(curr_oc, 2);
-		curr_oc = u;
-
-		auto dv = v.mul(d).conj();
-		next_oc = tensordot(dv, next_oc, {0}, {0});
-
+		const size_t bond = oc;
+		if (not move_with_spectrum(bond, 1))
+		{
+			auto &curr_oc = tensors[orthogonality_center];
+			auto &next_oc = tensors[orthogonality_center + 1];
+			// TODO: use QuantiT's SVD implementation. takes care of the reshaping
+			auto [u, d, v] = svd(curr_oc, 2);
+			curr_oc = u;
+
+			auto dv = v.mul(d).conj();
+			next_oc = tensordot(dv, next_oc, {0}, {0});
+			record_spectrum(bond, std::move(d));
+		}
 		++oc;
 	}
 	// otherwise we're already there, do nothing.
 }
 
+void bMPS::keep_spectra(bool enable)
+{
+	keep = enable;
+	spectra.clear();
+	in_gauge.clear();
+	reset_spectra();
+}
+const std::optional<btensor> &bMPS::spectrum(size_t bond) const
+{
+	static const std::optional<btensor> unknown = std::nullopt;
+	if (bond + 1 >= size())
+		throw std::out_of_range(fmt::format("bond {} is beyond the last bond of the MPS", bond));
+	return keep ? spectra[bond] : unknown;
+}
+void bMPS::assign_bond(size_t bond, Tens left, Tens right, Tens values)
+{
+	auto &tensors = static_cast<vector_lift<bMPS, btensor> &>(*this);
+	tensors.at(bond) = std::move(left);
+	tensors.at(bond + 1) = std::move(right);
+	record_spectrum(bond, std::move(values));
+}
+void bMPS::reset_spectra()
+{
+	if (not keep)
+		return;
+	const size_t bonds = size() > 0 ? size() - 1 : 0;
+	spectra.assign(bonds, std::nullopt);
+	in_gauge.assign(bonds, false);
+}
+void bMPS::discard_spectra(size_t site)
+{
+	if (not keep or site >= size())
+		return;
+	for (size_t bond = site > 0 ? site - 1 : 0; bond <= site and bond < spectra.size(); ++bond)
+	{
+		spectra[bond].reset();
+		in_gauge[bond] = false;
+	}
+}
+/**
+ * The tensors of the sites of the bond have changed, the spectra of the neighbouring bonds are kept but they are no
+ * longer in the gauge of the tensors.
+ */
+void bMPS::record_spectrum(size_t bond, Tens values)
+{
+	if (not keep)
+		return;
+	if (bond > 0)
+		in_gauge[bond - 1] = false;
+	if (bond + 1 < in_gauge.size())
+		in_gauge[bond + 1] = false;
+	spectra[bond] = std::move(values);
+	in_gauge[bond] = true;
+}
+/**
+ * Move the orthogonality center over the bond with its spectrum. Possible when the spectrum was computed with the
+ * current tensors, such that the center is the product of a canonical tensor with the spectrum, and when no singular
+ * value is too small to be inverted accurately.
+ *
+ * step is 1 to move the center from the site bond to bond+1, -1 for the other way around.
+ */
+bool bMPS::move_with_spectrum(size_t bond, int step)
+{
+	if (not keep or not in_gauge[bond] or not spectra[bond])
+		return false;
+	const auto &d = *spectra[bond];
+	auto values = d.to_dense().abs();
+	constexpr double smallest_inverted = 1e-6; // relative to the largest value.
+	if (values.numel() == 0 or !(values.min() > smallest_inverted * values.max()).item().toBool())
+		return false;
+	auto &tensors = static_cast<vector_lift<bMPS, btensor> &>(*this);
+	auto &left = tensors[bond];
+	auto &right = tensors[bond + 1];
+	// the spectrum multiplies the last index of the left tensor, and its conjugate the first index of the right one.
+	if (step > 0)
+	{
+		left = left.div(d);
+		right = right.permute({1, 2, 0}).mul(d.conj()).permute({2, 0, 1});
+	}
+	else
+	{
+		left = left.mul(d);
+		right = right.permute({1, 2, 0}).div(d.conj()).permute({2, 0, 1});
+	}
+	record_spectrum(bond, d);
+	return true;
+}
+
+double entanglement_entropy(const bMPS &state, size_t bond)
+{
+	const auto &values = state.spectrum(bond);
+	if (not values)
+		throw std::logic_error(fmt::format("the spectrum of bond {} isn't known", bond));
+	auto p = values->to_dense().abs().square();
+	p = p / p.sum();
+	p = p.masked_select(p > 0);
+	return -(p * p.log()).sum().item().toDouble();
+}
+
 bool MPS::check_one(const Tens &tens)
 {
 	// check correctness on fill candidate
@@ -167,6 +281,38 @@ bMPO &bMPO::coalesce(btensor::Scalar cutoff)
 	return *this;
 }
 
+/**
+ * @brief shared implementation of compress for MPO and bMPO.
+ */
+template <class MPO_t>
+MPO_t &compress_impl(MPO_t &hamil, double tol, size_t max_bond)
+{
+	if (hamil.size() < 2)
+		return hamil;
+	// left canonical form, only the exactly vanishing singular values are dropped.
+	for (auto it = hamil.begin(), next_it = hamil.begin() + 1; next_it != hamil.end(); ++it, ++next_it)
+	{
+		auto [U, d, V] = svd(it->permute({0, 1, 3, 2}), 3, torch::Scalar(0.0));
+		*next_it = tensordot(V.conj().mul(d), *next_it, {0}, {0});
+		*it = U.permute({0, 1, 3, 2});
+	}
+	// the norm of the orthogonality center is the norm of the whole operator, it sets the scale of the tolerance.
+	auto &center = hamil.back();
+	auto norm2 = (center * center.conj()).sum().abs().item().toDouble();
+	for (auto it = hamil.end() - 1, prev_it = hamil.end() - 2;; --it, --prev_it)
+	{
+		// the svd tolerance bounds the square root of the discarded weight.
+		auto [U, d, V] = svd(*it, 1, std::sqrt(tol * norm2), 1, max_bond);
+		*it = V.conj().permute({3, 0, 1, 2});
+		*prev_it = tensordot(*prev_it, U.mul(d), {2}, {0}).permute({0, 1, 3, 2});
+		if (prev_it == hamil.begin())
+			break;
+	}
+	return hamil;
+}
+MPO &compress(MPO &hamil, double tol, size_t max_bond) { return compress_impl(hamil, tol, max_bond); }
+bMPO &compress(bMPO &hamil, double tol, size_t max_bond) { return compress_impl(hamil, tol, max_bond); }
+
 bool MPO::check_ranks() const
 {
 	auto prev_bond = operator[](0).sizes()[0];
@@ -219,7 +365,9 @@ btensor contract(const bMPS &a, const bMPS &b, const bMPO &obs, btensor left_edg
 	}
 	return tensordot(left_edge, right_edge, {0, 1, 2}, {0, 1, 2});
 }
-btensor contract(const bMPS &a, const bMPS &b, const bMPO &obs)
+namespace
+{
+std::tuple<btensor, btensor> edges(const bMPS &a, const bMPS &b, const bMPO &obs)
 {
 	// todo:: adapt to work with Btensors.
 	// need a btensor implementation of ones. must be a one_like thing.
@@ -229,6 +377,36 @@ btensor contract(const bMPS &a, const bMPS &b, const bMPO &obs)
 	    eye_like(shape_from(shape_from(a.back(), {0, 0, -1}).inverse_cvals_(), shape_from(b.back(), {0, 0, -1})));
 	left_edge = tensordot(left_edge, ones_like(details::edge_shape_prep(obs.front(), 0)), {}, {}).permute({0, 2, 1});
 	right_edge = tensordot(right_edge, ones_like(details::edge_shape_prep(obs.back(), 2)), {}, {}).permute({0, 2, 1});
+	return {std::move(left_edge), std::move(right_edge)};
+}
+std::tuple<torch::Tensor, torch::Tensor> edges(const MPS &a, const MPS &b, const MPO &obs)
+{
+	auto left_edge =
+	    eye_like(shape_from(shape_from(a.front(), {-1, 0, 0}).inverse_cvals_(), shape_from(b.front(), {-1, 0, 0})));
+	auto right_edge =
+	    eye_like(shape_from(shape_from(a.back(), {0, 0, -1}).inverse_cvals_(), shape_from(b.back(), {0, 0, -1})));
+	left_edge = tensordot(left_edge, ones_like(shape_from(obs[0], {-1, 0, 0, 0})), {}, {}).permute({0, 2, 1});
+	right_edge = tensordot(right_edge, ones_like(shape_from(obs.back(), {0, 0, -1, 0})), {}, {}).permute({0, 2, 1});
+	return {std::move(left_edge), std::move(right_edge)};
+}
+std::tuple<torch::Tensor, torch::Tensor> edges(const MPS &a, const MPS &b)
+{
+	auto left_edge = eye_like(shape_from(shape_from(a[0], {-1, 0, 0}), shape_from((b[0]), {-1, 0, 0})));
+	auto right_edge = eye_like(shape_from(shape_from(a.back(), {0, 0, -1}), shape_from((b.back()), {0, 0, -1})));
+	return {std::move(left_edge), std::move(right_edge)};
+}
+std::tuple<btensor, btensor> edges(const bMPS &a, const bMPS &b)
+{
+	auto left_edge =
+	    eye_like(shape_from(a.front().shape_from({-1, 0, 0}).inverse_cvals_(), b.front().shape_from({-1, 0, 0})));
+	auto right_edge =
+	    eye_like(shape_from(a.back().shape_from({0, 0, -1}).inverse_cvals_(), b.back().shape_from({0, 0, -1})));
+	return {std::move(left_edge), std::move(right_edge)};
+}
+} // namespace
+btensor contract(const bMPS &a, const bMPS &b, const bMPO &obs)
+{
+	auto [left_edge, right_edge] = edges(a, b, obs);
 	return contract(a, b, obs, std::move(left_edge), right_edge);
 }
 torch::Tensor contract(const MPS &a, const MPS &b, const MPO &obs, torch::Tensor left_edge,
@@ -246,12 +424,7 @@ torch::Tensor contract(const MPS &a, const MPS &b, const MPO &obs, torch::Tensor
 
 torch::Tensor contract(const MPS &a, const MPS &b, const MPO &obs)
 {
-	auto left_edge =
-	    eye_like(shape_from(shape_from(a.front(), {-1, 0, 0}).inverse_cvals_(), shape_from(b.front(), {-1, 0, 0})));
-	auto right_edge =
-	    eye_like(shape_from(shape_from(a.back(), {0, 0, -1}).inverse_cvals_(), shape_from(b.back(), {0, 0, -1})));
-	left_edge = tensordot(left_edge, ones_like(shape_from(obs[0], {-1, 0, 0, 0})), {}, {}).permute({0, 2, 1});
-	right_edge = tensordot(right_edge, ones_like(shape_from(obs.back(), {0, 0, -1, 0})), {}, {}).permute({0, 2, 1});
+	auto [left_edge, right_edge] = edges(a, b, obs);
 	return contract(a, b, obs, std::move(left_edge), right_edge);
 }
 
@@ -267,9 +440,8 @@ torch::Tensor contract(const MPS &a, const MPS &b, torch::Tensor left_edge, cons
 }
 torch::Tensor contract(const MPS &a, const MPS &b)
 {
-	auto E = eye_like(shape_from(shape_from(a[0], {-1, 0, 0}), shape_from((b[0]), {-1, 0, 0})));
-	auto right_edge = eye_like(shape_from(shape_from(a.back(), {0, 0, -1}), shape_from((b.back()), {0, 0, -1})));
-	return contract(a, b, E, right_edge);
+	auto [left_edge, right_edge] = edges(a, b);
+	return contract(a, b, std::move(left_edge), right_edge);
 }
 
 btensor contract(const bMPS &a, const bMPS &b, btensor left_edge, const btensor &right_edge)
@@ -284,12 +456,206 @@ btensor contract(const bMPS &a, const bMPS &b, btensor left_edge, const btensor
 }
 btensor contract(const bMPS &a, const bMPS &b)
 {
-	auto left_edge =
-	    eye_like(shape_from(a.front().shape_from({-1, 0, 0}).inverse_cvals_(), b.front().shape_from({-1, 0, 0})));
-	auto right_edge =
-	    eye_like(shape_from(a.back().shape_from({0, 0, -1}).inverse_cvals_(), b.back().shape_from({0, 0, -1})));
-	return contract(a, b, left_edge, right_edge);
+	auto [left_edge, right_edge] = edges(a, b);
+	return contract(a, b, std::move(left_edge), right_edge);
+}
+
+namespace
+{
+/**
+ * @brief run job(i) for every i in [0,count) on torch's intra-op thread pool.
+ *
+ * The workers inherit the autograd and inference mode of the calling thread. Torch runs the operations of the jobs on a
+ * single thread, nested parallel regions aren't spread further.
+ */
+template <class F>
+void parallel_sites(size_t count, F &&job)
+{
+	const bool grad_mode = torch::GradMode::is_enabled();
+	const bool inference_mode = c10::InferenceMode::is_enabled();
+	at::parallel_for(0, static_cast<int64_t>(count), 1,
+	                 [&](int64_t begin, int64_t end)
+	                 {
+		                 c10::InferenceMode inference_guard(inference_mode);
+		                 torch::AutoGradMode grad_guard(grad_mode);
+		                 for (auto i = begin; i < end; ++i)
+			                 job(static_cast<size_t>(i));
+	                 });
+}
+
+/**
+ * @brief multiply the transfer matrices neighbours by neighbours until one is left, each level of the tree in parallel.
+ */
+template <class Tens, class F>
+Tens tree_reduce(std::vector<Tens> level, const F &product)
+{
+	while (level.size() > 1)
+	{
+		std::vector<Tens> next((level.size() + 1) / 2);
+		parallel_sites(level.size() / 2, [&](size_t k) { next[k] = product(level[2 * k], level[2 * k + 1]); });
+		if (level.size() % 2)
+			next.back() = std::move(level.back());
+		level = std::move(next);
+	}
+	return std::move(level.front());
+}
+
+/**
+ * @brief number of elements above which the transfer matrices of the tree order are deemed too large, about a GiB in
+ * double precision. The sequential order only ever holds one environment.
+ */
+constexpr double tree_max_elements = double(1 << 27);
+/**
+ * @brief whether the tree order is expected to be faster than the sequential order.
+ *
+ * The sequential order does the three tensordots of every site (ket, operator and bra) in turn, on a single thread for
+ * the small bond dimensions where the tree order is worthwhile. The tree order builds every transfer matrix, in
+ * parallel, then multiplies them in the binary tree of tree_reduce: each level is spread on the threads but can't
+ * finish before its largest product. A product of two transfer matrices between the bonds of sizes l, m and r costs
+ * l*m*r, where the size of a bond is the product of the bond dimensions of a, obs and b.
+ *
+ * The transfer matrices take (l*r) elements each, the tree is rejected when two of its levels don't fit in
+ * tree_max_elements.
+ *
+ * @param obs the operator, nullptr for an overlap.
+ */
+template <class MPS_t, class MPO_t>
+bool tree_is_faster(contraction_order order, const MPS_t &a, const MPS_t &b, const MPO_t *obs)
+{
+	if (order != contraction_order::automatic)
+		return order == contraction_order::tree;
+	if (a.size() < 4)
+		return false;
+	const auto N = a.size();
+	std::vector<double> bond(N + 1); // size of the bonds of the transfer matrices.
+	double sequential = 0;
+	double transfer_work = 0;
+	for (size_t i = 0; i < N; ++i)
+	{
+		const double a_l = a[i].sizes()[0];
+		const double d = a[i].sizes()[1];
+		const double a_r = a[i].sizes()[2];
+		const double b_l = b[i].sizes()[0];
+		const double b_r = b[i].sizes()[2];
+		const double w_l = obs ? (*obs)[i].sizes()[0] : 1;
+		const double w_r = obs ? (*obs)[i].sizes()[2] : 1;
+		if (obs)
+		{
+			sequential += a_l * w_l * b_l * d * a_r + b_l * a_r * w_l * d * d * w_r + a_r * w_r * b_l * d * b_r;
+			transfer_work += a_l * a_r * w_l * w_r * d * d + a_l * a_r * w_l * w_r * d * b_l * b_r;
+		}
+		else
+		{
+			sequential += a_l * b_l * d * a_r + a_r * b_l * d * b_r;
+			transfer_work += a_l * a_r * d * b_l * b_r;
+		}
+		bond[i] = a_l * w_l * b_l;
+		bond[i + 1] = a_r * w_r * b_r;
+	}
+	const double threads = std::max(1, at::get_num_threads());
+	auto level_memory = [&bond](const std::vector<size_t> &bounds)
+	{
+		double out = 0;
+		for (size_t k = 0; k + 1 < bounds.size(); ++k)
+			out += bond[bounds[k]] * bond[bounds[k + 1]];
+		return out;
+	};
+	// the transfer matrices of a level go from bounds[k] to bounds[k+1].
+	std::vector<size_t> bounds(N + 1);
+	std::iota(bounds.begin(), bounds.end(), 0);
+	double tree = transfer_work / threads;
+	double memory = level_memory(bounds);
+	while (bounds.size() > 2)
+	{
+		std::vector<size_t> next{bounds.front()};
+		double level_work = 0;
+		double largest_product = 0;
+		for (size_t k = 0; k + 2 < bounds.size(); k += 2)
+		{
+			const double product = bond[bounds[k]] * bond[bounds[k + 1]] * bond[bounds[k + 2]];
+			level_work += product;
+			largest_product = std::max(largest_product, product);
+			next.push_back(bounds[k + 2]);
+		}
+		if (next.back() != bounds.back()) // the last transfer matrix of the level has no partner.
+			next.push_back(bounds.back());
+		tree += std::max(level_work / threads, largest_product);
+		auto next_memory = level_memory(next);
+		if (memory + next_memory > tree_max_elements)
+			return false;
+		memory = next_memory;
+		bounds = std::move(next);
+	}
+	return tree < sequential;
+}
+
+/**
+ * @brief <b|obs|a> with the transfer matrices multiplied in a binary tree.
+ * transfer matrix index ordering: (ket_l, op_l, bra_l, ket_r, op_r, bra_r)
+ */
+template <class MPS_t, class MPO_t, class Tens>
+Tens tree_contract(const MPS_t &a, const MPS_t &b, const MPO_t &obs, const Tens &left_edge, const Tens &right_edge)
+{
+	assert(a.size() == b.size());
+	std::vector<Tens> transfer(a.size());
+	parallel_sites(a.size(),
+	               [&](size_t i)
+	               {
+		               auto out = tensordot(a[i], obs[i], {1}, {3});              // (a, b, wl, s', wr)
+		               out = tensordot(out, b[i].conj(), {3}, {1});               // (a, b, wl, wr, a', b')
+		               transfer[i] = out.permute({0, 2, 4, 1, 3, 5});
+	               });
+	auto chain = tree_reduce(std::move(transfer), [](const Tens &l, const Tens &r)
+	                         { return tensordot(l, r, {3, 4, 5}, {0, 1, 2}); });
+	chain = tensordot(left_edge, chain, {0, 1, 2}, {0, 1, 2});
+	return tensordot(chain, right_edge, {0, 1, 2}, {0, 1, 2});
+}
+/**
+ * @brief <b|a> with the transfer matrices multiplied in a binary tree.
+ * transfer matrix index ordering: (ket_l, bra_l, ket_r, bra_r)
+ */
+template <class MPS_t, class Tens>
+Tens tree_contract(const MPS_t &a, const MPS_t &b, const Tens &left_edge, const Tens &right_edge)
+{
+	assert(a.size() == b.size());
+	std::vector<Tens> transfer(a.size());
+	parallel_sites(a.size(),
+	               [&](size_t i) { transfer[i] = tensordot(a[i], b[i].conj(), {1}, {1}).permute({0, 2, 1, 3}); });
+	auto chain = tree_reduce(std::move(transfer), [](const Tens &l, const Tens &r)
+	                         { return tensordot(l, r, {2, 3}, {0, 1}); });
+	chain = tensordot(left_edge, chain, {0, 1}, {0, 1});
+	return tensordot(chain, right_edge, {0, 1}, {0, 1});
+}
+
+template <class MPS_t, class MPO_t>
+auto contract_impl(const MPS_t &a, const MPS_t &b, const MPO_t &obs, contraction_order order)
+{
+	auto [left_edge, right_edge] = edges(a, b, obs);
+	if (tree_is_faster(order, a, b, &obs))
+		return tree_contract(a, b, obs, left_edge, right_edge);
+	return contract(a, b, obs, std::move(left_edge), right_edge);
+}
+template <class MPS_t>
+auto contract_impl(const MPS_t &a, const MPS_t &b, contraction_order order)
+{
+	auto [left_edge, right_edge] = edges(a, b);
+	using MPO_t = typename dependant_tensor_network<MPS_t>::MPO_type;
+	if (tree_is_faster(order, a, b, static_cast<const MPO_t *>(nullptr)))
+		return tree_contract(a, b, left_edge, right_edge);
+	return contract(a, b, std::move(left_edge), right_edge);
+}
+} // namespace
+
+torch::Tensor contract(const MPS &a, const MPS &b, const MPO &obs, contraction_order order)
+{
+	return contract_impl(a, b, obs, order);
+}
+torch::Tensor contract(const MPS &a, const MPS &b, contraction_order order) { return contract_impl(a, b, order); }
+btensor contract(const bMPS &a, const bMPS &b, const bMPO &obs, contraction_order order)
+{
+	return contract_impl(a, b, obs, order);
 }
+btensor contract(const bMPS &a, const bMPS &b, contraction_order order) { return contract_impl(a, b, order); }
 
 /**
  * @brief generate a string of index O for phys_dim such that Sum_i { phys_dim[i][O][i]] } == constraint.
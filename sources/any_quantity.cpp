@@ -16,6 +16,8 @@
 #include <fmt/core.h>
 #include <fmt/format.h>
 #include <fmt/ranges.h>
+#include <stdexcept>
+#include <unordered_map>
 quantit::any_quantity::any_quantity() : impl(std::make_unique<quantity<conserved::C<1>>>()) {}
 using namespace quantit::conserved;
 template class quantit::quantity<Z>;          // spin or particle
@@ -36,3 +38,36 @@ template class quantit::quantity<C<6>>;       // rotation of the hexagon
 
 std::string to_string(quantit::any_quantity_cref cqtt) { return fmt::format("{}", cqtt); }
 using namespace quantit;
+
+namespace
+{
+struct quantity_type
+{
+	quantity_factory factory;
+	size_t group_count;
+};
+std::unordered_map<std::string, quantity_type> &quantity_registry()
+{
+	// constructed on first use, the quantities register themselves during static initialization.
+	static std::unordered_map<std::string, quantity_type> registry;
+	return registry;
+}
+} // namespace
+
+bool quantit::register_quantity_type(const std::string &tag, quantity_factory factory, size_t group_count)
+{
+	quantity_registry().emplace(tag, quantity_type{factory, group_count});
+	return true;
+}
+
+any_quantity quantit::make_quantity(const std::string &tag, const int64_t *values, size_t group_count)
+{
+	auto &registry = quantity_registry();
+	auto it = registry.find(tag);
+	if (it == registry.end())
+		throw std::invalid_argument(fmt::format("no conserved quantity type with the tag \"{}\"", tag));
+	if (it->second.group_count != group_count)
+		throw std::invalid_argument(fmt::format("the conserved quantity type \"{}\" has {} groups, got {} values", tag,
+		                                        it->second.group_count, group_count));
+	return any_quantity(it->second.factory(values));
+}
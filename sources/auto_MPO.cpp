@@ -0,0 +1,455 @@
+/*
+ * File: auto_MPO.cpp
+ * Project: QuantiT
+ * File Created: Sunday, 18th October 2026 4:05:12 pm
+ * Author: Alexandre Foley (Alexandre.foley@usherbrooke.ca)
+ * Copyright (c) 2026 Alexandre Foley
+ * Licensed under GPL v3
+ */
+
+#include "auto_MPO.h"
+#include <algorithm>
+#include <fmt/core.h>
+#include <functional>
+#include <stdexcept>
+
+namespace quantit
+{
+
+namespace
+{
+using complex = c10::complex<double>;
+
+/**
+ * @brief An entry of a MPO tensor: the operator at index op of the operator table times coefficient, between the
+ * states left and right of the bonds on either side of the site.
+ */
+using entry_map = std::map<std::tuple<int64_t, int64_t, size_t>, complex>;
+
+/**
+ * @brief bond states of the terms crossing a bond, for one conserved quantity sector of the coefficient matrix.
+ *
+ * The coefficient matrix M[l,r] between the operator strings on the left (l) and on the right (r) of the bond is
+ * decomposed as U (U^dagger M), with U the left singular vectors with a non-negligible singular value.
+ */
+struct bond_block
+{
+	int64_t offset;   // index of the first bond state of the block, among the bond states of the terms crossing it.
+	torch::Tensor U;  // (left strings, rank), complex double on the cpu.
+	torch::Tensor SV; // (rank, right strings), U^dagger M.
+};
+struct bond_data
+{
+	int64_t rank = 0;
+	std::vector<bond_block> blocks;
+	std::vector<size_t> sectors;                                               // sector of each bond state.
+	std::map<std::vector<size_t>, std::tuple<size_t, int64_t>> left_strings;  // block, row
+	std::map<std::vector<size_t>, std::tuple<size_t, int64_t>> right_strings; // block, column
+};
+
+struct automaton
+{
+	std::vector<std::vector<size_t>> bond_sectors; // sector of each state of the bond on the left of site i.
+	std::vector<entry_map> sites;
+};
+
+/**
+ * @brief Build the entries of the MPO tensors and the sector of the bond states.
+ *
+ * The bond on the left of site b has the states: done (0) for the terms entirely on its left, the states of the terms
+ * crossing it, and start (last) for the terms entirely on its right. The first bond only has start and the last bond
+ * only has done.
+ *
+ * @param terms terms as a list of operator index for every site, 0 is the identity.
+ * @param sector_of sector of a string of operators, the neutral sector must be 0.
+ */
+automaton build_automaton(const std::map<std::vector<size_t>, complex> &terms, size_t length,
+                          torch::ScalarType work_type, double cutoff,
+                          const std::function<size_t(const std::vector<size_t> &)> &sector_of)
+{
+	std::vector<bond_data> bonds(length + 1);
+	// support of the terms
+	std::vector<std::tuple<size_t, size_t>> support;
+	support.reserve(terms.size());
+	for (const auto &[ids, c] : terms)
+	{
+		auto first = std::find_if(ids.begin(), ids.end(), [](size_t id) { return id != 0; });
+		auto last = std::find_if(ids.rbegin(), ids.rend(), [](size_t id) { return id != 0; });
+		if (first == ids.end()) // constant term, put on the first site.
+			support.emplace_back(0, 0);
+		else
+			support.emplace_back(first - ids.begin(), length - 1 - (last - ids.rbegin()));
+	}
+	for (size_t b = 1; b < length; ++b)
+	{
+		auto &bond = bonds[b];
+		std::map<std::vector<size_t>, size_t> left_index;
+		std::map<std::vector<size_t>, size_t> right_index;
+		std::vector<std::vector<size_t>> left_keys, right_keys;
+		std::vector<std::tuple<size_t, size_t, complex>> coefficients;
+		auto term_it = terms.begin();
+		for (size_t t = 0; t < terms.size(); ++t, ++term_it)
+		{
+			auto [first, last] = support[t];
+			if (first >= b or last < b)
+				continue;
+			const auto &ids = term_it->first;
+			auto insert = [](auto &index, auto &keys, std::vector<size_t> &&key)
+			{
+				auto [it, inserted] = index.emplace(std::move(key), keys.size());
+				if (inserted)
+					keys.push_back(it->first);
+				return it->second;
+			};
+			auto l = insert(left_index, left_keys, std::vector<size_t>(ids.begin(), ids.begin() + b));
+			auto r = insert(right_index, right_keys, std::vector<size_t>(ids.begin() + b, ids.end()));
+			coefficients.emplace_back(l, r, term_it->second);
+		}
+		// the coefficient matrix is block diagonal in the conserved quantities: decompose each sector separatly.
+		std::map<size_t, std::vector<size_t>> sector_rows;
+		for (size_t l = 0; l < left_keys.size(); ++l)
+			sector_rows[sector_of(left_keys[l])].push_back(l);
+		std::vector<std::tuple<size_t, int64_t>> row_pos(left_keys.size());
+		std::vector<std::tuple<size_t, int64_t>> col_pos(right_keys.size(), {0, -1});
+		std::vector<std::vector<size_t>> block_cols;
+		size_t block_index = 0;
+		for (const auto &[sector, rows] : sector_rows)
+		{
+			for (size_t i = 0; i < rows.size(); ++i)
+				row_pos[rows[i]] = {block_index, i};
+			block_cols.emplace_back();
+			++block_index;
+		}
+		for (const auto &[l, r, c] : coefficients)
+		{
+			auto block = std::get<0>(row_pos[l]);
+			if (std::get<1>(col_pos[r]) == -1)
+			{
+				col_pos[r] = {block, block_cols[block].size()};
+				block_cols[block].push_back(r);
+			}
+		}
+		std::vector<torch::Tensor> M;
+		block_index = 0;
+		for (const auto &[sector, rows] : sector_rows)
+			M.push_back(torch::zeros({static_cast<int64_t>(rows.size()),
+			                          static_cast<int64_t>(block_cols[block_index++].size())},
+			                         torch::kComplexDouble));
+		for (const auto &[l, r, c] : coefficients)
+		{
+			auto [block, row] = row_pos[l];
+			M[block].index_put_({row, std::get<1>(col_pos[r])}, c10::Scalar(c));
+		}
+		block_index = 0;
+		for (const auto &[sector, rows] : sector_rows)
+		{
+			auto [u, d, v] = torch::svd(M[block_index].to(work_type));
+			auto rank = (d > cutoff * d.max()).sum().item().toLong();
+			u = u.narrow(1, 0, rank).to(torch::kComplexDouble);
+			auto sv = torch::matmul(u.conj().t(), M[block_index]);
+			bond.blocks.push_back({bond.rank, u, sv});
+			bond.sectors.insert(bond.sectors.end(), rank, sector);
+			bond.rank += rank;
+			++block_index;
+		}
+		for (size_t l = 0; l < left_keys.size(); ++l)
+			bond.left_strings.emplace(left_keys[l], row_pos[l]);
+		for (size_t r = 0; r < right_keys.size(); ++r)
+			bond.right_strings.emplace(right_keys[r], col_pos[r]);
+	}
+	// state index of the bonds
+	auto done = [](size_t b) -> int64_t { return b == 0 ? -1 : 0; };
+	auto start = [length, &bonds](size_t b) -> int64_t
+	{
+		if (b == length)
+			return -1;
+		return b == 0 ? 0 : bonds[b].rank + 1;
+	};
+	auto mid = [](int64_t j) -> int64_t { return j + 1; };
+
+	automaton out;
+	out.bond_sectors.resize(length + 1);
+	out.bond_sectors[0] = {0};
+	out.bond_sectors[length] = {0};
+	for (size_t b = 1; b < length; ++b)
+	{
+		out.bond_sectors[b].push_back(0);
+		out.bond_sectors[b].insert(out.bond_sectors[b].end(), bonds[b].sectors.begin(), bonds[b].sectors.end());
+		out.bond_sectors[b].push_back(0);
+	}
+	out.sites.resize(length);
+	for (size_t n = 0; n < length; ++n)
+	{
+		auto &entries = out.sites[n];
+		auto add = [&entries](int64_t wl, int64_t wr, size_t op, complex c) { entries[{wl, wr, op}] += c; };
+		if (start(n + 1) != -1)
+			add(start(n), start(n + 1), 0, 1);
+		if (done(n) != -1)
+			add(done(n), done(n + 1), 0, 1);
+		auto term_it = terms.begin();
+		for (size_t t = 0; t < terms.size(); ++t, ++term_it)
+		{
+			auto [first, last] = support[t];
+			if (first == n and last == n)
+				add(start(n), done(n + 1), term_it->first[n], term_it->second);
+		}
+		// strings continued or started on this site.
+		if (n + 1 < length)
+		{
+			const auto &bond = bonds[n + 1];
+			for (const auto &[key, pos] : bond.left_strings)
+			{
+				auto [block, row] = pos;
+				const auto &U = bond.blocks[block].U;
+				auto offset = bond.blocks[block].offset;
+				auto op = key[n];
+				auto prefix = std::vector<size_t>(key.begin(), key.begin() + n);
+				auto prev = n > 0 ? bonds[n].left_strings.find(prefix) : bonds[n].left_strings.end();
+				if (prev == bonds[n].left_strings.end())
+				{
+					// started on this site.
+					auto acc = U.accessor<complex, 2>();
+					for (int64_t j = 0; j < U.sizes()[1]; ++j)
+						add(start(n), mid(offset + j), op, acc[row][j]);
+				}
+				else
+				{
+					auto [prev_block, prev_row] = prev->second;
+					const auto &prev_U = bonds[n].blocks[prev_block].U;
+					auto prev_offset = bonds[n].blocks[prev_block].offset;
+					auto acc = U.accessor<complex, 2>();
+					auto prev_acc = prev_U.accessor<complex, 2>();
+					for (int64_t i = 0; i < prev_U.sizes()[1]; ++i)
+						for (int64_t j = 0; j < U.sizes()[1]; ++j)
+							add(mid(prev_offset + i), mid(offset + j), op,
+							    std::conj(prev_acc[prev_row][i]) * acc[row][j]);
+				}
+			}
+		}
+		// strings finished on this site.
+		if (n > 0)
+		{
+			const auto &bond = bonds[n];
+			for (const auto &[key, pos] : bond.right_strings)
+			{
+				if (std::any_of(key.begin() + 1, key.end(), [](size_t id) { return id != 0; }))
+					continue;
+				auto [block, col] = pos;
+				const auto &SV = bond.blocks[block].SV;
+				auto offset = bond.blocks[block].offset;
+				auto acc = SV.accessor<complex, 2>();
+				for (int64_t i = 0; i < SV.sizes()[0]; ++i)
+					add(mid(offset + i), done(n + 1), key[0], acc[i][col]);
+			}
+		}
+		for (auto it = entries.begin(); it != entries.end();)
+		{
+			if (std::abs(it->second) <= cutoff)
+				it = entries.erase(it);
+			else
+				++it;
+		}
+	}
+	return out;
+}
+
+torch::Scalar to_scalar(complex c, torch::ScalarType type)
+{
+	if (c10::isComplexType(type))
+		return c10::Scalar(c);
+	return c.real();
+}
+
+/**
+ * @brief sum of the operators of each (left,right) pair of bond states of a site.
+ */
+std::map<std::tuple<int64_t, int64_t>, torch::Tensor> site_blocks(const entry_map &entries,
+                                                                   const std::vector<torch::Tensor> &operators,
+                                                                   torch::ScalarType work_type)
+{
+	std::map<std::tuple<int64_t, int64_t>, torch::Tensor> out;
+	for (const auto &[key, c] : entries)
+	{
+		auto [wl, wr, op] = key;
+		auto value = operators[op] * to_scalar(c, work_type);
+		auto [it, inserted] = out.emplace(std::make_tuple(wl, wr), value);
+		if (!inserted)
+			it->second += value;
+	}
+	return out;
+}
+} // namespace
+
+auto_MPO::auto_MPO(size_t _length, int64_t _local_dim, torch::Tensor _fermion_string)
+    : length(_length), local_dim(_local_dim), fermion_string(std::move(_fermion_string)), terms()
+{
+	if (length == 0)
+		throw std::invalid_argument("auto_MPO needs at least one site");
+	if (fermion_string.defined() and fermion_string.sizes() != torch::IntArrayRef({local_dim, local_dim}))
+		throw std::invalid_argument(fmt::format("the fermion string must be a {0}x{0} matrix", local_dim));
+}
+
+auto_MPO &auto_MPO::add(torch::Scalar coefficient, std::vector<site_operator> ops)
+{
+	for (const auto &op : ops)
+	{
+		if (op.site >= length)
+			throw std::invalid_argument(fmt::format("site {} is out of the chain of length {}", op.site, length));
+		if (op.op.sizes() != torch::IntArrayRef({local_dim, local_dim}))
+			throw std::invalid_argument(fmt::format("local operators must be {0}x{0} matrices", local_dim));
+		if (op.fermionic and !fermion_string.defined())
+			throw std::invalid_argument("a fermion string is required for terms with fermionic operators");
+	}
+	terms.emplace_back(coefficient.toComplexDouble(), std::move(ops));
+	return *this;
+}
+
+torch::ScalarType auto_MPO::work_type() const
+{
+	bool is_complex = fermion_string.defined() and fermion_string.is_complex();
+	for (const auto &[c, ops] : terms)
+	{
+		is_complex |= c.imag() != 0;
+		for (const auto &op : ops)
+			is_complex |= op.op.is_complex();
+	}
+	return is_complex ? torch::kComplexDouble : torch::kFloat64;
+}
+
+std::tuple<std::vector<torch::Tensor>, std::map<std::vector<size_t>, c10::complex<double>>> auto_MPO::canonical_terms(
+    torch::ScalarType type, double cutoff) const
+{
+	std::vector<torch::Tensor> operators{torch::eye(local_dim, type)};
+	// absolute tolerance only: a relative one would merge distinct operators with small elements.
+	auto intern = [&operators, cutoff](const torch::Tensor &op)
+	{
+		auto it = std::find_if(operators.begin(), operators.end(), [&op, cutoff](const torch::Tensor &other)
+		                       { return torch::allclose(op, other, 0, cutoff); });
+		if (it == operators.end())
+			it = operators.insert(it, op);
+		return static_cast<size_t>(it - operators.begin());
+	};
+	auto F = fermion_string.defined() ? fermion_string.to(type) : torch::Tensor();
+	std::map<std::vector<size_t>, complex> out;
+	for (const auto &[coefficient, ops] : terms)
+	{
+		auto sorted = ops;
+		double sign = 1;
+		// stable insertion sort by site, every exchange of two fermionic operators flips the sign.
+		for (size_t i = 1; i < sorted.size(); ++i)
+			for (size_t j = i; j > 0 and sorted[j - 1].site > sorted[j].site; --j)
+			{
+				if (sorted[j - 1].fermionic and sorted[j].fermionic)
+					sign = -sign;
+				std::swap(sorted[j - 1], sorted[j]);
+			}
+		auto fermion_count =
+		    std::count_if(sorted.begin(), sorted.end(), [](const site_operator &op) { return op.fermionic; });
+		if (fermion_count % 2)
+			throw std::invalid_argument("terms must have an even number of fermionic operators");
+		std::vector<torch::Tensor> local(length);
+		for (const auto &op : sorted)
+		{
+			auto tens = op.op.to(type);
+			local[op.site] = local[op.site].defined() ? torch::matmul(local[op.site], tens) : tens;
+		}
+		// the fermionic operators on the right of a site put a fermion string on it.
+		std::vector<size_t> ids(length, 0);
+		auto right_fermions = fermion_count;
+		auto op_it = sorted.begin();
+		for (size_t m = 0; m < length; ++m)
+		{
+			for (; op_it != sorted.end() and op_it->site == m; ++op_it)
+				right_fermions -= op_it->fermionic;
+			if (right_fermions % 2)
+				local[m] = local[m].defined() ? torch::matmul(local[m], F) : F;
+			if (local[m].defined())
+				ids[m] = intern(local[m]);
+		}
+		out[ids] += coefficient * sign;
+	}
+	for (auto it = out.begin(); it != out.end();) // terms that cancelled out.
+	{
+		if (it->second == complex(0))
+			it = out.erase(it);
+		else
+			++it;
+	}
+	return std::make_tuple(std::move(operators), std::move(out));
+}
+
+MPO auto_MPO::to_MPO(torch::TensorOptions opt, double cutoff) const
+{
+	auto type = work_type();
+	auto [operators, canon] = canonical_terms(type, cutoff);
+	auto graph = build_automaton(canon, length, type, cutoff, [](const std::vector<size_t> &) -> size_t { return 0; });
+	auto out_type = c10::isComplexType(type) ? c10::toComplexType(c10::typeMetaToScalarType(opt.dtype()))
+	                                         : c10::typeMetaToScalarType(opt.dtype());
+	MPO out(length);
+	for (size_t n = 0; n < length; ++n)
+	{
+		auto tens = torch::zeros({static_cast<int64_t>(graph.bond_sectors[n].size()), local_dim,
+		                          static_cast<int64_t>(graph.bond_sectors[n + 1].size()), local_dim},
+		                         type);
+		for (const auto &[key, block] : site_blocks(graph.sites[n], operators, type))
+			tens.select(0, std::get<0>(key)).select(1, std::get<1>(key)).copy_(block);
+		out[n] = tens.to(opt.dtype(out_type));
+	}
+	return out;
+}
+
+bMPO auto_MPO::to_bMPO(const btensor &phys_shape, torch::TensorOptions opt, double cutoff) const
+{
+	if (phys_shape.dim() != 1 or phys_shape.sizes()[0] != local_dim)
+		throw std::invalid_argument(
+		    fmt::format("the physical shape must be a rank 1 block tensor of size {}", local_dim));
+	auto type = work_type();
+	auto [operators, canon] = canonical_terms(type, cutoff);
+	auto op_shape = shape_from(phys_shape, phys_shape.conj());
+	std::vector<any_quantity> op_charges;
+	op_charges.reserve(operators.size());
+	for (const auto &op : operators)
+		op_charges.push_back(find_selection_rule(op, op_shape, cutoff));
+	auto neutral = phys_shape.selection_rule->neutral();
+	std::vector<any_quantity> sector_charges{neutral};
+	auto sector_of = [&](const std::vector<size_t> &ids) -> size_t
+	{
+		any_quantity charge = neutral;
+		for (auto id : ids)
+			charge = charge * op_charges[id];
+		auto it = std::find(sector_charges.begin(), sector_charges.end(), charge);
+		if (it == sector_charges.end())
+			it = sector_charges.insert(it, charge);
+		return it - sector_charges.begin();
+	};
+	auto graph = build_automaton(canon, length, type, cutoff, sector_of);
+	auto out_type = c10::isComplexType(type) ? c10::toComplexType(c10::typeMetaToScalarType(opt.dtype()))
+	                                         : c10::typeMetaToScalarType(opt.dtype());
+	opt = opt.dtype(out_type);
+	// one section per run of bond states with the same conserved quantities, coalesce merges them afterward.
+	std::vector<btensor> bond_shapes;
+	bond_shapes.reserve(length + 1);
+	for (const auto &sectors : graph.bond_sectors)
+	{
+		std::vector<std::tuple<size_t, any_quantity>> sections;
+		for (auto sector : sectors)
+		{
+			if (!sections.empty() and std::get<1>(sections.back()) == sector_charges[sector])
+				++std::get<0>(sections.back());
+			else
+				sections.emplace_back(1, sector_charges[sector]);
+		}
+		bond_shapes.emplace_back(btensor::vec_list_t{sections}, neutral, opt);
+	}
+	bMPO out(length);
+	for (size_t n = 0; n < length; ++n)
+	{
+		auto tens = shape_from(bond_shapes[n], phys_shape, bond_shapes[n + 1].conj(), phys_shape.conj());
+		for (const auto &[key, block] : site_blocks(graph.sites[n], operators, type))
+			tens.basic_index_put_({std::get<0>(key), -1, std::get<1>(key), -1}, block.to(opt));
+		out[n] = std::move(tens);
+	}
+	return out.coalesce();
+}
+
+} // namespace quantit
@@ -2502,30 +2502,56 @@ torch::Tensor btensor::to_dense() const
 	return out;
 }
 
+/**
+ * @brief build the blocks make_block(i) of out for every index in block_indices, concurrently on torch's intra-op
+ * thread pool, and insert those whose norm exceed cutoff.
+ *
+ * The workers inherit the autograd and inference mode of the calling thread. The blocks are inserted by the calling
+ * thread once they are all built.
+ */
+template <class F>
+void insert_blocks(btensor &out, const std::vector<btensor::index_list> &block_indices, const torch::Scalar cutoff,
+                   F &&make_block)
+{
+	const bool grad_mode = torch::GradMode::is_enabled();
+	const bool inference_mode = c10::InferenceMode::is_enabled();
+	std::vector<torch::Tensor> blocks(block_indices.size());
+	at::parallel_for(0, static_cast<int64_t>(block_indices.size()), 1,
+	                 [&](int64_t begin, int64_t end)
+	                 {
+		                 c10::InferenceMode inference_guard(inference_mode);
+		                 torch::AutoGradMode grad_guard(grad_mode);
+		                 for (auto i = begin; i < end; ++i)
+		                 {
+			                 auto block = make_block(static_cast<size_t>(i));
+			                 auto norm = torch::linalg::vector_norm(
+			                     block.flatten().to(torch::promote_types(
+			                         torch::kFloat, torch::typeMetaToScalarType(block.options().dtype()))),
+			                     2, {}, false, {});
+			                 if ((norm > cutoff).item().toBool()) // only insert the significative blocks.
+				                 blocks[i] = std::move(block);
+		                 }
+	                 });
+	out.reserve_space_(block_indices.size());
+	for (size_t i = 0; i < blocks.size(); ++i)
+		if (blocks[i].defined())
+			out.block(block_indices[i]) = std::move(blocks[i]);
+}
+
 void from_basic_impl(btensor &out, const torch::Tensor &values, const torch::Scalar cutoff)
 {
 	if (out.dim() != values.dim())
 		throw std::invalid_argument("input arguments have incompatible rank!");
-	out.reserve_space_(btensor_size::max);
+	std::vector<btensor::index_list> allowed;
 	auto index = btensor::index_list(out.dim());
-	// fmt::print("construction of btensor from full basic tensor\n==============\n");
 	do
 	{
 		if (out.block_conservation_rule_test(index))
-		{
-			auto shape_view = out.block_sizes(index);
-			auto S = btensor::full_slice(out, index);
-			auto block = values.index(torch::ArrayRef(S));
-			if ((torch::linalg::vector_norm(block.flatten().to(torch::promote_types(
-			                                    torch::kFloat, torch::typeMetaToScalarType(block.options().dtype()))),
-			                                2, {}, false, {}) > cutoff)
-			        .item()
-			        .toBool()) // only insert the block if it's a significative quantity.
-				out.block(index) = block;
-			// fmt::print("\tindex {}\n\tSlice {}\n\t block {}\n================\n",index,S,out.block(index));
-		}
+			allowed.push_back(index);
 		out.block_increment(index);
 	} while (any_truth(index));
+	insert_blocks(out, allowed, cutoff,
+	              [&](size_t i) { return values.index(torch::ArrayRef(btensor::full_slice(out, allowed[i]))); });
 }
 btensor from_basic_tensor(const btensor::vec_list_t &shape_spec, any_quantity selection_rul,
                           const torch::Tensor &values, const torch::Scalar cutoff, c10::TensorOptions opt)
@@ -2541,6 +2567,150 @@ btensor from_basic_tensor_like(const btensor &shape, const torch::Tensor &values
 	from_basic_impl(out, values, cutoff);
 	return out;
 }
+btensor from_coo(const torch::Tensor &indices, const torch::Tensor &values, const btensor &partial_shape,
+                 int64_t missing_dim, int64_t missing_size, const torch::Scalar cutoff, c10::TensorOptions opt)
+{
+	using torch::indexing::Slice;
+	const int64_t rank = partial_shape.dim() + 1;
+	if (rank < 2)
+		throw std::invalid_argument("from_coo needs at least one known dimension");
+	if (indices.dim() != 2 or indices.size(0) != rank or values.dim() != 1 or values.size(0) != indices.size(1))
+		throw std::invalid_argument(
+		    fmt::format("the indices must be of shape ({}, N) and the values of shape (N)", rank));
+	if (missing_dim < -rank or missing_dim >= rank)
+		throw std::invalid_argument(fmt::format("missing dimension {} out of range for rank {}", missing_dim, rank));
+	missing_dim = (missing_dim + rank) % rank;
+	auto out_opt = values.options().merge_in(opt);
+	auto vals = values.to(out_opt);
+	auto keep = (vals.abs() > cutoff).to(torch::kCPU);
+	auto idx = indices.to(torch::TensorOptions(torch::kCPU).dtype(torch::kInt64)).index({Slice(), keep});
+	vals = vals.index({keep.to(vals.device())});
+	const auto count = idx.size(1);
+	auto missing = idx[missing_dim];
+	if (missing_size < 0)
+		missing_size = count ? missing.max().item().toLong() + 1 : 0;
+	if (count and (missing.min().item().toLong() < 0 or missing.max().item().toLong() >= missing_size))
+		throw std::out_of_range("index of the missing dimension out of range");
+
+	// section of each element, and its index within the section, along the known dimensions.
+	std::vector<torch::Tensor> section(rank), offset(rank);
+	for (int64_t d = 0; d < rank; ++d)
+	{
+		if (d == missing_dim)
+			continue;
+		auto [sizes_begin, sizes_end] = partial_shape.section_sizes(d - (d > missing_dim));
+		auto sizes = torch::tensor(btensor::index_list(sizes_begin, sizes_end), torch::kInt64);
+		auto ends = sizes.cumsum(0);
+		if (count and (idx[d].min().item().toLong() < 0 or idx[d].max().item().toLong() >= ends[-1].item().toLong()))
+			throw std::out_of_range(fmt::format("index of dimension {} out of range", d));
+		section[d] = torch::bucketize(idx[d], ends, false, true);
+		offset[d] = idx[d] - (ends - sizes).index({section[d]});
+	}
+	// conserved quantity of the missing dimension for each distinct combination of known sections.
+	std::vector<torch::Tensor> known;
+	for (int64_t d = 0; d < rank; ++d)
+		if (d != missing_dim)
+			known.push_back(section[d]);
+	auto unique_known = torch::unique_dim(torch::stack(known, 1), 0, true, true);
+	const auto &combinations = std::get<0>(unique_known);
+	const auto &combination_of = std::get<1>(unique_known);
+	any_quantity_cref selection_rule = partial_shape.selection_rule->get();
+	std::vector<any_quantity> distinct{selection_rule.neutral()};
+	auto find_id = [&distinct](const any_quantity &qt)
+	{
+		auto it = std::find_if(distinct.begin(), distinct.end(),
+		                       [&qt](const any_quantity &x) { return x.get() == qt.get(); });
+		if (it == distinct.end())
+			it = distinct.insert(it, qt);
+		return static_cast<int64_t>(std::distance(distinct.begin(), it));
+	};
+	std::vector<int64_t> combination_id(combinations.size(0));
+	auto comb = combinations.accessor<int64_t, 2>();
+	for (int64_t c = 0; c < combinations.size(0); ++c)
+	{
+		any_quantity product = selection_rule.neutral();
+		for (int64_t j = 0; j < rank - 1; ++j)
+			product *= partial_shape.section_conserved_qtt(j, comb[c][j]);
+		combination_id[c] = find_id(selection_rule * product.inverse());
+	}
+	auto element_id = torch::tensor(combination_id, torch::kInt64).index({combination_of});
+	// every element with the same index along the missing dimension must imply the same conserved quantity. The
+	// indices without any element get the neutral quantity.
+	auto id_of_index = torch::zeros({missing_size}, torch::kInt64);
+	id_of_index.index_put_({missing}, element_id);
+	if ((id_of_index.index({missing}) != element_id).any().item().toBool())
+		throw std::logic_error("the elements cannot be conserving with the partial shape");
+	// consecutive indices with the same conserved quantity form a section.
+	btensor::index_list missing_sizes;
+	std::vector<int64_t> missing_ids;
+	std::vector<int64_t> section_of_index(missing_size);
+	std::vector<int64_t> section_start;
+	auto ids = id_of_index.accessor<int64_t, 1>();
+	for (int64_t m = 0; m < missing_size; ++m)
+	{
+		if (m == 0 or ids[m] != ids[m - 1])
+		{
+			missing_sizes.push_back(0);
+			missing_ids.push_back(ids[m]);
+			section_start.push_back(m);
+		}
+		++missing_sizes.back();
+		section_of_index[m] = missing_sizes.size() - 1;
+	}
+	section[missing_dim] = torch::tensor(section_of_index, torch::kInt64).index({missing});
+	offset[missing_dim] = missing - torch::tensor(section_start, torch::kInt64).index({section[missing_dim]});
+
+	btensor::index_list sections_by_dim(rank);
+	btensor::index_list sections_sizes;
+	any_quantity_vector c_vals(0, selection_rule);
+	for (int64_t d = 0; d < rank; ++d)
+	{
+		if (d == missing_dim)
+		{
+			sections_by_dim[d] = missing_sizes.size();
+			sections_sizes.insert(sections_sizes.end(), missing_sizes.begin(), missing_sizes.end());
+			for (auto id : missing_ids)
+				c_vals.push_back(distinct[id]);
+			continue;
+		}
+		const auto j = d - (d > missing_dim);
+		auto [sizes_begin, sizes_end] = partial_shape.section_sizes(j);
+		sections_by_dim[d] = partial_shape.section_number(j);
+		sections_sizes.insert(sections_sizes.end(), sizes_begin, sizes_end);
+		for (size_t s = 0; s < partial_shape.section_number(j); ++s)
+			c_vals.push_back(partial_shape.section_conserved_qtt(j, s));
+	}
+	btensor out(rank, {}, std::move(sections_by_dim), std::move(sections_sizes), std::move(c_vals), selection_rule,
+	            out_opt);
+
+	// group the elements by block, each block is then filled by a single scatter.
+	auto [blocks, block_of, block_count] = torch::unique_dim(torch::stack(section, 1), 0, true, true, true);
+	auto order = block_of.argsort();
+	auto starts = block_count.cumsum(0) - block_count;
+	auto positions = torch::stack(offset, 0).index({Slice(), order}).to(vals.device());
+	auto ordered_vals = vals.index({order.to(vals.device())});
+	std::vector<btensor::index_list> block_indices(blocks.size(0));
+	auto blocks_acc = blocks.accessor<int64_t, 2>();
+	for (int64_t b = 0; b < blocks.size(0); ++b)
+		block_indices[b] = btensor::index_list(blocks_acc[b].data(), blocks_acc[b].data() + rank);
+	auto starts_acc = starts.accessor<int64_t, 1>();
+	auto count_acc = block_count.accessor<int64_t, 1>();
+	insert_blocks(out, block_indices, cutoff,
+	              [&](size_t b)
+	              {
+		              auto sizes = out.block_sizes(block_indices[b]);
+		              auto block = torch::zeros(std::vector<int64_t>(sizes.begin(), sizes.end()), out_opt);
+		              auto elements = Slice(starts_acc[b], starts_acc[b] + count_acc[b]);
+		              auto pos = positions.index({Slice(), elements});
+		              auto flat = pos[0];
+		              for (int64_t d = 1; d < rank; ++d)
+			              flat = flat * block.size(d) + pos[d];
+		              // repeated coordinates are summed.
+		              block.view({-1}).index_add_(0, flat, ordered_vals.index({elements}));
+		              return block;
+	              });
+	return out;
+}
 bool allclose(const btensor &a, const btensor &b, double rtol, double atol, bool equal_nan)
 {
 	if (!btensor::test_same_shape(a, b))
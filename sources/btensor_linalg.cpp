@@ -5,9 +5,12 @@
 #include <ATen/TensorIndexing.h>
 #include <c10/core/ScalarType.h>
 #include <c10/util/ArrayRef.h>
+#include <algorithm>
+#include <cmath>
 #include <cstdint>
 #include <iterator>
 #include <numeric>
+#include <optional>
 #include <stdexcept>
 #include <tuple>
 namespace quantit
@@ -70,7 +73,8 @@ btensor::block_list_t::content_t reorder_by_cvals(const btensor &tensor)
  * @brief compactify a range of blocks into a single dense torch::tensor
  *
  * Create the minimal size necessary for the resulting tensor, assumes all blocks are in the same sector for all but the
- * last 2 dimensions. return the compactified
+ * last 2 dimensions. A single block is returned as is, a sector without missing blocks is concatenated and the others
+ * are copied into a tensor of zeros with the options of the blocks. return the compactified
  * @param start
  * @param end
  * @return
@@ -86,61 +90,86 @@ compact_dense_single(btensor::block_list_t::content_t::const_iterator start,
 	// One sort of optimisation that we might have missed is if something like [0 A;B 0] or [A 0; 0 B] happens. A priori
 	// that would be the consequence of an accidental or unenforced (Abelian) symmetry.
 	const auto rank = start->first.size();
-	std::vector<int64_t> tensor_size(rank);
-	auto &row_size = tensor_size[rank - 2];
-	row_size = start->second.sizes()[rank - 2];
-	auto &col_size = tensor_size[rank - 1];
 	btensor::index_list other_indices((rank > 2) * (rank - 2));
 	if (other_indices.size())
 		std::copy(start->first.begin(), start->first.end() - 2, other_indices.begin());
 	std::vector<std::tuple<int, torch::indexing::Slice>> encountered_block_col;
 	std::vector<std::tuple<int, torch::indexing::Slice>> encountered_block_row;
-	int64_t row_acc = 0;
-	int64_t col_acc = 0;
-	for (int i = 0; i < rank - 2; ++i)
-	{
-		tensor_size[i] = start->second.sizes()[i];
+	if (std::next(start) == end)
+	{ // single block sector, the block is the dense tensor.
+		const auto &block = start->second;
+		encountered_block_row.emplace_back(start->first[rank - 2], torch::indexing::Slice(0, block.sizes()[rank - 2]));
+		encountered_block_col.emplace_back(start->first[rank - 1], torch::indexing::Slice(0, block.sizes()[rank - 1]));
+		return std::make_tuple(block, other_indices, encountered_block_row, encountered_block_col);
 	}
-	encountered_block_col.reserve(std::distance(start, end));
-	encountered_block_row.reserve(std::distance(start, end));
-	// Look at all the sector present, from it determine the size of the dense tensor. Could this be done for all the
-	// tensors at once while counting the number of tensors?
+	// The blocks are ordered by their index, so the rows come in increasing order. The columns are gathered and sorted
+	// to compute their offsets.
+	std::vector<int64_t> block_row_offsets;
+	std::vector<std::tuple<int, int64_t>> cols; // column index and width
+	block_row_offsets.reserve(std::distance(start, end));
+	cols.reserve(std::distance(start, end));
+	int64_t row_acc = 0;
 	int cur_row = start->first[rank - 2];
-	auto slice_end = row_acc + start->second.sizes()[rank - 2];
-	encountered_block_row.emplace_back(cur_row, torch::indexing::Slice(row_acc, slice_end));
-	row_acc = slice_end;
-	for (auto it = start; it != end;
-	     ++it) // nlogn loop, the n^2 loop might be faster because of easier to predict branches.
+	encountered_block_row.emplace_back(cur_row, torch::indexing::Slice(0, start->second.sizes()[rank - 2]));
+	for (auto it = start; it != end; ++it)
 	{
-		const auto col = it->first[rank - 1];
-		auto pos = std::lower_bound(encountered_block_col.begin(), encountered_block_col.end(), col,
-		                            [](const auto &a, const auto &b) { return std::get<0>(a) < b; });
-		if (pos == encountered_block_col.end() or std::get<0>(*pos) != col)
-		{
-			auto slice_end = col_acc + it->second.sizes()[rank - 1];
-			encountered_block_col.emplace(pos, col, torch::indexing::Slice(col_acc, slice_end));
-			col_size += it->second.sizes()[rank - 1];
-			col_acc = slice_end;
-		}
 		if (cur_row != it->first[rank - 2])
 		{
-			auto slice_end = row_acc + it->second.sizes()[rank - 2];
+			row_acc += std::prev(it)->second.sizes()[rank - 2];
 			cur_row = it->first[rank - 2];
-			encountered_block_row.emplace_back(cur_row, torch::indexing::Slice(row_acc, slice_end));
-			row_size += it->second.sizes()[rank - 2];
-			row_acc = slice_end;
+			encountered_block_row.emplace_back(
+			    cur_row, torch::indexing::Slice(row_acc, row_acc + it->second.sizes()[rank - 2]));
+		}
+		block_row_offsets.push_back(row_acc);
+		cols.emplace_back(it->first[rank - 1], it->second.sizes()[rank - 1]);
+	}
+	const auto row_size = row_acc + std::prev(end)->second.sizes()[rank - 2];
+	std::sort(cols.begin(), cols.end());
+	cols.erase(std::unique(cols.begin(), cols.end()), cols.end());
+	std::vector<int64_t> col_offsets(cols.size());
+	encountered_block_col.reserve(cols.size());
+	int64_t col_size = 0;
+	for (size_t c = 0; c < cols.size(); ++c)
+	{
+		col_offsets[c] = col_size;
+		encountered_block_col.emplace_back(std::get<0>(cols[c]),
+		                                   torch::indexing::Slice(col_size, col_size + std::get<1>(cols[c])));
+		col_size += std::get<1>(cols[c]);
+	}
+	torch::Tensor out_tensor;
+	if (static_cast<size_t>(std::distance(start, end)) == encountered_block_row.size() * cols.size())
+	{ // every block of the sector is present: concatenate the rows of blocks, then the rows.
+		std::vector<torch::Tensor> row_blocks;
+		std::vector<torch::Tensor> rows;
+		row_blocks.reserve(cols.size());
+		rows.reserve(encountered_block_row.size());
+		for (auto it = start; it != end; ++it)
+		{
+			row_blocks.push_back(it->second);
+			if (row_blocks.size() == cols.size())
+			{
+				rows.push_back(torch::cat(row_blocks, rank - 1));
+				row_blocks.clear();
+			}
 		}
+		out_tensor = torch::cat(rows, rank - 2);
 	}
-	auto out_tensor = torch::zeros(tensor_size);
-	for (auto it = start; it != end;
-	     ++it) // stuff the blocks in the dense tensor. can be parallelized, but false sharing can occur.
+	else
 	{
-		auto col_slice_it = std::find_if(encountered_block_col.begin(), encountered_block_col.end(),
-		                                 [b = it->first[rank - 1]](auto &a) { return std::get<0>(a) == b; });
-		auto row_slice_it = std::find_if(encountered_block_row.begin(), encountered_block_row.end(),
-		                                 [b = it->first[rank - 2]](auto &a) { return std::get<0>(a) == b; });
-		out_tensor.index_put_({torch::indexing::Ellipsis, std::get<1>(*row_slice_it), std::get<1>(*col_slice_it)},
-		                      it->second);
+		std::vector<int64_t> tensor_size(start->second.sizes().begin(), start->second.sizes().end());
+		tensor_size[rank - 2] = row_size;
+		tensor_size[rank - 1] = col_size;
+		out_tensor = torch::zeros(tensor_size, start->second.options());
+		auto row_offset = block_row_offsets.begin();
+		for (auto it = start; it != end; ++it, ++row_offset)
+		{
+			const auto &block = it->second;
+			auto c = std::distance(cols.begin(), std::lower_bound(cols.begin(), cols.end(),
+			                                                      std::make_tuple(it->first[rank - 1], int64_t(0))));
+			out_tensor.narrow(rank - 2, *row_offset, block.sizes()[rank - 2])
+			    .narrow(rank - 1, col_offsets[c], block.sizes()[rank - 1])
+			    .copy_(block);
+		}
 	}
 	// if there are blocks of zeros, we must assign them slice index anyway for the undoing. The linear algebra could
 	// create values there.
@@ -276,12 +305,13 @@ void reverse_compact_dense(torch::Tensor &tensor, btensor &out, btensor::index_l
 	            the V blocs have to column of their blocs and to row corresponding to the ordering relative to the other
 	 blocs.
 	 */
+	const bool single_block = rows.size() == 1 and cols.size() == 1;
 	for (auto &row : rows)
 	{
 		for (auto &col : cols)
 		{
 			auto [block_index, slices] = build_index_slice(other_indices, row, col);
-			out.block(block_index) = tensor.index(slices);
+			out.block(block_index) = single_block ? tensor : tensor.index(slices);
 		}
 	}
 }
@@ -356,7 +386,7 @@ std::tuple<btensor, btensor> eigh(const btensor &tensor, BOOL upper)
 		for (auto &row : rows)
 		{
 			auto [block_ind, slice] = LA_helpers::build_index_slice(other_indices, row, extra_block_slice);
-			U.block(block_ind) = bU.index(slice);
+			U.block(block_ind) = rows.size() == 1 ? bU : bU.index(slice);
 		}
 		auto [block_ind, slice] = LA_helpers::build_index_slice(other_indices, extra_block_slice, extra_block_slice);
 		d.block(btensor::index_list(block_ind.begin(), block_ind.end() - 1)) = bD;
@@ -387,7 +417,100 @@ std::tuple<btensor, btensor> eigh(const btensor &tensor, size_t split)
 	// return tuple
 	return std::make_tuple(d, U);
 }
-std::tuple<btensor, btensor, btensor> svd(const btensor &tensor, const BOOL some, const BOOL compute_uv)
+/**
+ * @brief randomized singular value decomposition of a (batch of) matrix, keeping only the rank largest values.
+ *
+ * Sample the range of the matrix with a gaussian random matrix, refine the sample with power iterations and decompose
+ * the projection of the matrix on the sampled range.
+ *
+ * @param A matrix to decompose
+ * @param rank number of singular values and vectors to return
+ * @param options sampling parameters
+ * @return std::tuple<torch::Tensor, torch::Tensor, torch::Tensor> U,d,V, same convention as torch::svd
+ */
+std::tuple<torch::Tensor, torch::Tensor, torch::Tensor> randomized_svd(const torch::Tensor &A, int64_t rank,
+                                                                       const randomized_svd_options &options)
+{
+	auto m = A.sizes()[A.dim() - 2];
+	auto n = A.sizes()[A.dim() - 1];
+	auto sample_size = std::min<int64_t>(rank + options.oversampling, std::min(m, n));
+	auto sample_shape = A.sizes().vec();
+	*(sample_shape.end() - 2) = n;
+	sample_shape.back() = sample_size;
+	auto A_dag = A.transpose(-2, -1).conj();
+	auto Q = std::get<0>(torch::linalg::qr(torch::matmul(A, torch::randn(sample_shape, A.options()))));
+	for (size_t i = 0; i < options.power_iterations; ++i)
+	{
+		// orthonormalize at each step, otherwise the smaller singular values are lost to round-off errors.
+		Q = std::get<0>(torch::linalg::qr(torch::matmul(A_dag, Q)));
+		Q = std::get<0>(torch::linalg::qr(torch::matmul(A, Q)));
+	}
+	auto [bU, d, V] = torch::svd(torch::matmul(Q.transpose(-2, -1).conj(), A));
+	using namespace torch::indexing;
+	auto kept = Slice(0, rank);
+	return std::make_tuple(torch::matmul(Q, bU.index({Ellipsis, kept})), d.index({Ellipsis, kept}),
+	                       V.index({Ellipsis, kept}));
+}
+// sectors at least that rectangular, with a large side at least that long, are decomposed through their gram matrix.
+constexpr int64_t gram_svd_aspect_ratio = 4;
+constexpr int64_t gram_svd_min_size = 64;
+/**
+ * @brief singular value decomposition of a (batch of) matrix from the eigenvalue decomposition of the smallest of
+ * \f$ A A^\dagger \f$ and \f$ A^\dagger A \f$, the other unitary is recovered by multiplication.
+ *
+ * Squaring the matrix squares its condition number: the decomposition is refused when the smallest eigenvalue of the
+ * gram matrix is not larger than the square root of the machine epsilon times the largest, the singular vectors would
+ * lose their orthonormality.
+ *
+ * @param A matrix to decompose
+ * @return std::optional<std::tuple<torch::Tensor, torch::Tensor, torch::Tensor>> U,d,V, same convention as
+ * torch::svd, or nothing if the decomposition would be inaccurate.
+ */
+std::optional<std::tuple<torch::Tensor, torch::Tensor, torch::Tensor>> gram_svd(const torch::Tensor &A)
+{
+	const bool wide = A.sizes()[A.dim() - 2] <= A.sizes()[A.dim() - 1];
+	auto A_dag = A.transpose(-2, -1).conj();
+	auto [e, W] = torch::linalg::eigh(wide ? torch::matmul(A, A_dag) : torch::matmul(A_dag, A), "L");
+	const double sqrt_eps = e.scalar_type() == torch::kDouble ? std::sqrt(std::numeric_limits<double>::epsilon())
+	                                                          : std::sqrt(std::numeric_limits<float>::epsilon());
+	// eigenvalues are in ascending order.
+	if (!(e.select(-1, 0) > e.select(-1, -1) * sqrt_eps).all().item().toBool())
+		return std::nullopt;
+	auto d = e.flip(-1).sqrt();
+	W = W.flip(-1);
+	auto other = torch::matmul(wide ? A_dag : A, W) / d.unsqueeze(-2);
+	return wide ? std::make_tuple(W, d, other) : std::make_tuple(other, d, W);
+}
+/**
+ * @brief whether a m by n block should be decomposed by gram_svd.
+ *
+ * Only on the CPU: the conditioning check of gram_svd reads the eigenvalues back, which would synchronize with the
+ * device once per sector, and a fallback decided on the device would have to compute the svd anyway.
+ */
+bool use_gram_svd(const torch::Tensor &block, bool some, bool compute_uv)
+{
+	auto m = block.sizes()[block.dim() - 2];
+	auto n = block.sizes()[block.dim() - 1];
+	auto small = std::min(m, n);
+	auto large = std::max(m, n);
+	return block.device() == torch::kCPU and some and compute_uv and large >= gram_svd_min_size and
+	       large >= gram_svd_aspect_ratio * small;
+}
+/**
+ * @brief whether a block with the given smallest dimension should be decomposed by the randomized svd.
+ */
+bool use_randomized_svd(size_t rank, int64_t smallest_dim, const randomized_svd_options &options)
+{
+	// the options' fields are public: the rank is also checked against the block, such that the sample never has more
+	// columns than the block has singular values.
+	return rank < static_cast<size_t>(smallest_dim) and rank < options.rank_fraction * smallest_dim;
+}
+/**
+ * @brief batched svd, the blocks where at most rank singular values are wanted and use_randomized_svd is true are
+ * decomposed with randomized_svd.
+ */
+std::tuple<btensor, btensor, btensor> svd_impl(const btensor &tensor, const BOOL some, const BOOL compute_uv,
+                                               size_t rank, const randomized_svd_options &randomized)
 {
 	// extract independant btensors
 	// fmt::print("========SVD input =======\n{}\n\n",tensor);
@@ -412,10 +535,15 @@ std::tuple<btensor, btensor, btensor> svd(const btensor &tensor, const BOOL some
 		*D_lcval_it = D_rcval_it->inverse();
 		U_blocks += rows.size();
 		V_blocks += cols.size();
-		if (some)
+		auto smallest_dim =
+		    std::min(basictensor.sizes()[basictensor.dim() - 1], basictensor.sizes()[basictensor.dim() - 2]);
+		if (use_randomized_svd(rank, smallest_dim, randomized))
 		{
-			*D_bsize_it =
-			    std::min(basictensor.sizes()[basictensor.dim() - 1], basictensor.sizes()[basictensor.dim() - 2]);
+			*D_bsize_it = rank;
+		}
+		else if (some)
+		{
+			*D_bsize_it = smallest_dim;
 		}
 		else
 		{
@@ -480,17 +608,26 @@ std::tuple<btensor, btensor, btensor> svd(const btensor &tensor, const BOOL some
 	for (auto &[basictensor, other_indices, rows, cols] : tensors_n_indices)
 	{
 		// fmt::print("======basictensor=======\n {}\n\n", basictensor );
-		auto [bU, bD, bV] = torch::svd(basictensor, some, compute_uv);
+		auto m = basictensor.sizes()[basictensor.dim() - 2];
+		auto n = basictensor.sizes()[basictensor.dim() - 1];
+		std::optional<std::tuple<torch::Tensor, torch::Tensor, torch::Tensor>> decomposition;
+		if (use_randomized_svd(rank, std::min(m, n), randomized))
+			decomposition = randomized_svd(basictensor, rank, randomized);
+		else if (use_gram_svd(basictensor, some, compute_uv))
+			decomposition = gram_svd(basictensor);
+		if (!decomposition)
+			decomposition = torch::svd(basictensor, some, compute_uv);
+		auto &[bU, bD, bV] = *decomposition;
 		auto extra_block_slice = std::make_tuple(b_i, torch::indexing::Slice());
 		for (auto &row : rows)
 		{
 			auto [block_ind, slice] = LA_helpers::build_index_slice(other_indices, row, extra_block_slice);
-			U.block(block_ind) = bU.index(slice);
+			U.block(block_ind) = rows.size() == 1 ? bU : bU.index(slice);
 		}
 		for (auto &col : cols)
 		{
 			auto [block_ind, slice] = LA_helpers::build_index_slice(other_indices, col, extra_block_slice);
-			V.block(block_ind) = bV.index(slice);
+			V.block(block_ind) = cols.size() == 1 ? bV : bV.index(slice);
 		}
 		auto [block_ind, slice] = LA_helpers::build_index_slice(other_indices, extra_block_slice, extra_block_slice);
 		d.block(btensor::index_list(block_ind.begin(), block_ind.end() - 1)) = bD;
@@ -500,12 +637,20 @@ std::tuple<btensor, btensor, btensor> svd(const btensor &tensor, const BOOL some
 	// return output tuple
 	return std::make_tuple(U, d, V.inverse_cvals_());
 }
-std::tuple<btensor, btensor, btensor> svd(const btensor &tensor, size_t split)
+std::tuple<btensor, btensor, btensor> svd(const btensor &tensor, const BOOL some, const BOOL compute_uv)
+{
+	return svd_impl(tensor, some, compute_uv, std::numeric_limits<size_t>::max(), randomized_svd_options());
+}
+/**
+ * @brief svd with the tensor reshaped to a matrix according to split, see svd_impl for rank and randomized.
+ */
+std::tuple<btensor, btensor, btensor> split_svd_impl(const btensor &tensor, size_t split, size_t rank,
+                                                     const randomized_svd_options &randomized)
 {
 	// reshape according to split
 	auto rtensor = tensor.reshape({static_cast<int64_t>(split)});
 	// call batched SVD
-	auto [rU, d, rV] = svd(rtensor);
+	auto [rU, d, rV] = svd_impl(rtensor, true, true, rank, randomized);
 	// undo reshape
 	std::vector<int64_t> U_shape(tensor.dim(), -1);
 	std::vector<int64_t> V_shape(tensor.dim(), -1);
@@ -532,12 +677,16 @@ std::tuple<btensor, btensor, btensor> svd(const btensor &tensor, size_t split)
 	// return tuple
 	return std::make_tuple(U, d, V);
 }
+std::tuple<btensor, btensor, btensor> svd(const btensor &tensor, size_t split)
+{
+	return split_svd_impl(tensor, split, std::numeric_limits<size_t>::max(), randomized_svd_options());
+}
 
 /**
  * @brief Search for the first index with a value not greater than val in a desccending ordered list of value. For
  * pytorch.
  *
- * Currently a linear search, a branchless binary search might be better.
+ * Branchless binary search.
  *
  * @tparam TorchAccessor
  * @tparam Value
@@ -548,13 +697,16 @@ std::tuple<btensor, btensor, btensor> svd(const btensor &tensor, size_t split)
 template <class TorchAccessor, class Value>
 int64_t lower_bound_impl2(TorchAccessor &acc, Value &val)
 {
-	int64_t i = 0;
-	for (; i < acc.size(0); ++i)
+	int64_t first = 0;
+	int64_t len = acc.size(0);
+	while (len > 0)
 	{
-		if (!(acc[i] > val))
-			break;
+		auto half = len / 2;
+		bool greater = acc[first + half] > val;
+		first += greater * (half + 1);
+		len = greater ? len - half - 1 : half;
 	}
-	return i;
+	return first;
 }
 
 template <torch::ScalarType Scal_type, torch::DeviceType Dev_type>
@@ -643,6 +795,147 @@ int64_t lower_bound(torch::Tensor &tens, const torch::Scalar &scal)
 	throw std::logic_error(fmt::format("unsupported backend {} for quantit::lower_bound(torch::Tensor&,torch::Scalar&>",
 	                                   c10::DeviceTypeName(tens.device().type())));
 }
+/**
+ * @brief k-way merge of the descending spectra of the blocks, stopped as soon as the remaining values can be discarded.
+ *
+ * Produces the same value as vd[compute_last_index(vd, tol, pow, min, max)] where vd would be the sorted concatenation
+ * of the blocks, without sorting the values that are going to be discarded. At least one value is always kept.
+ *
+ * @tparam stype scalar type of the values
+ * @param blocks descending spectra of the blocks, on the CPU
+ * @param tol tolerance on induced error
+ * @param pow power of the value to use in the error computation
+ * @param min minimum dimension, takes precedence over max and tol
+ * @param max maximum dimension, takes precedence over tol
+ * @return torch::Scalar smallest value to keep
+ */
+template <class stype>
+torch::Scalar merged_threshold(std::vector<torch::Tensor> &blocks, double tol, double pow, size_t min, size_t max)
+{
+	std::vector<torch::TensorAccessor<stype, 1>> accs;
+	accs.reserve(blocks.size());
+	double discarded = 0; // error induced by discarding all the values not yet merged.
+	for (auto &block : blocks)
+	{
+		accs.push_back(block.accessor<stype, 1>());
+		auto &acc = accs.back();
+		for (int64_t i = 0; i < acc.size(0); ++i)
+			discarded += std::pow(std::abs(static_cast<double>(acc[i])), pow);
+	}
+	// heap of the largest value of every block not yet exhausted, with the position of that value.
+	std::vector<std::tuple<stype, size_t, int64_t>> heap;
+	heap.reserve(accs.size());
+	for (size_t b = 0; b < accs.size(); ++b)
+		if (accs[b].size(0) > 0)
+			heap.emplace_back(accs[b][0], b, 0);
+	auto comp = [](const auto &a, const auto &b) { return std::get<0>(a) < std::get<0>(b); };
+	if (heap.empty())
+		return torch::Scalar(stype(0));
+	std::make_heap(heap.begin(), heap.end(), comp);
+	const double target = std::pow(tol, pow);
+	min = std::max<size_t>(min, 1);
+	size_t count = 0;
+	stype smallest = std::get<0>(heap.front());
+	while (!heap.empty() and (count < min or (count < max and discarded > target)))
+	{
+		std::pop_heap(heap.begin(), heap.end(), comp);
+		auto &[value, b, i] = heap.back();
+		smallest = value;
+		discarded -= std::pow(std::abs(static_cast<double>(value)), pow);
+		++count;
+		if (++i < accs[b].size(0))
+		{
+			value = accs[b][i];
+			std::push_heap(heap.begin(), heap.end(), comp);
+		}
+		else
+			heap.pop_back();
+	}
+	return torch::Scalar(smallest);
+}
+#define SWITCH_CASE_TORCHDTYPE_MERGE(CPPTYPE, c10ScalarType)                                                           \
+	case c10::ScalarType::c10ScalarType:                                                                               \
+		return merged_threshold<CPPTYPE>(blocks, tol.toDouble(), pow.toDouble(), min, max);                            \
+		break;
+/**
+ * @brief dispatch merged_threshold based on the scalar type of the blocks
+ */
+torch::Scalar merged_threshold(std::vector<torch::Tensor> &blocks, btensor::Scalar tol, btensor::Scalar pow, size_t min,
+                               size_t max)
+{
+	switch (torch::typeMetaToScalarType(blocks.front().dtype()))
+	{
+		AT_FORALL_SCALAR_TYPES(SWITCH_CASE_TORCHDTYPE_MERGE)
+	default:
+		throw std::invalid_argument(
+		    fmt::format("unsupported element type {} of tensors for truncation, complex numbers are unsupported.",
+		                blocks.front().dtype().name()));
+		break;
+	}
+}
+#undef SWITCH_CASE_TORCHDTYPE_MERGE
+/**
+ * @brief smallest value to keep in a descending list of singular values, such that the error induced by discarding the
+ * smaller values is within tol.
+ *
+ * Equivalent to vd[compute_last_index(vd, tol, pow, min, max)], computed without reading anything back from the
+ * device.
+ *
+ * @param vd singular values, in descending order
+ * @param tol tolerance on induced error
+ * @param pow power of the value to use in the error computation
+ * @param min minimum dimension, takes precedence over max and tol
+ * @param max maximum dimension, takes precedence over tol
+ * @return torch::Tensor rank 0 tensor
+ */
+torch::Tensor truncation_threshold(const torch::Tensor &vd, btensor::Scalar tol, btensor::Scalar pow, size_t min,
+                                   size_t max)
+{
+	const int64_t L = vd.sizes()[0];
+	const int64_t lowest = static_cast<int64_t>(std::min<size_t>(min, L)) - 1;
+	const int64_t highest = static_cast<int64_t>(std::min<size_t>(max, L)) - 1;
+	// error induced by discarding the values from each index onward.
+	auto tail = vd.abs().pow(pow).flip(0).cumsum(0).flip(0);
+	auto last_index =
+	    tail.gt(std::pow(tol.toDouble(), pow.toDouble())).sum().sub(1).clamp_max(highest).clamp_min(lowest);
+	last_index = torch::where(last_index.lt(0), last_index.add(L), last_index); // negative index count from the end.
+	return vd.index_select(0, last_index.reshape({1})).squeeze(0);
+}
+/**
+ * @brief number of values to keep in each block of singular values.
+ *
+ * On the CPU, the sorted spectra of the blocks are merged until the threshold is found. On other devices, the threshold
+ * and the counts are computed on the device, and the counts are read back in a single transfer.
+ */
+std::vector<int64_t> kept_counts(const std::vector<torch::Tensor> &d_blocks, btensor::Scalar tol, btensor::Scalar pow,
+                                 size_t min, size_t max)
+{
+	std::vector<int64_t> out;
+	out.reserve(d_blocks.size());
+	auto eps = epsilon(d_blocks.front().dtype());
+	if (d_blocks.front().device() == torch::kCPU)
+	{
+		auto blocks = d_blocks;
+		auto smallest_value = merged_threshold(blocks, tol, pow, min, max).toDouble();
+		// Better chance to preserve degenerate multiplets that way.
+		smallest_value -= 2 * smallest_value * eps.toDouble();
+		for (auto &db : blocks)
+			out.push_back(lower_bound(db, smallest_value));
+		return out;
+	}
+	auto vd = std::get<0>(torch::cat(d_blocks).sort(-1, true)); // sort the (only) dimension in descending order
+	auto smallest_value = truncation_threshold(vd, tol, pow, min, max);
+	smallest_value -= 2 * smallest_value * eps; // Better chance to preserve degenerate multiplets that way.
+	std::vector<torch::Tensor> kept;
+	kept.reserve(d_blocks.size());
+	for (const auto &db : d_blocks)
+		kept.push_back(db.gt(smallest_value).sum());
+	auto kept_count = torch::stack(kept).to(torch::kCPU);
+	auto kept_acc = kept_count.accessor<int64_t, 1>();
+	for (int64_t i = 0; i < kept_acc.size(0); ++i)
+		out.push_back(kept_acc[i]);
+	return out;
+}
 /**
  * @brief truncation for a decomposition that induce any number of unitary matrix and a list of scalar weights
  *
@@ -661,25 +954,14 @@ std::tuple<btensor, std::tuple<BTENS...>> truncate_impl(btensor &&d, std::tuple<
 	static_assert(std::conjunction_v<std::is_same<BTENS, btensor>...>, "The unitaries must be btensors!");
 	// d is a vector of singular values
 	assert(d.dim() == 1);
-	// prepare a list containing all the singular value
-	auto L = std::accumulate(d.begin(), d.end(), 0, [](auto &&a, auto &&b) { return a + std::get<1>(b).sizes()[0]; });
-	auto vd = torch::zeros(
-	    {L}, torch::device(torch::kCPU).dtype(torch::kDouble)); // always done on the CPU with double precicion
-	size_t n = 0;
+	if (d.begin() == d.end())
+		return std::make_tuple(std::move(d), std::move(unitaries));
+	// Every block is already sorted in descending order.
+	std::vector<torch::Tensor> d_blocks;
+	d_blocks.reserve(std::distance(d.begin(), d.end()));
 	for (const auto &block : d)
-	{
-		auto &tens = std::get<1>(block);
-		auto l = tens.sizes()[0];
-		vd.index_put_({torch::indexing::Slice(n, n + l)}, tens); // bug here.
-		n += l;
-	}
-	// quantit::print(vd);
-	vd = std::get<0>(
-	    vd.sort(-1, true)); // sort the last (only) dimension in descending order //no inplace sort in torch...
-	// vd is now sorted in ascending order.
-	auto smallest_value = vd.index({torch::indexing::Ellipsis, compute_last_index(vd, tol, pow, min, max)});
-	smallest_value -=
-	    2 * smallest_value * epsilon(d.options().dtype()); // Better chance to preserve degenerate multiplets that way.
+		d_blocks.push_back(std::get<1>(block));
+	auto kept = kept_counts(d_blocks, tol, pow, min, max);
 	// fmt::print("epsilon {}\n",epsilon(smallest_value).toDouble());
 	// for each block trio, we can remove all the values smaller than the one in smallest_value
 	// without inducing an error larger than the tol.
@@ -728,7 +1010,7 @@ std::tuple<btensor, std::tuple<BTENS...>> truncate_impl(btensor &&d, std::tuple<
 		using namespace torch::indexing;
 		// fmt::print("last_index! {}\n\n", db > smallest_value);
 		// fmt::print("last_index other order because of implicit casts!! {}\n\n",  smallest_value < db);
-		auto last_index = lower_bound(db, smallest_value.item());
+		auto last_index = kept[std::distance(d.begin(), d_it)];
 		if (last_index == 0)
 		{ // remove the whole block...
 			// i think, out of laziness and lack of advantages to the converse, i will only erase the blocks without
@@ -803,9 +1085,12 @@ std::tuple<btensor, btensor> truncate(btensor &&e, btensor &&S, size_t max, size
 }
 
 std::tuple<btensor, btensor, btensor> svd(const btensor &A, size_t split, btensor::Scalar tol, size_t min_size,
-                                          size_t max_size, btensor::Scalar pow)
+                                          size_t max_size, btensor::Scalar pow,
+                                          const randomized_svd_options &randomized)
 {
-	return truncate(svd(A, split), max_size, min_size, tol, pow);
+	// no block can contribute more than that many values to the truncated decomposition.
+	auto rank = std::max(min_size, max_size);
+	return truncate(split_svd_impl(A, split, rank, randomized), max_size, min_size, tol, pow);
 }
 std::tuple<btensor, btensor, btensor> svd(const btensor &A, size_t split, btensor::Scalar tol, btensor::Scalar pow)
 {
@@ -0,0 +1,438 @@
+/*
+ * File: checkpoint.cpp
+ * Project: QuantiT
+ * File Created: Sunday, 18th October 2026 9:52:18 pm
+ * Author: Alexandre Foley (Alexandre.foley@usherbrooke.ca)
+ * Copyright (c) 2026 Alexandre Foley
+ * Licensed under GPL v3
+ */
+
+#include "checkpoint.h"
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <fmt/core.h>
+#include <fstream>
+#include <memory>
+#include <numeric>
+#include <random>
+#include <stdexcept>
+#include <system_error>
+#ifndef _WIN32
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace quantit
+{
+
+namespace
+{
+
+constexpr std::array<char, 8> file_magic{'Q', 'T', 'T', 'C', 'K', 'P', 'T', '\0'};
+constexpr uint32_t format_version = 1;
+constexpr uint32_t byte_order_mark = 0x01020304;
+constexpr uint64_t alignment = 64;
+
+struct file_header
+{
+	std::array<char, 8> magic;
+	uint32_t version;
+	uint32_t byte_order;
+	uint64_t metadata_words;
+	uint64_t payload_offset;
+	uint64_t payload_bytes;
+	uint64_t reserved[3];
+};
+static_assert(sizeof(file_header) == alignment, "the header must fill exactly one alignment unit");
+
+uint64_t aligned(uint64_t offset) { return (offset + alignment - 1) / alignment * alignment; }
+
+std::runtime_error corrupted(const std::filesystem::path &path, const std::string &reason)
+{
+	return std::runtime_error(fmt::format("corrupted checkpoint file {}: {}", path.string(), reason));
+}
+
+// the scalar types are stored by name, the values of the enum aren't stable across versions of torch.
+torch::ScalarType scalar_type(const std::string &name)
+{
+	constexpr std::array<torch::ScalarType, 12> types{
+	    torch::kFloat32,  torch::kFloat64, torch::kComplexFloat, torch::kComplexDouble, torch::kFloat16,
+	    torch::kBFloat16, torch::kInt64,   torch::kInt32,        torch::kInt16,         torch::kInt8,
+	    torch::kUInt8,    torch::kBool};
+	auto it = std::find_if(types.begin(), types.end(), [&name](auto type) { return name == c10::toString(type); });
+	if (it == types.end())
+		throw std::invalid_argument(fmt::format("unsupported scalar type {} in checkpoint file", name));
+	return *it;
+}
+
+void write_string(std::vector<int64_t> &words, const std::string &str)
+{
+	words.push_back(str.size());
+	for (size_t i = 0; i < str.size(); i += sizeof(int64_t))
+	{
+		int64_t word = 0;
+		std::memcpy(&word, str.data() + i, std::min(sizeof(int64_t), str.size() - i));
+		words.push_back(word);
+	}
+}
+
+class metadata_reader
+{
+	const std::filesystem::path &path;
+	const int64_t *pos;
+	const int64_t *end;
+
+  public:
+	metadata_reader(const std::filesystem::path &_path, const std::vector<int64_t> &words)
+	    : path(_path), pos(words.data()), end(words.data() + words.size())
+	{
+	}
+	const int64_t *take(size_t count)
+	{
+		if (count > static_cast<size_t>(end - pos))
+			throw corrupted(path, "the metadata is truncated");
+		auto out = pos;
+		pos += count;
+		return out;
+	}
+	int64_t next() { return *take(1); }
+	size_t count()
+	{
+		auto out = next();
+		if (out < 0)
+			throw corrupted(path, "negative count in the metadata");
+		return out;
+	}
+	std::vector<int64_t> list(size_t count)
+	{
+		auto first = take(count);
+		return std::vector<int64_t>(first, first + count);
+	}
+	std::string string()
+	{
+		auto length = count();
+		auto words = take((length + sizeof(int64_t) - 1) / sizeof(int64_t));
+		std::string out(length, '\0');
+		std::memcpy(out.data(), words, length);
+		return out;
+	}
+};
+
+struct block_entry
+{
+	const torch::Tensor *block;
+	uint64_t offset;
+	uint64_t bytes;
+};
+
+/**
+ * Append the description of the tensor to the metadata, and its blocks to the payload.
+ * layout: rank, scalar type, sections by dim, section sizes, quantity tag, number of groups, selection rule, conserved
+ * quantities of the sections, number of blocks, and for each block: block index, offset and size in bytes.
+ */
+void describe(const btensor &tensor, std::vector<int64_t> &words, std::vector<block_entry> &blocks,
+              uint64_t &payload_bytes)
+{
+	const auto &sel_rule = tensor.selection_rule->get();
+	auto tag = sel_rule.type_tag();
+	if (tag.empty())
+		throw std::invalid_argument("the conserved quantities of this tensor cannot be stored, specialize "
+		                            "conserved::group_serializer for each of their groups.");
+	const auto rank = tensor.dim();
+	words.push_back(rank);
+	write_string(words, c10::toString(c10::typeMetaToScalarType(tensor.options().dtype())));
+	const auto &sections = tensor.section_numbers();
+	words.insert(words.end(), sections.begin(), sections.end());
+	for (int64_t i = 0; i < rank; ++i)
+	{
+		auto [sizes_beg, sizes_end] = tensor.section_sizes(i);
+		words.insert(words.end(), sizes_beg, sizes_end);
+	}
+	write_string(words, tag);
+	auto groups_pos = words.size();
+	words.push_back(0);
+	sel_rule.serialize(words);
+	words[groups_pos] = words.size() - groups_pos - 1;
+	// a default constructed tensor has no conserved quantities at all, count them from the sections.
+	const auto &c_vals = tensor.get_cvals();
+	const auto section_count = std::accumulate(sections.begin(), sections.end(), int64_t(0));
+	for (int64_t i = 0; i < section_count; ++i)
+		c_vals[i].serialize(words);
+	words.push_back(tensor.blocks().size());
+	for (const auto &[index, block] : tensor.blocks())
+	{
+		words.insert(words.end(), index.begin(), index.end());
+		uint64_t bytes = block.numel() * block.element_size();
+		payload_bytes = aligned(payload_bytes);
+		words.push_back(payload_bytes);
+		words.push_back(bytes);
+		blocks.push_back({&block, payload_bytes, bytes});
+		payload_bytes += bytes;
+	}
+}
+
+/**
+ * Private read-write mapping of a whole file, the file is never modified.
+ */
+struct file_mapping
+{
+	char *data;
+	size_t size;
+	file_mapping(char *_data, size_t _size) : data(_data), size(_size) {}
+	file_mapping(const file_mapping &) = delete;
+	file_mapping &operator=(const file_mapping &) = delete;
+	~file_mapping()
+	{
+#ifndef _WIN32
+		munmap(data, size);
+#endif
+	}
+};
+
+/**
+ * @brief flush the file or directory at path to the storage device, such that a rename is only visible once the content
+ * it exposes is durable. Nothing is done without POSIX.
+ */
+void sync_path(const std::filesystem::path &path, bool directory)
+{
+#ifndef _WIN32
+	int fd = open(path.c_str(), directory ? O_RDONLY | O_DIRECTORY : O_RDONLY);
+	if (fd < 0)
+		throw std::system_error(errno, std::generic_category(), fmt::format("cannot open {} to sync it", path.string()));
+	int err = fsync(fd) == 0 ? 0 : errno;
+	close(fd);
+	// some file systems can't sync a directory, the rename is then as durable as it gets.
+	if (err != 0 and not(directory and err == EINVAL))
+		throw std::system_error(err, std::generic_category(), fmt::format("cannot sync {}", path.string()));
+#endif
+}
+
+// return nullptr if the file cannot be mapped.
+std::shared_ptr<file_mapping> map_file(const std::filesystem::path &path, size_t size)
+{
+#ifdef _WIN32
+	return nullptr;
+#else
+	int fd = open(path.c_str(), O_RDONLY);
+	if (fd < 0)
+		return nullptr;
+	void *data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (data == MAP_FAILED)
+		return nullptr;
+	return std::make_shared<file_mapping>(static_cast<char *>(data), size);
+#endif
+}
+
+btensor read_tensor(const std::filesystem::path &path, metadata_reader &reader, const file_header &header,
+                    const std::shared_ptr<file_mapping> &mapping, std::ifstream &in)
+{
+	const auto rank = reader.count();
+	const auto type = scalar_type(reader.string());
+	const auto element_size = static_cast<int64_t>(c10::elementSize(type));
+	auto sections_by_dim = reader.list(rank);
+	std::vector<size_t> first_section(rank);
+	size_t section_count = 0;
+	for (size_t i = 0; i < rank; ++i)
+	{
+		if (sections_by_dim[i] < 0)
+			throw corrupted(path, "negative number of sections");
+		first_section[i] = section_count;
+		section_count += sections_by_dim[i];
+	}
+	auto section_sizes = reader.list(section_count);
+	auto tag = reader.string();
+	const auto groups = reader.count();
+	auto sel_rule = make_quantity(tag, reader.take(groups), groups);
+	auto c_val_words = reader.take(section_count * groups);
+	any_quantity_vector c_vals(0, sel_rule);
+	c_vals.reserve(section_count);
+	for (size_t i = 0; i < section_count; ++i)
+		c_vals.push_back(make_quantity(tag, c_val_words + i * groups, groups));
+
+	const auto block_count = reader.count();
+	auto options = torch::TensorOptions().dtype(type);
+	btensor::block_list_t::content_t blocks;
+	blocks.reserve(block_count);
+	for (size_t b = 0; b < block_count; ++b)
+	{
+		auto index = reader.list(rank);
+		std::vector<int64_t> shape(rank);
+		int64_t bytes = element_size;
+		for (size_t i = 0; i < rank; ++i)
+		{
+			if (index[i] < 0 or index[i] >= sections_by_dim[i])
+				throw corrupted(path, "block index out of range");
+			shape[i] = section_sizes[first_section[i] + index[i]];
+			bytes *= shape[i];
+		}
+		const auto offset = reader.next();
+		if (reader.next() != bytes or offset < 0 or offset % alignment != 0 or
+		    static_cast<uint64_t>(offset + bytes) > header.payload_bytes)
+			throw corrupted(path, "block outside of the payload");
+		torch::Tensor block;
+		if (mapping)
+		{
+			// the deleter holds the mapping, which is released with the last block.
+			block = torch::from_blob(mapping->data + header.payload_offset + offset, shape, [mapping](void *) {},
+			                         options);
+		}
+		else
+		{
+			block = torch::empty(shape, options);
+			in.seekg(header.payload_offset + offset);
+			in.read(static_cast<char *>(block.data_ptr()), bytes);
+			if (not in)
+				throw corrupted(path, "the payload is truncated");
+		}
+		blocks.emplace_back(std::move(index), std::move(block));
+	}
+	return btensor(rank, btensor::block_list_t(std::move(blocks)), std::move(sections_by_dim),
+	               std::move(section_sizes), std::move(c_vals), std::move(sel_rule), options);
+}
+
+checkpoint load_kind(const std::filesystem::path &path, bool memory_map, const std::string &kind)
+{
+	auto content = load_checkpoint(path, memory_map);
+	if (content.kind != kind)
+		throw std::invalid_argument(
+		    fmt::format("the checkpoint file {} contains a {}, not a {}", path.string(), content.kind, kind));
+	return content;
+}
+
+} // namespace
+
+void save_checkpoint(const std::filesystem::path &path, const checkpoint &content)
+{
+	std::vector<int64_t> words;
+	write_string(words, content.kind);
+	words.push_back(content.metadata.size());
+	words.insert(words.end(), content.metadata.begin(), content.metadata.end());
+	words.push_back(content.tensors.size());
+	std::vector<block_entry> blocks;
+	uint64_t payload_bytes = 0;
+	for (const auto &tensor : content.tensors)
+		describe(tensor, words, blocks, payload_bytes);
+
+	file_header header{};
+	header.magic = file_magic;
+	header.version = format_version;
+	header.byte_order = byte_order_mark;
+	header.metadata_words = words.size();
+	header.payload_offset = aligned(sizeof(file_header) + words.size() * sizeof(int64_t));
+	header.payload_bytes = payload_bytes;
+
+	// a temporary file of its own for every write, concurrent writers to the same path never mix their content.
+	thread_local std::mt19937_64 generator((std::random_device())());
+	auto tmp_path = path;
+	tmp_path += fmt::format(".{:016x}.tmp", generator());
+	{
+		std::ofstream out(tmp_path, std::ios::binary | std::ios::trunc);
+		if (not out)
+			throw std::runtime_error(fmt::format("cannot open {} for writing", tmp_path.string()));
+		uint64_t position = 0;
+		auto write = [&](const void *data, uint64_t bytes)
+		{
+			out.write(static_cast<const char *>(data), bytes);
+			position += bytes;
+		};
+		auto pad_to = [&](uint64_t target)
+		{
+			static const std::array<char, alignment> zeros{};
+			write(zeros.data(), target - position);
+		};
+		write(&header, sizeof(header));
+		write(words.data(), words.size() * sizeof(int64_t));
+		for (const auto &entry : blocks)
+		{
+			pad_to(header.payload_offset + entry.offset);
+			auto data = entry.block->detach().to(torch::kCPU).resolve_conj().resolve_neg().contiguous();
+			write(data.data_ptr(), entry.bytes);
+		}
+		pad_to(header.payload_offset + payload_bytes);
+		out.close();
+		if (not out)
+			throw std::runtime_error(fmt::format("error while writing {}", tmp_path.string()));
+	}
+	// the content must reach the disk before the rename, and the rename before the previous checkpoint is forgotten.
+	sync_path(tmp_path, false);
+	std::filesystem::rename(tmp_path, path);
+	auto directory = path.parent_path();
+	sync_path(directory.empty() ? std::filesystem::path(".") : directory, true);
+}
+
+checkpoint load_checkpoint(const std::filesystem::path &path, bool memory_map)
+{
+	std::ifstream in(path, std::ios::binary);
+	if (not in)
+		throw std::runtime_error(fmt::format("cannot open {} for reading", path.string()));
+	const uint64_t file_size = std::filesystem::file_size(path);
+	file_header header;
+	if (file_size < sizeof(header) or not in.read(reinterpret_cast<char *>(&header), sizeof(header)))
+		throw corrupted(path, "the header is truncated");
+	if (header.magic != file_magic)
+		throw std::invalid_argument(fmt::format("{} isn't a checkpoint file", path.string()));
+	if (header.version != format_version)
+		throw std::invalid_argument(fmt::format("{} has the checkpoint format version {}, this build reads version {}",
+		                                        path.string(), header.version, format_version));
+	if (header.byte_order != byte_order_mark)
+		throw std::invalid_argument(
+		    fmt::format("{} was written on a machine with a different byte order", path.string()));
+	if (header.metadata_words > (file_size - sizeof(header)) / sizeof(int64_t) or
+	    header.payload_offset < sizeof(header) + header.metadata_words * sizeof(int64_t) or
+	    header.payload_offset > file_size or header.payload_bytes > file_size - header.payload_offset)
+		throw corrupted(path, "the file is smaller than its header states");
+	std::vector<int64_t> words(header.metadata_words);
+	if (not in.read(reinterpret_cast<char *>(words.data()), words.size() * sizeof(int64_t)))
+		throw corrupted(path, "the metadata is truncated");
+
+	auto mapping = memory_map ? map_file(path, file_size) : nullptr;
+	metadata_reader reader(path, words);
+	checkpoint out;
+	out.kind = reader.string();
+	out.metadata = reader.list(reader.count());
+	const auto tensor_count = reader.count();
+	out.tensors.reserve(tensor_count);
+	for (size_t i = 0; i < tensor_count; ++i)
+		out.tensors.push_back(read_tensor(path, reader, header, mapping, in));
+	return out;
+}
+
+void save(const btensor &tensor, const std::filesystem::path &path)
+{
+	save_checkpoint(path, {"btensor", {}, {tensor}});
+}
+void save(const bMPS &state, const std::filesystem::path &path)
+{
+	save_checkpoint(path, {"bMPS",
+	                       {static_cast<int64_t>(size_t(state.orthogonality_center))},
+	                       std::vector<btensor>(state.begin(), state.end())});
+}
+void save(const bMPO &op, const std::filesystem::path &path)
+{
+	save_checkpoint(path, {"bMPO", {}, std::vector<btensor>(op.begin(), op.end())});
+}
+
+btensor load_btensor(const std::filesystem::path &path, bool memory_map)
+{
+	auto content = load_kind(path, memory_map, "btensor");
+	if (content.tensors.size() != 1)
+		throw corrupted(path, "a btensor checkpoint must contain one tensor");
+	return std::move(content.tensors[0]);
+}
+bMPS load_bMPS(const std::filesystem::path &path, bool memory_map)
+{
+	auto content = load_kind(path, memory_map, "bMPS");
+	if (content.metadata.size() != 1 or content.metadata[0] < 0)
+		throw corrupted(path, "a bMPS checkpoint must store its orthogonality center");
+	return bMPS(std::move(content.tensors), content.metadata[0]);
+}
+bMPO load_bMPO(const std::filesystem::path &path, bool memory_map)
+{
+	return bMPO(std::move(load_kind(path, memory_map, "bMPO").tensors));
+}
+
+} // namespace quantit
@@ -0,0 +1,161 @@
+/*
+ * File: correlations.cpp
+ * Project: QuantiT
+ * File Created: Sunday, 18th October 2026 8:02:47 pm
+ * Author: Alexandre Foley (Alexandre.foley@usherbrooke.ca)
+ * Copyright (c) 2026 Alexandre Foley
+ * Licensed under GPL v3
+ */
+
+#include "correlations.h"
+#include "dmrg.h"
+#include <fmt/core.h>
+#include <stdexcept>
+
+namespace quantit
+{
+
+namespace
+{
+
+/**
+ * Environments of the norm, index ordering: (ket, bra).
+ * left_env(i) contains the sites [0,i), right_env(i) the sites [i,N).
+ */
+template <class MPS_t>
+class norm_environments
+{
+	using Tens = typename MPS_t::Tens;
+	const MPS_t &state;
+	std::vector<Tens> left;
+	std::vector<Tens> right;
+
+  public:
+	explicit norm_environments(const MPS_t &_state) : state(_state), left(_state.size() + 1), right(_state.size() + 1)
+	{
+		if (state.size() == 0)
+			throw std::invalid_argument("cannot measure an empty MPS");
+		auto left_shape = details::edge_shape_prep(state.front(), 0);
+		left[0] = ones_like(shape_from(left_shape, left_shape.inverse_cvals()),
+		                    torch::TensorOptions().requires_grad(false));
+		auto right_shape = details::edge_shape_prep(state.back(), 2);
+		right[state.size()] = ones_like(shape_from(right_shape, right_shape.inverse_cvals()),
+		                                torch::TensorOptions().requires_grad(false));
+		for (size_t i = 0; i < state.size(); ++i)
+			left[i + 1] = transfer(left[i], i);
+		for (size_t i = state.size(); i > 0; --i)
+		{
+			auto tmp = tensordot(state[i - 1], right[i], {2}, {0});             // (a, s, b')
+			right[i - 1] = tensordot(tmp, state[i - 1].conj(), {1, 2}, {1, 2}); // (a, a')
+		}
+	}
+	const Tens &left_env(size_t i) const { return left[i]; }
+	const Tens &right_env(size_t i) const { return right[i]; }
+	Tens norm() const { return tensordot(left.back(), right.back(), {0, 1}, {0, 1}); }
+	/**
+	 * @brief carry the environment env over site i, with op applied on the ket.
+	 */
+	Tens transfer(const Tens &env, size_t i, const Tens &op) const
+	{
+		auto out = tensordot(env, state[i], {0}, {0});          // (a', s, b)
+		out = tensordot(out, op, {1}, {1});                     // (a', b, s')
+		return tensordot(out, state[i].conj(), {0, 2}, {0, 1}); // (b, b')
+	}
+	Tens transfer(const Tens &env, size_t i) const
+	{
+		auto out = tensordot(env, state[i], {0}, {0});          // (a', s, b)
+		return tensordot(out, state[i].conj(), {0, 1}, {0, 1}); // (b, b')
+	}
+	/**
+	 * @brief close the environment env with op on site i and the right environment of the norm.
+	 */
+	Tens close(const Tens &env, size_t i, const Tens &op) const
+	{
+		return tensordot(transfer(env, i, op), right[i + 1], {0, 1}, {0, 1});
+	}
+};
+
+// values are written in a torch tensor, read back from the device only for the block tensors.
+const torch::Tensor &scalar_value(const torch::Tensor &value) { return value; }
+torch::Scalar scalar_value(const btensor &value) { return value.item(); }
+
+template <class MPS_t, class Tens>
+std::vector<torch::Tensor> expectation_values_impl(const MPS_t &state, const std::vector<Tens> &ops)
+{
+	norm_environments<MPS_t> envs(state);
+	const auto length = static_cast<int64_t>(state.size());
+	auto norm = scalar_value(envs.norm());
+	std::vector<torch::Tensor> out;
+	out.reserve(ops.size());
+	for (const auto &op : ops)
+	{
+		auto values = torch::zeros({length}, state[0].options());
+		for (int64_t i = 0; i < length; ++i)
+			values.index_put_({i}, scalar_value(envs.close(envs.left_env(i), i, op)));
+		out.push_back(values.div_(norm));
+	}
+	return out;
+}
+
+template <class MPS_t, class Tens>
+std::vector<torch::Tensor> correlations_impl(const MPS_t &state, const std::vector<two_point_operator<Tens>> &ops)
+{
+	norm_environments<MPS_t> envs(state);
+	const auto length = static_cast<int64_t>(state.size());
+	auto norm = scalar_value(envs.norm());
+	std::vector<torch::Tensor> out;
+	out.reserve(ops.size());
+	for (const auto &op : ops)
+	{
+		auto values = torch::zeros({length, length}, state[0].options());
+		auto local_product = tensordot(op.left, op.right, {1}, {0});
+		for (int64_t i = 0; i < length; ++i)
+		{
+			const auto &env = envs.left_env(i);
+			values.index_put_({i, i}, scalar_value(envs.close(env, i, local_product)));
+			// branches with left or right inserted on site i, closed by the other one on site j.
+			auto left_branch = envs.transfer(env, i, op.left);
+			auto right_branch = envs.transfer(env, i, op.right);
+			for (int64_t j = i + 1; j < length; ++j)
+			{
+				values.index_put_({i, j}, scalar_value(envs.close(left_branch, j, op.right)));
+				values.index_put_({j, i}, scalar_value(envs.close(right_branch, j, op.left)));
+				if (j + 1 == length)
+					break;
+				if (op.string)
+				{
+					left_branch = envs.transfer(left_branch, j, *op.string);
+					right_branch = envs.transfer(right_branch, j, *op.string);
+				}
+				else
+				{
+					left_branch = envs.transfer(left_branch, j);
+					right_branch = envs.transfer(right_branch, j);
+				}
+			}
+		}
+		out.push_back(values.div_(norm));
+	}
+	return out;
+}
+
+} // namespace
+
+std::vector<torch::Tensor> expectation_values(const MPS &state, const std::vector<torch::Tensor> &ops)
+{
+	return expectation_values_impl(state, ops);
+}
+std::vector<torch::Tensor> expectation_values(const bMPS &state, const std::vector<btensor> &ops)
+{
+	return expectation_values_impl(state, ops);
+}
+std::vector<torch::Tensor> correlations(const MPS &state, const std::vector<two_point_operator<torch::Tensor>> &ops)
+{
+	return correlations_impl(state, ops);
+}
+std::vector<torch::Tensor> correlations(const bMPS &state, const std::vector<two_point_operator<btensor>> &ops)
+{
+	return correlations_impl(state, ops);
+}
+
+} // namespace quantit
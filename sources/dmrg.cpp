@@ -13,12 +13,24 @@
 
 #include "dmrg.h"
 #include "LinearAlgebra.h"
+#include "MPO_apply.h"
 #include "blockTensor/LinearAlgebra.h"
 #include "blockTensor/btensor.h"
+#include "checkpoint.h"
 #include "numeric.h"
 #include "torch_formatter.h"
+#include <atomic>
+#include <cassert>
+#include <chrono>
 #include <fmt/core.h>
+#include <future>
+#include <map>
+#include <mutex>
+#include <numeric>
 #include <random>
+#include <set>
+#include <thread>
+#include <vector>
 namespace quantit
 {
 
@@ -30,15 +42,69 @@ void print(T &&...X)
   // for some reason the arguement still got evaluated.
 	fmt::print(std::forward<T>(X)...);
 }
+torch::Tensor compute_left_overlap(const torch::Tensor &state, const torch::Tensor &reference,
+                                   const torch::Tensor &left_overlap);
+btensor compute_left_overlap(const btensor &state, const btensor &reference, const btensor &left_overlap);
+torch::Tensor compute_right_overlap(const torch::Tensor &state, const torch::Tensor &reference,
+                                    const torch::Tensor &right_overlap);
+btensor compute_right_overlap(const btensor &state, const btensor &reference, const btensor &right_overlap);
+torch::Tensor project_reference(const torch::Tensor &reference_left, const torch::Tensor &reference_right,
+                                const torch::Tensor &left_overlap, const torch::Tensor &right_overlap);
+btensor project_reference(const btensor &reference_left, const btensor &reference_right, const btensor &left_overlap,
+                          const btensor &right_overlap);
+
 template <class X>
 struct env_holder_impl
 {
 	static_assert(std::is_same_v<X, MPT> or std::is_same_v<X, bMPT>,
 	              "must be either a MPT of basic tensor or block tensors");
 	using Tens = typename X::Tens;
+	using MPS_t = typename dependant_tensor_network<X>::MPS_type;
 	X env;
+	// Excited states: the normalized states penalized by the update, the penalty weight and the overlap environments of
+	// each reference with the state being optimized. The overlap environments are indexed like env.
+	std::vector<MPS_t> references;
+	std::vector<X> overlap_env;
+	double overlap_weight = 0;
 	Tens &operator[](int64_t i) { return env[i + 1]; }
 	const Tens &operator[](int64_t i) const { return env[i + 1]; }
+
+	void to_(torch::ScalarType type)
+	{
+		env.to_(type);
+		for (auto &ref : references)
+			ref.to_(type);
+		for (auto &ovlp : overlap_env)
+			ovlp.to_(type);
+	}
+	/**
+	 * @brief update the left overlap environment of site i with every reference
+	 */
+	void update_left_overlaps(int64_t i, const MPS_t &state)
+	{
+		for (size_t k = 0; k < references.size(); ++k)
+			overlap_env[k][i + 1] = compute_left_overlap(state[i], references[k][i], overlap_env[k][i]);
+	}
+	/**
+	 * @brief update the right overlap environment of site i with every reference
+	 */
+	void update_right_overlaps(int64_t i, const MPS_t &state)
+	{
+		for (size_t k = 0; k < references.size(); ++k)
+			overlap_env[k][i + 1] = compute_right_overlap(state[i], references[k][i], overlap_env[k][i + 2]);
+	}
+	/**
+	 * @brief projection of every reference on the local basis of the two sites state at sites (i,i+1)
+	 */
+	std::vector<Tens> local_references(int64_t i) const
+	{
+		std::vector<Tens> out;
+		out.reserve(references.size());
+		for (size_t k = 0; k < references.size(); ++k)
+			out.push_back(project_reference(references[k][i], references[k][i + 1], overlap_env[k][i],
+			                                overlap_env[k][i + 3]));
+		return out;
+	}
 };
 class env_holder : public env_holder_impl<MPT>
 {
@@ -54,6 +120,9 @@ btensor dmrg_impl(const bMPO &hamiltonian, const bMPT &two_site_hamil, bMPS &in_
                   benv_holder &Env);
 env_holder generate_env(const MPO &hamiltonian, const MPS &in_out_state);
 benv_holder generate_env(const bMPO &hamiltonian, const bMPS &in_out_state);
+benv_holder generate_env(const bMPO &hamiltonian, const bMPS &in_out_state, const btensor &left_edge,
+                         const btensor &right_edge);
+std::tuple<btensor, btensor> trivial_edges(const bMPO &hamiltonian, const bMPS &state);
 torch::Tensor compute_left_env(const torch::Tensor &Hamil, const torch::Tensor &MPS, const torch::Tensor &left_env);
 btensor compute_left_env(const btensor &Hamil, const btensor &MPS, const btensor &left_env);
 torch::Tensor compute_right_env(const torch::Tensor &Hamil, const torch::Tensor &MPS, const torch::Tensor &left_env);
@@ -63,6 +132,17 @@ std::tuple<btensor, btensor> two_sites_update(const btensor &state, const btenso
 std::tuple<torch::Tensor, torch::Tensor> two_sites_update(const torch::Tensor &state, const torch::Tensor &hamil,
                                                           const torch::Tensor &Left_environment,
                                                           const torch::Tensor &Right_environment);
+std::tuple<btensor, btensor> two_sites_update(const btensor &state, const btensor &hamil,
+                                              const btensor &Left_environment, const btensor &Right_environment,
+                                              const std::vector<btensor> &references, double weight);
+std::tuple<torch::Tensor, torch::Tensor> two_sites_update(const torch::Tensor &state, const torch::Tensor &hamil,
+                                                          const torch::Tensor &Left_environment,
+                                                          const torch::Tensor &Right_environment,
+                                                          const std::vector<torch::Tensor> &references, double weight);
+std::tuple<torch::Tensor, torch::Tensor> two_sites_update(const torch::Tensor &state, const sparse_MPO_site &left_hamil,
+                                                          const sparse_MPO_site &right_hamil,
+                                                          const torch::Tensor &Left_environment,
+                                                          const torch::Tensor &Right_environment);
 
 template <class MPO_t, class MPS_t>
 class dmrg_gradient_guard
@@ -89,6 +169,114 @@ class dmrg_gradient_guard
 	}
 };
 
+/**
+ * @brief scalar type used for the warm-up sweeps of mixed precision dmrg.
+ *
+ * Double precision types are mapped to their single precision counterpart. Any other type is returned unchanged, which
+ * disable the warm-up.
+ */
+torch::ScalarType reduced_precision(torch::ScalarType type)
+{
+	switch (type)
+	{
+	case torch::kDouble:
+		return torch::kFloat;
+	case torch::kComplexDouble:
+		return torch::kComplexFloat;
+	default:
+		return type;
+	}
+}
+
+/**
+ * @brief Select the networks used by the sweeps of mixed precision dmrg.
+ *
+ * When options.mixed_precision is set and the state is in double precision, the state and the environments are
+ * converted to single precision and the sweeps use single precision copies of the hamiltonians. promote() converts the
+ * state and the environments back to the original precision and switch the sweeps to the original hamiltonians, such
+ * that no rounding of the hamiltonian survives the warm-up.
+ */
+template <class MPO_t>
+class dmrg_precision_policy
+{
+	using MPT_t = typename dependant_tensor_network<MPO_t>::MPT_type;
+	using MPS_t = typename dependant_tensor_network<MPO_t>::MPS_type;
+	using env_t = typename dependant_tensor_network<MPO_t>::env_type;
+
+	const MPO_t &full_hamil;
+	const MPT_t &full_twosites_hamil;
+	MPO_t low_hamil;
+	MPT_t low_twosites_hamil;
+	torch::ScalarType full_type;
+	bool reduced;
+
+  public:
+	dmrg_precision_policy(const MPO_t &_hamil, const MPT_t &_twosites_hamil, MPS_t &state, env_t &Env,
+	                      const dmrg_options &options)
+	    : full_hamil(_hamil), full_twosites_hamil(_twosites_hamil), low_hamil(), low_twosites_hamil(),
+	      full_type(c10::typeMetaToScalarType(state[0].options().dtype())), reduced(false)
+	{
+		auto low_type = reduced_precision(full_type);
+		reduced = options.mixed_precision and low_type != full_type;
+		if (reduced)
+		{
+			low_hamil = full_hamil.to(low_type);
+			low_twosites_hamil = full_twosites_hamil.to(low_type);
+			state.to_(low_type);
+			Env.to_(low_type);
+		}
+	}
+	bool is_reduced() const { return reduced; }
+	torch::ScalarType full_precision() const { return full_type; }
+	const MPO_t &hamil() const { return reduced ? low_hamil : full_hamil; }
+	const MPT_t &twosites_hamil() const { return reduced ? low_twosites_hamil : full_twosites_hamil; }
+	void promote(MPS_t &state, env_t &Env)
+	{
+		state.to_(full_type);
+		Env.to_(full_type);
+		low_hamil = MPO_t();
+		low_twosites_hamil = MPT_t();
+		reduced = false;
+	}
+};
+
+/**
+ * @brief dmrg_precision_policy of the sparse MPO, which has no two sites hamiltonian.
+ */
+template <>
+class dmrg_precision_policy<sparse_MPO>
+{
+	const sparse_MPO &full_hamil;
+	sparse_MPO low_hamil;
+	torch::ScalarType full_type;
+	bool reduced;
+
+  public:
+	dmrg_precision_policy(const sparse_MPO &_hamil, MPS &state, env_holder &Env, const dmrg_options &options)
+	    : full_hamil(_hamil), low_hamil(), full_type(c10::typeMetaToScalarType(state[0].options().dtype())),
+	      reduced(false)
+	{
+		auto low_type = reduced_precision(full_type);
+		reduced = options.mixed_precision and low_type != full_type;
+		if (reduced)
+		{
+			low_hamil = full_hamil.to(low_type);
+			state.to_(low_type);
+			Env.to_(low_type);
+		}
+	}
+	bool is_reduced() const { return reduced; }
+	torch::ScalarType full_precision() const { return full_type; }
+	const sparse_MPO &hamil() const { return reduced ? low_hamil : full_hamil; }
+	void promote(MPS &state, env_holder &Env)
+	{
+		state.to_(full_type);
+		Env.to_(full_type);
+		low_hamil = sparse_MPO();
+		reduced = false;
+	}
+};
+
 btensor dmrg(bMPO &hamiltonian, bMPS &in_out_state, const dmrg_options &options, dmrg_logger &logger)
 {
 	dmrg_gradient_guard guard(hamiltonian, in_out_state,
@@ -106,16 +294,165 @@ torch::Tensor dmrg(MPO &hamiltonian, MPS &in_out_state, const dmrg_options &opti
 	return details::dmrg_impl(hamiltonian, TwositesH, in_out_state, options, Env, logger);
 }
 
+/**
+ * @brief truncated svd of the two sites wavefunction, the block tensors can use the randomized svd on large blocks.
+ */
+template <class Tensor>
+auto truncated_svd(const Tensor &theta, const dmrg_options &options)
+{
+	if constexpr (std::is_same_v<Tensor, btensor>)
+		return quantit::svd(theta, 2, options.cutoff, options.minimum_bond, options.maximum_bond, 2,
+		                    randomized_svd_options(options.randomized_svd_fraction));
+	else
+		return quantit::svd(theta, 2, options.cutoff, options.minimum_bond, options.maximum_bond);
+}
+
+/**
+ * @brief Infinite DMRG growth of a finite chain, used as a warm start for dmrg.
+ *
+ * The chain is grown from its edges inward: each step inserts two sites (positions l and r of the final chain) at the
+ * centre of the current chain, between the left-orthonormal sites [0,l) and the right-orthonormal sites (r,L), and
+ * optimizes the two sites state of the inserted pair. The MPO tensors of the inserted sites are glued together, which
+ * assumes a bond dimension of the MPO that is uniform in the bulk. Each step targets the conserved quantity of the
+ * sites present in the chain, taken from a product state in the sector of qnum, such that the last step targets qnum.
+ * Return the grown state, with its orthogonality center at the last inserted pair, and its environments.
+ */
+std::tuple<bMPS, benv_holder> idmrg_growth(const bMPO &hamiltonian, any_quantity_cref qnum,
+                                           const dmrg_options &options)
+{
+	constexpr size_t growth_iterations = 10; // lanczos steps per inserted pair.
+	const auto length = hamiltonian.size();
+	if (length < 2)
+		throw std::invalid_argument("infinite dmrg growth requires at least two sites");
+	// a product state in the target sector: its physical conserved quantities are the targets of the growth steps.
+	auto product_state = random_bMPS(1, hamiltonian, qnum);
+	std::vector<any_quantity> site_qnum;
+	site_qnum.reserve(length);
+	for (const auto &site : product_state)
+	{
+		any_quantity_cref sel = site.selection_rule;
+		site_qnum.push_back(sel * site.section_conserved_qtt(0, 0).inverse() *
+		                    site.section_conserved_qtt(2, 0).inverse());
+	}
+	const auto index_shape = [](const btensor &tens, int64_t dim)
+	{
+		std::vector<int64_t> sel(tens.dim(), 0);
+		sel[dim] = -1;
+		auto out = shape_from(tens, sel);
+		out.neutral_selection_rule_();
+		return out;
+	};
+
+	std::vector<btensor> state(length);
+	benv_holder Env;
+	Env.env = bMPT(length + 2);
+	std::tie(Env[-1], Env[length]) = trivial_edges(hamiltonian, product_state);
+	btensor left_bond = index_shape(product_state.front(), 0);
+	btensor right_bond = index_shape(product_state.back(), 2);
+	size_t l = 0;
+	size_t r = length - 1;
+	while (true)
+	{
+		// A single site left to insert is optimized along with its already grown right neighbour.
+		const bool single = l == r;
+		const size_t right_site = single ? l + 1 : r;
+		if (single)
+			right_bond = right_site + 1 == length ? index_shape(product_state.back(), 2)
+			                                      : index_shape(state[right_site + 1], 0).inverse_cvals();
+		const auto &Lenv = Env[static_cast<int64_t>(l) - 1];
+		const auto &Renv = Env[right_site + 1];
+		auto sel_rule = single ? site_qnum[l] : site_qnum[l] * site_qnum[r];
+		auto theta = rand_like(shape_from(left_bond, index_shape(product_state[l], 1),
+		                                  index_shape(product_state[right_site], 1), right_bond)
+		                           .set_selection_rule_(sel_rule),
+		                       product_state[0].options());
+		theta /= sqrt((theta * theta.conj()).sum());
+		auto twosites_hamil =
+		    tensordot(hamiltonian[l], hamiltonian[right_site], {2}, {0}).permute({0, 1, 3, 4, 2, 5});
+		btensor E = quantit::full({}, sel_rule.neutral(), 100000.0, theta.options());
+		for (size_t it = 0; it < growth_iterations; ++it)
+		{
+			btensor E_update;
+			std::tie(E_update, theta) = two_sites_update(theta, twosites_hamil, Lenv, Renv);
+			swap(E, E_update);
+			if (!((((E - E_update) / E).abs() > options.convergence_criterion)).item().toBool())
+				break;
+		}
+		auto [u, d, v] = truncated_svd(theta, options);
+		d /= sqrt(sum(d.pow(2)));
+		state[l] = u;
+		Env[l] = compute_left_env(hamiltonian[l], state[l], Lenv);
+		if (right_site == l + 1)
+		{
+			state[right_site] = (v.mul_(d).conj()).permute({2, 0, 1});
+			return std::make_tuple(bMPS(std::move(state), right_site), std::move(Env));
+		}
+		state[r] = v.conj().permute({2, 0, 1});
+		Env[r] = compute_right_env(hamiltonian[r], state[r], Renv);
+		left_bond = index_shape(state[l], 2).inverse_cvals();
+		right_bond = index_shape(state[r], 0).inverse_cvals();
+		++l;
+		--r;
+	}
+}
+
 std::tuple<btensor, bMPS> dmrg(bMPO &hamiltonian, any_quantity_cref qnum, const dmrg_options &options,
                                dmrg_logger &logger)
 {
 	auto length = hamiltonian.size();
+	if (options.idmrg_warm_start)
+	{
+		auto [out_mps, Env] = idmrg_growth(hamiltonian, qnum, options);
+		btensor E0;
+		{
+			dmrg_gradient_guard guard(hamiltonian, out_mps, options);
+			auto TwositesH = compute_2sitesHamil(hamiltonian);
+			E0 = details::dmrg_impl(hamiltonian, TwositesH, out_mps, options, Env, logger);
+		}
+		return std::make_tuple(E0, out_mps);
+	}
 	auto out_mps = random_MPS(options.minimum_bond, hamiltonian, qnum);
 	// size_t counter=0;
 	// for(auto&a:out_mps){fmt::print("====== ===pos {}===========\n{}",counter++,a);}
 	auto E0 = dmrg(hamiltonian, out_mps, options, logger);
 	return std::make_tuple(E0, out_mps);
 }
+std::tuple<btensor, bMPS> dmrg_resume(const std::filesystem::path &path, const dmrg_options &options,
+                                      dmrg_logger &logger)
+{
+	auto content = load_checkpoint(path);
+	if (content.kind != "dmrg" or content.metadata.size() != 4)
+		throw std::invalid_argument(fmt::format("{} isn't a dmrg checkpoint", path.string()));
+	const auto iteration = static_cast<size_t>(content.metadata[0]);
+	const auto oc = static_cast<size_t>(content.metadata[1]);
+	const auto final_oc = static_cast<size_t>(content.metadata[2]);
+	const auto length = static_cast<size_t>(content.metadata[3]);
+	auto &tensors = content.tensors;
+	if (length < 2 or oc >= length or final_oc >= length or tensors.size() != 3 * length + 3)
+		throw std::runtime_error(fmt::format("corrupted dmrg checkpoint {}", path.string()));
+	// layout: hamiltonian, state, environments and energy.
+	auto first = std::make_move_iterator(tensors.begin());
+	bMPO hamiltonian(std::vector<btensor>(first, first + length));
+	bMPS state(std::vector<btensor>(first + length, first + 2 * length), oc);
+	benv_holder Env;
+	Env.env = bMPT(std::vector<btensor>(first + 2 * length, first + 3 * length + 2));
+	btensor E0 = std::move(tensors.back());
+	// a checkpoint of the single precision warm-up continues in the precision of the hamiltonian, the warm-up isn't run
+	// again.
+	auto type = c10::typeMetaToScalarType(hamiltonian[0].options().dtype());
+	state.to_(type);
+	Env.to_(type);
+	auto resume_options = options;
+	resume_options.mixed_precision = false;
+	{
+		dmrg_gradient_guard guard(hamiltonian, state, resume_options);
+		auto TwositesH = compute_2sitesHamil(hamiltonian);
+		E0 = details::dmrg_impl(hamiltonian, TwositesH, state, resume_options, Env, logger, iteration, std::move(E0));
+	}
+	if (size_t(state.orthogonality_center) != final_oc)
+		state.move_oc(final_oc);
+	return std::make_tuple(E0, state);
+}
 std::tuple<torch::Tensor, MPS> dmrg(MPO &hamiltonian, const dmrg_options &options, dmrg_logger &logger)
 {
 	auto length = hamiltonian.size();
@@ -141,6 +478,19 @@ auto sweep(MPS_t &state, T update, int step, size_t Nstep, size_t right_edge, si
 	return std::make_tuple(E0, step);
 }
 
+/**
+ * @brief replace the tensors of the sites bond and bond+1, a bMPS keeps the singular values of the bond.
+ */
+void assign_bond(MPS &state, size_t bond, torch::Tensor left, torch::Tensor right, const torch::Tensor &)
+{
+	state[bond] = std::move(left);
+	state[bond + 1] = std::move(right);
+}
+void assign_bond(bMPS &state, size_t bond, btensor left, btensor right, const btensor &values)
+{
+	state.assign_bond(bond, std::move(left), std::move(right), values);
+}
+
 template <class MPO_t>
 struct dmrg_2sites_update
 {
@@ -164,40 +514,45 @@ struct dmrg_2sites_update
 	{
 		bool forward = step == 1;
 		tensor_t E0;
+		const MPS_t &const_state = state; // reading through the const interface keeps the spectra of a bMPS.
 		const auto unsqueezing_shape = [&]()
 		{
 			if constexpr (std::is_same_v<tensor_t, btensor>)
 			{
-				auto p = btensor({{{1, state[0].selection_rule->neutral()}}}, state[0].selection_rule->neutral(),
-				                 state[0].options());
+				auto p = btensor({{{1, const_state[0].selection_rule->neutral()}}},
+				                 const_state[0].selection_rule->neutral(), const_state[0].options());
 				return shape_from(p, p);
 			}
 			else
 			{
 				torch_shape x;
 				x._sizes = {1, 1};
-				x.opt = state[0].options();
+				x.opt = const_state[0].options();
 				return x;
 			}
 		}();
 		// MPO_t tmpMPO(hamil.begin() + oc, hamil.begin() + oc + 2);
 		// MPS_t tmpstate(state.begin() + oc, state.begin() + oc + 2);
-		auto local_state = tensordot(state[oc], state[oc + 1], {2}, {0});
-		std::tie(E0, local_state) = two_sites_update(local_state, twosite_hamil[oc], Env[oc - 1], Env[oc + 2]);
-		auto [u, d, v] = quantit::svd(local_state, 2, options.cutoff, options.minimum_bond, options.maximum_bond);
+		auto local_state = tensordot(const_state[oc], const_state[oc + 1], {2}, {0});
+		if (Env.references.empty())
+			std::tie(E0, local_state) = two_sites_update(local_state, twosite_hamil[oc], Env[oc - 1], Env[oc + 2]);
+		else
+			std::tie(E0, local_state) = two_sites_update(local_state, twosite_hamil[oc], Env[oc - 1], Env[oc + 2],
+			                                             Env.local_references(oc), Env.overlap_weight);
+		auto [u, d, v] = truncated_svd(local_state, options);
 		d /= sqrt(sum(d.pow(2)));
 		if (forward)
 		{
-			state[oc] = u;
-			state[oc + 1] = (v.mul_(d).conj()).permute({2, 0, 1});
-			Env[oc] = compute_left_env(hamil[oc], state[oc], Env[oc - 1]);
+			assign_bond(state, oc, u, (v.mul_(d).conj()).permute({2, 0, 1}), d);
+			Env[oc] = compute_left_env(hamil[oc], const_state[oc], Env[oc - 1]);
+			Env.update_left_overlaps(oc, state);
 		}
 		else
 		{
 			auto d_r = d.reshape_as(shape_from(unsqueezing_shape, d));
-			state[oc] = u.mul_(d);
-			state[oc + 1] = (v.conj()).permute({2, 0, 1});
-			Env[oc + 1] = compute_right_env(hamil[oc + 1], state[oc + 1], Env[oc + 2]);
+			assign_bond(state, oc, u.mul_(d), (v.conj()).permute({2, 0, 1}), d);
+			Env[oc + 1] = compute_right_env(hamil[oc + 1], const_state[oc + 1], Env[oc + 2]);
+			Env.update_right_overlaps(oc + 1, state);
 		}
 		// fmt::print("full norm: \n{}\n",contract(sta6te,state));
 		// fmt::print("full E: \n{}\n",contract(state,state,hamil));
@@ -205,6 +560,271 @@ struct dmrg_2sites_update
 		return E0;
 	}
 };
+/**
+ * @brief stopping criterion of the sweeps: the energy change delta is compared to the convergence criterion, unless a
+ * variance criterion is set. The variance costs about as much as a sweep, it is computed only in that case.
+ */
+template <class Tens, class MPO_t, class MPS_t>
+bool sweeps_converged(const Tens &delta, const Tens &E, const MPO_t &hamiltonian, const MPS_t &state,
+                      const dmrg_options &options)
+{
+	// the comparisons are written such that a nan stops the sweeps (nan compare false with everything).
+	if (options.variance_criterion > 0)
+		return !(((energy_variance(hamiltonian, state) / (E * E)).abs() > options.variance_criterion)).item().toBool();
+	return !((delta > options.convergence_criterion)).item().toBool();
+}
+/**
+ * @brief Writes the checkpoints of the block tensor dmrg in a background thread, following the policy of the options.
+ *
+ * The snapshot is a copy of the networks taken between two sweeps. The copies share their blocks with the networks of
+ * the sweeps, which never modify a block in place: the updates replace the tensors of the sites and the environments.
+ * The snapshot is therefore consistent without copying any data, and the sweeps go on while it is written. A checkpoint
+ * that falls due while the previous one is still being written is skipped, the sweeps never wait on the file system.
+ *
+ * Content of the file: kind "dmrg", metadata (next iteration, orthogonality center, final orthogonality center,
+ * length), tensors: the hamiltonian, the state, the environments and the energy of the last sweep.
+ */
+class dmrg_checkpointer
+{
+	using clock = std::chrono::steady_clock;
+	const dmrg_options &options;
+	bool enabled;
+	size_t sweeps = 0;
+	clock::time_point last;
+	std::future<void> pending;
+
+	bool due()
+	{
+		++sweeps;
+		auto elapsed = std::chrono::duration<double>(clock::now() - last).count();
+		return (options.checkpoint_sweeps > 0 and sweeps >= options.checkpoint_sweeps) or
+		       (options.checkpoint_seconds > 0 and elapsed >= options.checkpoint_seconds);
+	}
+
+  public:
+	/**
+	 * @param resumable false when the sweeps depend on more than what is stored, such as the references of the excited
+	 * states. No checkpoint is written in that case.
+	 */
+	dmrg_checkpointer(const dmrg_options &_options, bool resumable)
+	    : options(_options),
+	      enabled(resumable and not options.checkpoint_path.empty() and
+	              (options.checkpoint_sweeps > 0 or options.checkpoint_seconds > 0)),
+	      last(clock::now())
+	{
+	}
+	void after_sweep(size_t iteration, const btensor &E, const bMPO &hamiltonian, const bMPS &state,
+	                 const benv_holder &Env, size_t final_oc)
+	{
+		if (not enabled or not due())
+			return;
+		if (pending.valid())
+		{
+			if (pending.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+				return;
+			pending.get(); // rethrow the errors of the previous write.
+		}
+		auto oc = size_t(state.orthogonality_center);
+		checkpoint snapshot{"dmrg",
+		                    {static_cast<int64_t>(iteration + 1), static_cast<int64_t>(oc),
+		                     static_cast<int64_t>(final_oc), static_cast<int64_t>(state.size())},
+		                    {}};
+		snapshot.tensors.reserve(2 * state.size() + Env.env.size() + 1);
+		snapshot.tensors.insert(snapshot.tensors.end(), hamiltonian.begin(), hamiltonian.end());
+		snapshot.tensors.insert(snapshot.tensors.end(), state.begin(), state.end());
+		snapshot.tensors.insert(snapshot.tensors.end(), Env.env.begin(), Env.env.end());
+		snapshot.tensors.push_back(E);
+		pending = std::async(std::launch::async, [path = options.checkpoint_path, snapshot = std::move(snapshot)]()
+		                     { save_checkpoint(path, snapshot); });
+		sweeps = 0;
+		last = clock::now();
+	}
+	/**
+	 * @brief wait for the checkpoint being written, if any.
+	 */
+	void finish()
+	{
+		if (pending.valid())
+			pending.get();
+	}
+};
+
+/**
+ * @brief Out-of-core storage of the environments of the block tensor dmrg, enabled by options.environment_path.
+ *
+ * Only the environments used by the next options.environment_window updates are kept in memory. Those updates are
+ * found by replaying the sweep from the current position, reversing at the edges of the chain like sweep does, such
+ * that the environments needed after a change of direction are already there. The other environments are written to
+ * a file in a background thread, in the checkpoint format, and replaced by a memory mapped view of the file once
+ * written: an environment that wasn't modified since it was read isn't written again. The environments about to be
+ * used are read back in memory by a background thread. A view of a file is an ordinary tensor, every other use of the
+ * environments works without loading them all at once.
+ *
+ * The files are in a subdirectory of options.environment_path created for the run, removed along with the files at the
+ * end. Only the environments of the hamiltonian are stored, the overlap environments of the excited states stay in
+ * memory.
+ */
+class env_storage
+{
+	enum class location : char
+	{
+		memory,
+		disk
+	};
+	std::filesystem::path directory;
+	size_t window;
+	size_t last_center;
+	bool enabled;
+	std::vector<location> where;
+	std::vector<char> dirty;  // the file of the environment is out of date.
+	std::vector<char> wanted; // the environment is used by the upcoming updates.
+	// the view of the file for an environment in memory, the tensor read from the file for an environment on disk.
+	std::vector<std::future<btensor>> pending;
+
+	std::filesystem::path file(size_t slot) const { return directory / fmt::format("environment_{}.qtt", slot); }
+	static btensor read(const std::filesystem::path &path, bool memory_map)
+	{
+		return std::move(load_checkpoint(path, memory_map).tensors.front());
+	}
+	void store(const bMPT &env, size_t slot)
+	{
+		if (dirty[slot])
+			pending[slot] = std::async(std::launch::async,
+			                           [path = file(slot), tensor = env[slot]]()
+			                           {
+				                           save_checkpoint(path, checkpoint{"environment", {}, {tensor}});
+				                           return read(path, true);
+			                           });
+		else
+			pending[slot] = std::async(std::launch::async, [path = file(slot)]() { return read(path, true); });
+	}
+	void fetch(size_t slot)
+	{
+		pending[slot] = std::async(std::launch::async, [path = file(slot)]() { return read(path, false); });
+	}
+	// finish the pending work on the environment. A view of its file replaces it only if it is still unwanted.
+	void resolve(bMPT &env, size_t slot)
+	{
+		if (not pending[slot].valid())
+			return;
+		auto tensor = pending[slot].get();
+		if (where[slot] == location::disk)
+		{
+			env[slot] = std::move(tensor);
+			where[slot] = location::memory;
+			return;
+		}
+		dirty[slot] = false; // the environment wasn't modified since it was written.
+		if (not wanted[slot])
+		{
+			env[slot] = std::move(tensor);
+			where[slot] = location::disk;
+		}
+	}
+
+  public:
+	env_storage(const dmrg_options &options, size_t length)
+	    : directory(options.environment_path), window(options.environment_window), last_center(length - 2),
+	      enabled(not options.environment_path.empty() and length > 2), where(length + 2, location::memory),
+	      dirty(length + 2, true), wanted(length + 2, true), pending(length + 2)
+	{
+		if (not enabled)
+			return;
+		// every run has its own subdirectory, such that concurrent runs can share the environment path.
+		std::filesystem::create_directories(directory);
+		// create_directory fails on an existing directory, the first name it creates belongs to this run.
+		std::mt19937_64 generator((std::random_device())());
+		auto run_directory = directory / fmt::format("run_{:016x}", generator());
+		while (not std::filesystem::create_directory(run_directory))
+			run_directory = directory / fmt::format("run_{:016x}", generator());
+		directory = std::move(run_directory);
+	}
+	env_storage(const env_storage &) = delete;
+	env_storage &operator=(const env_storage &) = delete;
+	~env_storage()
+	{
+		if (not enabled)
+			return;
+		for (auto &work : pending)
+			if (work.valid())
+				work.wait();
+		// the views keep the content of the removed files alive.
+		std::error_code err;
+		std::filesystem::remove_all(directory, err);
+	}
+	/**
+	 * @brief make sure the environments used by the update at oc are in memory.
+	 */
+	void before_update(bMPT &env, size_t oc)
+	{
+		if (not enabled)
+			return;
+		for (size_t slot = oc; slot < oc + 4; ++slot)
+		{
+			resolve(env, slot);
+			where[slot] = location::memory;
+		}
+		dirty[oc + 1] = dirty[oc + 2] = true; // Env[oc] or Env[oc+1] is replaced by the update.
+	}
+	/**
+	 * @brief fetch the environments of the upcoming updates and store the others, after the update that moved the
+	 * center to oc in the direction step.
+	 */
+	void after_update(bMPT &env, size_t oc, int step)
+	{
+		if (not enabled)
+			return;
+		std::fill(wanted.begin(), wanted.end(), false);
+		wanted.front() = wanted.back() = true; // the edges are small, they stay in memory.
+		std::vector<size_t> upcoming;          // in the order of use.
+		size_t center = oc;
+		for (size_t k = 0; k <= window; ++k)
+		{
+			if (center == 0)
+				step = 1;
+			else if (center == last_center)
+				step = -1;
+			for (size_t slot = center; slot < center + 4; ++slot)
+				if (not wanted[slot])
+				{
+					wanted[slot] = true;
+					upcoming.push_back(slot);
+				}
+			center += step;
+		}
+		for (size_t slot = 0; slot < pending.size(); ++slot)
+			if (pending[slot].valid() and
+			    pending[slot].wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+				resolve(env, slot);
+		for (auto slot : upcoming)
+			if (where[slot] == location::disk and not pending[slot].valid())
+				fetch(slot);
+		for (size_t slot = 1; slot + 1 < pending.size(); ++slot)
+			if (not wanted[slot] and where[slot] == location::memory and not pending[slot].valid())
+				store(env, slot);
+	}
+	/**
+	 * @brief convert the stored environments to type, one at a time. The environments in memory are left to the
+	 * caller.
+	 */
+	void to_(bMPT &env, torch::ScalarType type)
+	{
+		if (not enabled)
+			return;
+		for (size_t slot = 0; slot < pending.size(); ++slot)
+		{
+			resolve(env, slot);
+			if (where[slot] == location::disk)
+			{
+				save_checkpoint(file(slot), checkpoint{"environment", {}, {env[slot].to(type)}});
+				env[slot] = read(file(slot), true);
+			}
+			else
+				dirty[slot] = true;
+		}
+	}
+};
+
 /**
  * @brief Shared implementation of the differeent interface to dmrg with 2 sites update.
  *
@@ -217,10 +837,12 @@ struct dmrg_2sites_update
  * @return btensor
  */
 btensor details::dmrg_impl(const bMPO &hamiltonian, const bMPT &two_sites_hamil, bMPS &in_out_state,
-                           const dmrg_options &options, benv_holder &Env, dmrg_logger &logger)
+                           const dmrg_options &options, benv_holder &Env, dmrg_logger &logger, size_t first_iteration,
+                           std::optional<btensor> previous_energy)
 {
-	btensor E0 = quantit::full({}, hamiltonian[0].selection_rule->neutral(), 100000.0,
-	                           hamiltonian[0].options().merge_in(torch::kDouble));
+	btensor E0 = previous_energy ? std::move(*previous_energy)
+	                             : quantit::full({}, hamiltonian[0].selection_rule->neutral(), 100000.0,
+	                                             hamiltonian[0].options().merge_in(torch::kDouble));
 	auto sweep_dir = 1;
 	size_t init_pos = in_out_state.orthogonality_center;
 	auto N_step = two_sites_hamil.size() - 1 + (two_sites_hamil.size() == 1);
@@ -234,103 +856,599 @@ btensor details::dmrg_impl(const bMPO &hamiltonian, const bMPT &two_sites_hamil,
 		--init_pos;
 		--oc;
 	}
-	dmrg_2sites_update update(hamiltonian, two_sites_hamil, oc, Env, options);
+	dmrg_precision_policy precision(hamiltonian, two_sites_hamil, in_out_state, Env, options);
+	dmrg_checkpointer checkpointer(options, Env.references.empty());
+	env_storage storage(options, in_out_state.size());
+	auto iteration = first_iteration;
+	logger.init(options);
+	for (iteration = first_iteration; iteration < options.maximum_iterations; ++iteration)
+	{
+		btensor E0_tens;
+		dmrg_2sites_update update(precision.hamil(), precision.twosites_hamil(), oc, Env, options);
+		auto stored_update = [&](bMPS &state, int dir)
+		{
+			storage.before_update(Env.env, oc);
+			auto E = update(state, dir);
+			storage.after_update(Env.env, oc, dir);
+			return E;
+		};
+		std::tie(E0_tens, step) = sweep(in_out_state, stored_update, step, 2 * N_step,
+		                                in_out_state.size() - 2); // sweep from the oc and back to it.
+		logger.it_log_all(iteration, E0_tens, in_out_state);
+		if (E0_tens.anynan()) // the local updates don't check for nan, it propagates to the energy of the sweep.
+			throw std::logic_error("nan found in the energy of the sweep");
+		swap(E0, E0_tens);
+		checkpointer.after_sweep(iteration, E0, hamiltonian, in_out_state, Env, init_pos);
+		auto delta = ((E0 - E0_tens) / E0).abs();
+		if (precision.is_reduced())
+		{
+			// never stop in single precision: once the warm-up has converged enough, finish in full precision.
+			if (!((delta > std::max(options.precision_switch_criterion, options.convergence_criterion)))
+			         .item()
+			         .toBool())
+			{
+				storage.to_(Env.env, precision.full_precision());
+				precision.promote(in_out_state, Env);
+			}
+			continue;
+		}
+		if (sweeps_converged(delta, E0, hamiltonian, in_out_state, options))
+		{
+			// E0 = E0_tens;
+			break;
+		}
+		// E0 = E0_tens;
+	}
+	if (precision.is_reduced()) // ran out of iterations during the warm-up.
+	{
+		storage.to_(Env.env, precision.full_precision());
+		precision.promote(in_out_state, Env);
+	}
+	if (oc != init_pos)
+	{
+		// The oc isn't actually where the orthogonaility center variable says it is in the python binding after
+		// dmrg....
+		if (oc != init_pos - 1 and init_pos != in_out_state.size() - 1)
+			throw std::runtime_error(fmt::format(
+			    "the orthogonality center finished somewhere surprising! final oc: {}. original oc: {}", oc, init_pos));
+	}
+	if (oc != init_pos)
+		in_out_state.move_oc(init_pos);
+	checkpointer.finish();
+
+	logger.end_log_all(iteration, E0, in_out_state);
+
+	return E0;
+
+	return btensor();
+}
+/**
+ * @brief sweeps of the two sites dmrg on a MPS, shared by the dense and the sparse MPO.
+ *
+ * make_update(oc) builds the local update of a sweep with the hamiltonian currently selected by the precision policy.
+ * oc is the orthogonality center of in_out_state, which only the friends of MPS can hand over. variance_hamil is only
+ * used by the variance convergence criterion.
+ */
+template <class Hamil_t, class Update_factory>
+torch::Tensor dmrg_sweeps(dmrg_precision_policy<Hamil_t> &precision, Update_factory &&make_update,
+                          const MPO &variance_hamil, MPS &in_out_state, size_t &oc, const dmrg_options &options,
+                          env_holder &Env, dmrg_logger &logger)
+{
+	// TODO check for non-zero input.
+	auto norm = contract(in_out_state, in_out_state).item().toDouble();
+	if (norm == 0 or norm < 1e-15)
+		throw std::invalid_argument("initial state has zero norm!"); // this test is less than ideal.
+	torch::Tensor E0 = torch::full({}, 100000.0, in_out_state[0].options().merge_in(torch::kDouble));
+	size_t init_pos = oc;
+	auto N_bonds = in_out_state.size() - 1;
+	auto N_step = N_bonds - 1 + (N_bonds == 1);
+	torch::Tensor E0_update;
+	int step = (oc == 0) ? 1 : -1;
+	if (N_bonds == 1)
+		step = 0;
+	// fmt::print("step {}\n",step);
+	if (oc == in_out_state.size() - 1)
+	{
+		--init_pos;
+		--oc;
+	}
+	auto iteration = 0u;
+	logger.init(options);
+	for (iteration = 0u; iteration < options.maximum_iterations; ++iteration)
+	{
+		// fmt::print("\nSweep\n\n");
+		auto update = make_update(oc);
+		std::tie(E0_update, step) =
+		    sweep(in_out_state, update, step, 2 * N_step, in_out_state.size() - 2); // sweep from the oc and back to it.
+		logger.it_log_all(iteration, E0_update, in_out_state);
+		if (E0_update.isnan().any().item().to<bool>()) // the local updates don't check for nan, it propagates to the
+		                                               // energy of the sweep.
+			throw std::logic_error("nan found in the energy of the sweep");
+		std::swap(E0, E0_update);
+		// print("{:-^40}\n", "");
+		auto delta = abs(E0_update - E0);
+		if (precision.is_reduced())
+		{
+			// never stop in single precision: once the warm-up has converged enough, finish in full precision.
+			if (!((delta > std::max(options.precision_switch_criterion, options.convergence_criterion)))
+			         .item()
+			         .to<bool>())
+				precision.promote(in_out_state, Env);
+			continue;
+		}
+		if (sweeps_converged(delta, E0, variance_hamil, in_out_state, options))
+		{
+			break;
+		}
+	}
+	if (precision.is_reduced()) // ran out of iterations during the warm-up.
+		precision.promote(in_out_state, Env);
+	if (oc != init_pos)
+	{
+		if (oc != init_pos - 1 and init_pos != in_out_state.size() - 1)
+			throw std::runtime_error(fmt::format(
+			    "the orthogonality center finished somewhere surprising! final oc: {}. original oc: {}", oc, init_pos));
+	}
+	oc += (oc == 0); // The oc never really finishes at 0 with the current algo.
+	// The leftward sweep finishes with the oc at 1, but set the oc at 0,
+	// such the site 0 and 1 are updated together once by the next rightward sweep.
+	// this trickery is necessary to get this optimization without writing special code in the sweeper.
+	if (oc != init_pos) // then we actually move it back to its origin location.
+		in_out_state.move_oc(init_pos);
+
+	logger.end_log_all(iteration, E0, in_out_state);
+
+	return E0;
+}
+/**
+ * The actual implementation.
+ */
+torch::Tensor details::dmrg_impl(const MPO &hamiltonian, const MPT &twosites_hamil, MPS &in_out_state,
+                                 const dmrg_options &options, env_holder &Env, dmrg_logger &logger)
+{
+	dmrg_precision_policy precision(hamiltonian, twosites_hamil, in_out_state, Env, options);
+	return dmrg_sweeps(
+	    precision,
+	    [&](size_t &oc) { return dmrg_2sites_update(precision.hamil(), precision.twosites_hamil(), oc, Env, options); },
+	    hamiltonian, in_out_state, in_out_state.oc, options, Env, logger);
+}
+
+/**
+ * @brief two sites update of dmrg with a sparse MPO. The effective hamiltonian is applied term by term.
+ */
+struct sparse_dmrg_2sites_update
+{
+	const sparse_MPO &hamil;
+	size_t &oc;
+	env_holder &Env;
+	const dmrg_options &options;
+
+	sparse_dmrg_2sites_update(const sparse_MPO &_hamil, size_t &_oc, env_holder &_Env, const dmrg_options &_options)
+	    : hamil(_hamil), oc(_oc), Env(_Env), options(_options)
+	{
+	}
+	torch::Tensor operator()(MPS &state, int step)
+	{
+		bool forward = step == 1;
+		torch::Tensor E0;
+		auto local_state = tensordot(state[oc], state[oc + 1], {2}, {0});
+		std::tie(E0, local_state) = two_sites_update(local_state, hamil[oc], hamil[oc + 1], Env[oc - 1], Env[oc + 2]);
+		auto [u, d, v] = truncated_svd(local_state, options);
+		d /= sqrt(sum(d.pow(2)));
+		if (forward)
+		{
+			state[oc] = u;
+			state[oc + 1] = (v.mul_(d).conj()).permute({2, 0, 1});
+			Env[oc] = compute_left_env(hamil[oc], state[oc], Env[oc - 1]);
+		}
+		else
+		{
+			state[oc] = u.mul_(d);
+			state[oc + 1] = (v.conj()).permute({2, 0, 1});
+			Env[oc + 1] = compute_right_env(hamil[oc + 1], state[oc + 1], Env[oc + 2]);
+		}
+		oc += step;
+		return E0;
+	}
+};
+
+torch::Tensor details::dmrg_impl(const sparse_MPO &hamiltonian, MPS &in_out_state, const dmrg_options &options,
+                                 env_holder &Env, dmrg_logger &logger)
+{
+	dmrg_precision_policy<sparse_MPO> precision(hamiltonian, in_out_state, Env, options);
+	// the variance is computed with the dense MPO, only built when requested.
+	MPO variance_hamil = options.variance_criterion > 0 ? hamiltonian.to_MPO() : MPO();
+	return dmrg_sweeps(
+	    precision, [&](size_t &oc) { return sparse_dmrg_2sites_update(precision.hamil(), oc, Env, options); },
+	    variance_hamil, in_out_state, in_out_state.oc, options, Env, logger);
+}
+
+torch::Tensor dmrg(const sparse_MPO &hamiltonian, MPS &in_out_state, const dmrg_options &options, dmrg_logger &logger)
+{
+	if (hamiltonian.size() != in_out_state.size())
+		throw std::invalid_argument(fmt::format("the MPO has {} sites but the state has {}", hamiltonian.size(),
+		                                        in_out_state.size()));
+	if (hamiltonian.size() < 2)
+		throw std::invalid_argument("dmrg with a sparse MPO requires at least two sites");
+	torch::AutoGradMode grad_guard(options.state_gradient);
+	const auto length = hamiltonian.size();
+	env_holder Env;
+	Env.env = MPT(length + 2);
+	auto opt = in_out_state[0].options();
+	Env[-1] = torch::ones({in_out_state.front().sizes()[0], hamiltonian[0].left_dim, in_out_state.front().sizes()[0]},
+	                      opt);
+	Env[length] = torch::ones(
+	    {in_out_state.back().sizes()[2], hamiltonian[length - 1].right_dim, in_out_state.back().sizes()[2]}, opt);
+	for (size_t i = 0; i < in_out_state.orthogonality_center; ++i)
+		Env[i] = compute_left_env(hamiltonian[i], in_out_state[i], Env[i - 1]);
+	for (size_t i = length - 1; i > in_out_state.orthogonality_center; --i)
+		Env[i] = compute_right_env(hamiltonian[i], in_out_state[i], Env[i + 1]);
+	return details::dmrg_impl(hamiltonian, in_out_state, options, Env, logger);
+}
+
+/**
+ * @brief run job(i) for every i in [0,count), each call in its own thread.
+ *
+ * Autograd and inference mode are thread local in torch, the workers inherit the mode of the calling thread.
+ * Exceptions thrown by a job are rethrown in the calling thread once every job has finished.
+ */
+template <class F>
+void concurrent_for(size_t count, F &&job)
+{
+	const bool grad_mode = torch::GradMode::is_enabled();
+	const bool inference_mode = c10::InferenceMode::is_enabled();
+	std::vector<std::future<void>> futures;
+	futures.reserve(count);
+	for (size_t i = 0; i < count; ++i)
+		futures.emplace_back(std::async(std::launch::async,
+		                                [&job, i, grad_mode, inference_mode]()
+		                                {
+			                                c10::InferenceMode inference_guard(inference_mode);
+			                                torch::AutoGradMode grad_guard(grad_mode);
+			                                job(i);
+		                                }));
+	for (auto &future : futures)
+		future.get();
+}
+
+/**
+ * @brief inverse of the singular values of a bond, regularized such that vanishing values don't blow up.
+ */
+template <class Tensor>
+Tensor regularized_inverse(const Tensor &lambda, double eps)
+{
+	return lambda.div(lambda.pow(2).add(eps * eps));
+}
+
+/**
+ * @brief contiguous segment of the chain, optimized by a single thread in the real-space parallel dmrg.
+ *
+ * The environment holder has the same layout as the one of the whole chain: Env[-1] is the left boundary environment
+ * and Env[size()] is the right boundary environment, both are computed by the boundary updates with the neighbouring
+ * segments.
+ */
+template <class MPO_t>
+struct dmrg_segment
+{
+	using MPT_t = typename dependant_tensor_network<MPO_t>::MPT_type;
+	using MPS_t = typename dependant_tensor_network<MPO_t>::MPS_type;
+	using env_t = typename dependant_tensor_network<MPO_t>::env_type;
+	MPO_t hamil;
+	MPT_t twosites_hamil;
+	MPS_t state;
+	env_t Env;
+	size_t oc = 0;
+
+	size_t size() const { return state.size(); }
+	/**
+	 * @brief move the center from one edge of the segment to the other with the two sites update.
+	 *
+	 * @param step 1 to move from the left edge to the right edge, -1 for the other way around.
+	 */
+	void half_sweep(int step, const dmrg_options &options)
+	{
+		oc = (step == 1) ? 0 : size() - 2;
+		dmrg_2sites_update update(hamil, twosites_hamil, oc, Env, options);
+		for (size_t i = 0; i + 1 < size(); ++i)
+			update(state, step);
+	}
+};
+
+/**
+ * @brief two sites update on the bond between two segments.
+ *
+ * The left segment must have its center on its right edge, and the right segment on its left edge. The two sites
+ * wavefunction is rebuilt with the inverse of the singular values of the bond, then optimized and split again. The
+ * singular values and the boundary environments of both segments are updated.
+ *
+ * @param site index on the chain of the last site of the left segment.
+ * @return energy of the update.
+ */
+template <class MPO_t, class Tensor>
+Tensor boundary_update(dmrg_segment<MPO_t> &left, dmrg_segment<MPO_t> &right, Tensor &lambda, const MPO_t &hamil,
+                       const Tensor &twosites_hamil, size_t site, const dmrg_options &options)
+{
+	const int64_t n = left.size();
+	auto theta =
+	    tensordot(left.state[n - 1].mul(regularized_inverse(lambda, options.cutoff)), right.state[0], {2}, {0});
+	const auto &Lenv = left.Env[n - 2];
+	const auto &Renv = right.Env[1];
+	auto [E0, new_theta] = two_sites_update(theta, twosites_hamil, Lenv, Renv);
+	auto [u, d, v] = truncated_svd(new_theta, options);
+	d /= sqrt(sum(d.pow(2)));
+	right.Env[-1] = compute_left_env(hamil[site], u, Lenv);
+	left.Env[n] = compute_right_env(hamil[site + 1], v.conj().permute({2, 0, 1}), Renv);
+	left.state[n - 1] = u.mul(d);
+	right.state[0] = v.mul(d).conj().permute({2, 0, 1});
+	lambda = d;
+	return E0;
+}
+
+/**
+ * @brief glue the segments together: psi = psi_0 lambda_0^-1 psi_1 lambda_1^-1 ... psi_N.
+ *
+ * The resulting MPS is not in canonical form.
+ */
+template <class MPO_t, class Tensor>
+auto assemble_segments(const std::vector<dmrg_segment<MPO_t>> &segments, const std::vector<Tensor> &lambdas,
+                       double eps)
+{
+	std::vector<Tensor> out;
+	for (size_t k = 0; k < segments.size(); ++k)
+	{
+		out.insert(out.end(), segments[k].state.begin(), segments[k].state.end());
+		if (k < lambdas.size())
+			out.back() = out.back().mul(regularized_inverse(lambdas[k], eps));
+	}
+	return out;
+}
+
+/**
+ * @brief Real-space parallel dmrg, from Stoudenmire and White, Phys. Rev. B 87, 155137 (2013).
+ *
+ * The state is written as psi_0 lambda_0^-1 psi_1 ... where the psi_k are the segments, each with its own center, and
+ * the lambda_k are the singular values on the bonds between segments. Each iteration has two halves: in the first the
+ * even segments sweep toward their right edge while the odd segments sweep toward their left edge, concurrently, then
+ * the bonds at the right of the even segments are updated, also concurrently. The second half does the same with the
+ * roles of even and odd segments exchanged. The segments only communicate through the boundary updates.
+ */
+template <class MPO_t, class MPS_t>
+auto parallel_dmrg_impl(const MPO_t &hamiltonian, MPS_t &state, size_t num_segments, const dmrg_options &options,
+                        dmrg_logger &logger)
+{
+	using MPT_t = typename dependant_tensor_network<MPO_t>::MPT_type;
+	using tensor_t = typename dependant_tensor_network<MPO_t>::base_tensor_type;
+	using segment_t = dmrg_segment<MPO_t>;
+	const size_t length = state.size();
+	if (num_segments < 2 or length < 2 * num_segments)
+		throw std::invalid_argument(fmt::format(
+		    "cannot split a chain of {} sites in {} segments of at least two sites", length, num_segments));
+	std::vector<size_t> bounds(num_segments + 1); // first site of each segment, and the end of the chain.
+	for (size_t k = 0; k <= num_segments; ++k)
+		bounds[k] = k * length / num_segments;
+	const size_t init_pos = state.orthogonality_center;
+	state.move_oc(0);
+	auto twosites_hamil = compute_2sitesHamil(hamiltonian);
+	auto Env = generate_env(hamiltonian, state);
+
+	// Move a center across the chain once, keeping the singular values of the bonds between segments. Every segment
+	// but the last is made of the left canonical tensors of the walk, the last one multiplied by the singular values
+	// of the bond: psi_k = A...A lambda_k, in the basis of lambda_k. The next segment starts with the center, in that
+	// same basis, followed by the right canonical tensors of the state. The right boundary environment of a segment is
+	// built with the first tensor of the next segment in right canonical form.
+	std::vector<segment_t> segments(num_segments);
+	std::vector<tensor_t> lambdas(num_segments - 1);
+	auto center = state[0];
+	auto Lenv = Env[-1];
+	for (size_t k = 0; k < num_segments; ++k)
+	{
+		const auto begin = bounds[k];
+		const auto end = bounds[k + 1];
+		const int64_t n = end - begin;
+		const bool last = k + 1 == num_segments;
+		auto &seg = segments[k];
+		seg.hamil = MPO_t(hamiltonian.begin() + begin, hamiltonian.begin() + end);
+		seg.twosites_hamil = MPT_t(twosites_hamil.begin() + begin, twosites_hamil.begin() + end - 1);
+		seg.state = MPS_t(end - begin, last ? size_t(0) : end - begin - 1);
+		seg.Env.env = MPT_t(n + 2);
+		seg.Env[-1] = Lenv;
+		if (last)
+		{
+			seg.state[0] = center;
+			for (int64_t i = 1; i < n; ++i)
+			{
+				seg.state[i] = state[begin + i];
+				seg.Env[i] = Env[begin + i];
+			}
+			seg.Env[n] = Env[end];
+			break;
+		}
+		for (auto i = begin; i < end; ++i)
+		{
+			auto [u, d, v] = quantit::svd(center, 2);
+			Lenv = compute_left_env(hamiltonian[i], u, Lenv);
+			if (i + 1 == end)
+			{
+				seg.state[n - 1] = u.mul(d);
+				lambdas[k] = d;
+				auto right_first = tensordot(v.conj(), state[end], {0}, {0}); // right canonical.
+				seg.Env[n] = compute_right_env(hamiltonian[end], right_first, Env[end + 1]);
+			}
+			else
+			{
+				seg.state[i - begin] = u;
+				seg.Env[i - begin] = Lenv;
+			}
+			center = tensordot(v.mul(d).conj(), state[i + 1], {0}, {0});
+		}
+	}
+	// even segments start with their center on their left edge, odd segments on their right edge.
+	for (size_t k = 0; k < num_segments; ++k)
+	{
+		auto &seg = segments[k];
+		const int64_t n = seg.size();
+		const bool on_left_edge = size_t(seg.state.orthogonality_center) == 0;
+		if (k % 2 == 0 and not on_left_edge)
+		{
+			seg.state.move_oc(0);
+			for (int64_t i = n - 1; i > 0; --i)
+				seg.Env[i] = compute_right_env(seg.hamil[i], seg.state[i], seg.Env[i + 1]);
+		}
+		else if (k % 2 == 1 and on_left_edge)
+		{
+			seg.state.move_oc(n - 1);
+			for (int64_t i = 0; i + 1 < n; ++i)
+				seg.Env[i] = compute_left_env(seg.hamil[i], seg.state[i], seg.Env[i - 1]);
+		}
+	}
+
+	std::vector<tensor_t> boundary_E(num_segments - 1);
+	tensor_t E0;
 	auto iteration = 0u;
 	logger.init(options);
 	for (iteration = 0u; iteration < options.maximum_iterations; ++iteration)
 	{
-		btensor E0_tens;
-		std::tie(E0_tens, step) =
-		    sweep(in_out_state, update, step, 2 * N_step, in_out_state.size() - 2); // sweep from the oc and back to it.
-		logger.it_log_all(iteration, E0_tens, in_out_state);
-		swap(E0, E0_tens);
-		if (!((((E0 - E0_tens) / E0).abs() > options.convergence_criterion))
-		         .item()
-		         .toBool()) // looks weird? it's so it stop on nan (nan
-		                    // compare false with everything).
+		for (size_t parity = 0; parity < 2; ++parity)
 		{
-			// E0 = E0_tens;
-			break;
+			concurrent_for(num_segments, [&](size_t k)
+			               { segments[k].half_sweep((k % 2 == parity) ? 1 : -1, options); });
+			std::vector<size_t> boundaries;
+			for (auto k = parity; k + 1 < num_segments; k += 2)
+				boundaries.push_back(k);
+			concurrent_for(boundaries.size(),
+			               [&](size_t j)
+			               {
+				               auto k = boundaries[j];
+				               auto site = bounds[k + 1] - 1;
+				               boundary_E[k] = boundary_update(segments[k], segments[k + 1], lambdas[k], hamiltonian,
+				                                               twosites_hamil[site], site, options);
+			               });
 		}
-		// E0 = E0_tens;
-	}
-	if (oc != init_pos)
-	{
-		// The oc isn't actually where the orthogonaility center variable says it is in the python binding after
-		// dmrg....
-		if (oc != init_pos - 1 and init_pos != in_out_state.size() - 1)
-			throw std::runtime_error(fmt::format(
-			    "the orthogonality center finished somewhere surprising! final oc: {}. original oc: {}", oc, init_pos));
+		// every bond between segments is updated once per iteration, the one nearest the middle of the chain gives the
+		// energy.
+		auto E0_update = boundary_E[(num_segments - 1) / 2];
+		logger.it_log_all(iteration, E0_update, MPS_t(assemble_segments(segments, lambdas, options.cutoff)));
+		bool converged = iteration > 0 and !((((E0 - E0_update) / E0).abs() > options.convergence_criterion))
+		                                        .item()
+		                                        .toBool(); // stops on nan.
+		E0 = E0_update;
+		if (converged)
+			break;
 	}
-	if (oc != init_pos)
-		in_out_state.move_oc(init_pos);
-
-	logger.end_log_all(iteration, E0, in_out_state);
-
+	MPS_t out(assemble_segments(segments, lambdas, options.cutoff), length - 1);
+	out.move_oc(0); // right canonical form, the norm is entirely on the first site.
+	out[0] /= sqrt(contract(out, out));
+	out.move_oc(init_pos);
+	state = out;
+	logger.end_log_all(iteration, E0, state);
 	return E0;
+}
 
-	return btensor();
+btensor parallel_dmrg(bMPO &hamiltonian, bMPS &in_out_state, size_t num_segments, const dmrg_options &options,
+                      dmrg_logger &logger)
+{
+	if (num_segments == 1)
+		return dmrg(hamiltonian, in_out_state, options, logger);
+	dmrg_gradient_guard guard(hamiltonian, in_out_state, options);
+	return parallel_dmrg_impl(hamiltonian, in_out_state, num_segments, options, logger);
 }
+torch::Tensor parallel_dmrg(MPO &hamiltonian, MPS &in_out_state, size_t num_segments, const dmrg_options &options,
+                            dmrg_logger &logger)
+{
+	if (num_segments == 1)
+		return dmrg(hamiltonian, in_out_state, options, logger);
+	dmrg_gradient_guard guard(hamiltonian, in_out_state, options);
+	return parallel_dmrg_impl(hamiltonian, in_out_state, num_segments, options, logger);
+}
+
 /**
- * The actual implementation.
+ * @brief number of jobs of batch_dmrg to run at once.
+ *
+ * Every job uses torch's intra-op thread pool, we limit the number of concurrent jobs such that the total number of
+ * threads doesn't exceed the hardware's.
  */
-torch::Tensor details::dmrg_impl(const MPO &hamiltonian, const MPT &twosites_hamil, MPS &in_out_state,
-                                 const dmrg_options &options, env_holder &Env, dmrg_logger &logger)
+size_t batch_concurrency(size_t max_concurrent_jobs, size_t num_jobs)
 {
-	// TODO check for non-zero input.
-	auto norm = contract(in_out_state, in_out_state).item().toDouble();
-	if (norm == 0 or norm < 1e-15)
-		throw std::invalid_argument("initial state has zero norm!"); // this test is less than ideal.
-	torch::Tensor E0 = torch::full({}, 100000.0, in_out_state[0].options().merge_in(torch::kDouble));
-	auto sweep_dir = 1;
-	size_t init_pos = in_out_state.orthogonality_center;
-	auto N_step = twosites_hamil.size() - 1 + (twosites_hamil.size() == 1);
-	torch::Tensor E0_update;
-	int step = (in_out_state.orthogonality_center == 0) ? 1 : -1;
-	if (twosites_hamil.size() == 1)
-		step = 0;
-	// fmt::print("step {}\n",step);
-	auto &oc = in_out_state.oc;
-	if (oc == in_out_state.size() - 1)
-	{
-		--init_pos;
-		--oc;
-	}
-	dmrg_2sites_update update(hamiltonian, twosites_hamil, oc, Env, options);
-	auto iteration = 0u;
-	logger.init(options);
-	for (iteration = 0u; iteration < options.maximum_iterations; ++iteration)
+	size_t hardware = std::max(1u, std::thread::hardware_concurrency());
+	size_t intra_op = std::max(1, torch::get_num_threads());
+	size_t out = std::max<size_t>(1, hardware / intra_op);
+	if (max_concurrent_jobs)
+		out = std::min(out, max_concurrent_jobs);
+	return std::min(out, num_jobs);
+}
+
+std::vector<dmrg_job_result> batch_dmrg(const std::vector<bMPO> &hamiltonians, const std::vector<dmrg_job> &jobs,
+                                        size_t max_concurrent_jobs)
+{
+	for (const auto &job : jobs)
+		if (job.hamiltonian >= hamiltonians.size())
+			throw std::invalid_argument(fmt::format("job refers to hamiltonian {}, but only {} were supplied",
+			                                        job.hamiltonian, hamiltonians.size()));
+	// the checkpoints of concurrent jobs would overwrite each other.
+	std::set<std::filesystem::path> checkpoint_paths;
+	for (const auto &job : jobs)
+		if (not job.options.checkpoint_path.empty() and
+		    not checkpoint_paths.insert(std::filesystem::path(job.options.checkpoint_path).lexically_normal()).second)
+			throw std::invalid_argument(
+			    fmt::format("more than one job writes its checkpoints to {}", job.options.checkpoint_path));
+	torch::NoGradGuard no_grad; // the hamiltonians are shared by the jobs, they cannot be part of a graph.
+	// two sites hamiltonians of the shared hamiltonians, computed once.
+	std::vector<bMPT> twosites_hamils(hamiltonians.size());
+	for (size_t i = 0; i < hamiltonians.size(); ++i)
+		if (std::any_of(jobs.begin(), jobs.end(), [i](const dmrg_job &job)
+		                { return job.hamiltonian == i and !job.modifier; }))
+			twosites_hamils[i] = compute_2sitesHamil(hamiltonians[i]);
+	// the edges of the environment only depend on the hamiltonian and the quantum numbers at the ends of the state.
+	// They are computed by the first job that needs them.
+	std::map<std::tuple<size_t, any_quantity>, std::tuple<btensor, btensor>> shared_edges;
+	std::mutex edges_mutex;
+
+	std::vector<dmrg_job_result> results(jobs.size());
+	auto run_job = [&](size_t j)
 	{
-		// fmt::print("\nSweep\n\n");
-		std::tie(E0_update, step) =
-		    sweep(in_out_state, update, step, 2 * N_step, in_out_state.size() - 2); // sweep from the oc and back to it.
-		logger.it_log_all(iteration, E0_update, in_out_state);
-		std::swap(E0, E0_update);
-		// print("{:-^40}\n", "");
-		if (!((abs(E0_update - E0) > options.convergence_criterion))
-		         .item()
-		         .to<bool>()) // looks weird? it's so it stop on nan (nan
-		                      // compare false with everything).
+		const auto &job = jobs[j];
+		auto &result = results[j];
+		bMPO modified_hamil;
+		bMPT modified_twosites;
+		if (job.modifier)
 		{
-			break;
+			modified_hamil = job.modifier(hamiltonians[job.hamiltonian]);
+			modified_twosites = compute_2sitesHamil(modified_hamil);
 		}
-	}
-	if (oc != init_pos)
-	{
-		if (oc != init_pos - 1 and init_pos != in_out_state.size() - 1)
-			throw std::runtime_error(fmt::format(
-			    "the orthogonality center finished somewhere surprising! final oc: {}. original oc: {}", oc, init_pos));
-	}
-	oc += (oc == 0); // The oc never really finishes at 0 with the current algo.
-	// The leftward sweep finishes with the oc at 1, but set the oc at 0,
-	// such the site 0 and 1 are updated together once by the next rightward sweep.
-	// this trickery is necessary to get this optimization without writing special code in the sweeper.
-	if (oc != init_pos) // then we actually move it back to its origin location.
-		in_out_state.move_oc(init_pos);
-
-	logger.end_log_all(iteration, E0, in_out_state);
-
-	return E0;
+		const bMPO &hamil = job.modifier ? modified_hamil : hamiltonians[job.hamiltonian];
+		const bMPT &twosites = job.modifier ? modified_twosites : twosites_hamils[job.hamiltonian];
+		benv_holder Env;
+		if (job.options.idmrg_warm_start)
+			std::tie(result.state, Env) = idmrg_growth(hamil, job.state_constraint, job.options);
+		else if (job.modifier)
+		{
+			result.state = random_MPS(job.options.minimum_bond, hamil, job.state_constraint);
+			Env = generate_env(hamil, result.state);
+		}
+		else
+		{
+			result.state = random_MPS(job.options.minimum_bond, hamil, job.state_constraint);
+			btensor left_edge, right_edge;
+			{
+				std::lock_guard lock(edges_mutex);
+				auto key = std::make_tuple(job.hamiltonian, job.state_constraint);
+				auto it = shared_edges.find(key);
+				if (it == shared_edges.end())
+					it = shared_edges.emplace(key, trivial_edges(hamil, result.state)).first;
+				std::tie(left_edge, right_edge) = it->second;
+			}
+			Env = generate_env(hamil, result.state, left_edge, right_edge);
+		}
+		result.energy = details::dmrg_impl(hamil, twosites, result.state, job.options, Env, result.logger);
+	};
+	std::atomic<size_t> next_job = 0;
+	concurrent_for(batch_concurrency(max_concurrent_jobs, jobs.size()),
+	               [&](size_t)
+	               {
+		               for (size_t j = next_job++; j < jobs.size(); j = next_job++)
+			               run_job(j);
+	               });
+	return results;
 }
 template <class shape_t>
 auto edge_shape_prep_impl(const shape_t &tens, int64_t dim)
@@ -367,17 +1485,9 @@ btensor details::trivial_edge(const btensor &lower_state, const btensor &Hamil,
 	return trivial_edge_impl(lower_state, Hamil, upper_state, index_low, index_op, index_up);
 }
 
-template <class MPO_T, class MPS_T, class env_hold_T>
-void generate_env_impl(const MPO_T &hamiltonian, const MPS_T &state, env_hold_T &Env)
+template <class MPO_T, class MPS_T>
+auto trivial_edges_impl(const MPO_T &hamiltonian, const MPS_T &state)
 {
-	using MPT_t = typename dependant_tensor_network<MPS_T>::MPT_type;
-	using TEST_MPT_B = typename dependant_tensor_network<MPO_T>::MPT_type;
-	static_assert(std::is_same_v<MPT_t, TEST_MPT_B>, "MPS incompatible with MPO");
-	static_assert(std::is_same_v<typename env_hold_T::Tens, typename MPS_T::Tens>,
-	              "Environment holder incompatible with MPS and MPO");
-
-	Env.env = MPT_t(hamiltonian.size() + 2);
-
 	auto Lstate_shape = edge_shape_prep(state.front(), 0);
 	auto LHam_shape = edge_shape_prep(hamiltonian.front(), 0);
 	auto trivial_Ledge = ones_like(shape_from(Lstate_shape, LHam_shape, Lstate_shape.inverse_cvals()),
@@ -387,8 +1497,26 @@ void generate_env_impl(const MPO_T &hamiltonian, const MPS_T &state, env_hold_T
 	    ones_like(shape_from(Rstate_shape, edge_shape_prep(hamiltonian.back(), 2), Rstate_shape.inverse_cvals()),
 	              torch::TensorOptions().requires_grad(false));
 	// fmt::print("{}\n\n", trivial_Redge);
-	Env[-1] = trivial_Ledge;
-	Env[hamiltonian.size()] = trivial_Redge;
+	return std::make_tuple(trivial_Ledge, trivial_Redge);
+}
+std::tuple<btensor, btensor> trivial_edges(const bMPO &hamiltonian, const bMPS &state)
+{
+	return trivial_edges_impl(hamiltonian, state);
+}
+
+template <class MPO_T, class MPS_T, class env_hold_T, class Tens>
+void generate_env_impl(const MPO_T &hamiltonian, const MPS_T &state, env_hold_T &Env, const Tens &left_edge,
+                       const Tens &right_edge)
+{
+	using MPT_t = typename dependant_tensor_network<MPS_T>::MPT_type;
+	using TEST_MPT_B = typename dependant_tensor_network<MPO_T>::MPT_type;
+	static_assert(std::is_same_v<MPT_t, TEST_MPT_B>, "MPS incompatible with MPO");
+	static_assert(std::is_same_v<typename env_hold_T::Tens, typename MPS_T::Tens>,
+	              "Environment holder incompatible with MPS and MPO");
+
+	Env.env = MPT_t(hamiltonian.size() + 2);
+	Env[-1] = left_edge;
+	Env[hamiltonian.size()] = right_edge;
 	// fmt::print("on the left: \n \t{}\n\n\t{}\n\n\t{}",Env[-1],hamiltonian[0],state[0]);
 	// fmt::print("on the right: \n
 	// \t{}\n\n\t{}\n\n\t{}",Env[hamiltonian.size()],hamiltonian[hamiltonian.size()-1],state[hamiltonian.size()-1]);
@@ -407,6 +1535,12 @@ void generate_env_impl(const MPO_T &hamiltonian, const MPS_T &state, env_hold_T
 		--i;
 	}
 }
+template <class MPO_T, class MPS_T, class env_hold_T>
+void generate_env_impl(const MPO_T &hamiltonian, const MPS_T &state, env_hold_T &Env)
+{
+	auto [trivial_Ledge, trivial_Redge] = trivial_edges_impl(hamiltonian, state);
+	generate_env_impl(hamiltonian, state, Env, trivial_Ledge, trivial_Redge);
+}
 
 env_holder generate_env(const MPO &hamiltonian, const MPS &state)
 {
@@ -420,6 +1554,13 @@ benv_holder generate_env(const bMPO &hamiltonian, const bMPS &state)
 	generate_env_impl(hamiltonian, state, Env);
 	return Env;
 }
+benv_holder generate_env(const bMPO &hamiltonian, const bMPS &state, const btensor &left_edge,
+                         const btensor &right_edge)
+{
+	benv_holder Env;
+	generate_env_impl(hamiltonian, state, Env, left_edge, right_edge);
+	return Env;
+}
 
 template <class Tensor>
 Tensor compute_left_env_impl(const Tensor &Hamil, const Tensor &MPS, const Tensor &left_env)
@@ -500,6 +1641,131 @@ btensor compute_right_env(const btensor &Hamil, const btensor &MPS, const btenso
 	return compute_right_env_impl(Hamil, MPS, right_env);
 }
 
+template <class Tensor>
+Tensor compute_left_overlap_impl(const Tensor &state, const Tensor &reference, const Tensor &left_overlap)
+{
+	/**
+	       ┌─┐ ┌─┐
+	       │ ├─┤R├ 1
+	       │ │ └┬┘
+	out =  │O│  │
+	       │ │ ┌┴┐
+	       │ ├─┤Y├ 0
+	       └─┘ └─┘
+	O = left_overlap, same ordering as out.
+	R = reference, conjugated.
+	Y = state
+ */
+	auto out = tensordot(left_overlap, state, {0}, {0});
+	return tensordot(out, reference.conj(), {0, 1}, {0, 1});
+}
+torch::Tensor compute_left_overlap(const torch::Tensor &state, const torch::Tensor &reference,
+                                   const torch::Tensor &left_overlap)
+{
+	return compute_left_overlap_impl(state, reference, left_overlap);
+}
+btensor compute_left_overlap(const btensor &state, const btensor &reference, const btensor &left_overlap)
+{
+	return compute_left_overlap_impl(state, reference, left_overlap);
+}
+template <class Tensor>
+Tensor compute_right_overlap_impl(const Tensor &state, const Tensor &reference, const Tensor &right_overlap)
+{
+	// Left-right mirror to compute_left_overlap.
+	auto out = tensordot(right_overlap, state, {0}, {2});
+	return tensordot(out, reference.conj(), {0, 2}, {2, 1});
+}
+torch::Tensor compute_right_overlap(const torch::Tensor &state, const torch::Tensor &reference,
+                                    const torch::Tensor &right_overlap)
+{
+	return compute_right_overlap_impl(state, reference, right_overlap);
+}
+btensor compute_right_overlap(const btensor &state, const btensor &reference, const btensor &right_overlap)
+{
+	return compute_right_overlap_impl(state, reference, right_overlap);
+}
+/**
+ * @brief the reference state projected on the local basis of a two sites state, such that the overlap of the
+ * reference with the whole state is the contraction of the conjugated output with the two sites state.
+ */
+template <class Tensor>
+Tensor project_reference_impl(const Tensor &reference_left, const Tensor &reference_right, const Tensor &left_overlap,
+                              const Tensor &right_overlap)
+{
+	auto out = tensordot(left_overlap.conj(), reference_left, {1}, {0});
+	out = tensordot(out, reference_right, {2}, {0});
+	return tensordot(out, right_overlap.conj(), {3}, {1});
+}
+torch::Tensor project_reference(const torch::Tensor &reference_left, const torch::Tensor &reference_right,
+                                const torch::Tensor &left_overlap, const torch::Tensor &right_overlap)
+{
+	return project_reference_impl(reference_left, reference_right, left_overlap, right_overlap);
+}
+btensor project_reference(const btensor &reference_left, const btensor &reference_right, const btensor &left_overlap,
+                          const btensor &right_overlap)
+{
+	return project_reference_impl(reference_left, reference_right, left_overlap, right_overlap);
+}
+
+/**
+ * @brief store the normalized references states and their overlap environments with state in Env.
+ */
+template <class MPS_t, class env_t>
+void set_references(env_t &Env, const MPS_t &state, const std::vector<MPS_t> &references, double weight)
+{
+	using MPT_t = typename dependant_tensor_network<MPS_t>::MPT_type;
+	Env.overlap_weight = weight;
+	Env.references.clear();
+	Env.overlap_env.clear();
+	for (const auto &reference : references)
+	{
+		if (reference.size() != state.size())
+			throw std::invalid_argument(fmt::format("reference state of length {} incompatible with state of length {}",
+			                                        reference.size(), state.size()));
+		auto ref = reference;
+		ref[0] /= sqrt(contract(ref, ref));
+		MPT_t ovlp(state.size() + 2);
+		auto Lstate_shape = edge_shape_prep(state.front(), 0);
+		auto Lref_shape = edge_shape_prep(ref.front(), 0);
+		ovlp[0] = ones_like(shape_from(Lstate_shape, Lref_shape.inverse_cvals()),
+		                    torch::TensorOptions().requires_grad(false));
+		auto Rstate_shape = edge_shape_prep(state.back(), 2);
+		auto Rref_shape = edge_shape_prep(ref.back(), 2);
+		ovlp[state.size() + 1] = ones_like(shape_from(Rstate_shape, Rref_shape.inverse_cvals()),
+		                                   torch::TensorOptions().requires_grad(false));
+		size_t i = 0;
+		for (; i < state.orthogonality_center; ++i)
+			ovlp[i + 1] = compute_left_overlap(state[i], ref[i], ovlp[i]);
+		for (i = state.size() - 1; i > state.orthogonality_center; --i)
+			ovlp[i + 1] = compute_right_overlap(state[i], ref[i], ovlp[i + 2]);
+		Env.references.push_back(std::move(ref));
+		Env.overlap_env.push_back(std::move(ovlp));
+	}
+}
+
+template <class MPO_t, class MPS_t>
+auto excited_dmrg_impl(MPO_t &hamiltonian, MPS_t &in_out_state, const std::vector<MPS_t> &references, double weight,
+                       const dmrg_options &options, dmrg_logger &logger)
+{
+	dmrg_gradient_guard guard(hamiltonian, in_out_state, options);
+	auto Env = generate_env(hamiltonian, in_out_state);
+	set_references(Env, in_out_state, references, weight);
+	auto TwositesH = compute_2sitesHamil(hamiltonian);
+	details::dmrg_impl(hamiltonian, TwositesH, in_out_state, options, Env, logger);
+	// the energy found by the sweeps include the penalty.
+	return contract(in_out_state, in_out_state, hamiltonian);
+}
+btensor excited_dmrg(bMPO &hamiltonian, bMPS &in_out_state, const std::vector<bMPS> &references, double weight,
+                     const dmrg_options &options, dmrg_logger &logger)
+{
+	return excited_dmrg_impl(hamiltonian, in_out_state, references, weight, options, logger);
+}
+torch::Tensor excited_dmrg(MPO &hamiltonian, MPS &in_out_state, const std::vector<MPS> &references, double weight,
+                           const dmrg_options &options, dmrg_logger &logger)
+{
+	return excited_dmrg_impl(hamiltonian, in_out_state, references, weight, options, logger);
+}
+
 template <class MPO_type>
 auto compute_2sitesHamil_impl(const MPO_type &hamil)
 {
@@ -540,6 +1806,24 @@ btensor details::hamil2site_times_state(const btensor &state, const btensor &ham
 	return hamil2site_times_state_impl(state, hamil, Lenv, Renv);
 }
 
+/**
+ * @brief in with value where condition holds. For the rank 0 tensors of the 2x2 problem, the condition has the block
+ * structure of in.
+ */
+torch::Tensor fill_where(const torch::Tensor &in, const torch::Tensor &condition, const torch::Scalar &value)
+{
+	return in.masked_fill(condition, value);
+}
+btensor fill_where(const btensor &in, const btensor &condition, const btensor::Scalar &value)
+{
+	assert(std::distance(in.begin(), in.end()) == std::distance(condition.begin(), condition.end()));
+	btensor out(in);
+	auto cond_it = condition.begin();
+	for (auto it = out.begin(); it != out.end(); ++it, ++cond_it)
+		std::get<1>(*it) = std::get<1>(*it).masked_fill(std::get<1>(*cond_it), value);
+	return out;
+}
+
 template <class Tensor>
 std::tuple<Tensor, Tensor, Tensor> eig2x2Mat_impl(const Tensor &a0, const Tensor &a1, const Tensor &b)
 {
@@ -549,26 +1833,17 @@ std::tuple<Tensor, Tensor, Tensor> eig2x2Mat_impl(const Tensor &a0, const Tensor
 	auto E0 = (a0 + a1 - crit) / 2; // smallest eigenvalue. largest is (a0+a1 +crit)/2
 	// auto E1 = (a0 + a1 + crit) / 2; // smallest eigenvalue. largest is (a0+a1 +crit)/2
 	// fmt::print("E0 {}\n\n",E0);
-	// fmt::print("test!\n E0-a1 {}\n\n -crit {} \n\n(E0-a1)/crit {}",E0-a1, -crit, (E0-a1)/crit); //E0-a1 somehow has
-	// the wrong sign.
 	auto delt = (E0 - a1);
-	auto o_coeff = sqrt(delt / (-crit)); // from arxiv.org/pdf/1908.03795.pdf
-	// fmt::print("O {}\n\n",o_coeff);
-	bool zero_o = (((o_coeff + E0) == E0).item()).toBool() or std::isnan(o_coeff.item().toDouble());
-	auto n_coeff = (b * o_coeff) / (delt); // can't use o^2+n^2 = 1: loose important phase information that way.
-	if (zero_o)
-	{
-		// o_coeff could be nan if crit is zero, this should only happen if the input is proportionnal to the identity
-		// if o_coeff is zero, the computed n_coeff will likely be nan, but must be one.
-		n_coeff = ones_like(n_coeff);
-		o_coeff = zeros_like(o_coeff);
-	}
-	if (o_coeff.isnan().any().item().toBool())
-		throw std::logic_error("nan found in output tensor");
-	if (n_coeff.isnan().any().item().toBool())
-		throw std::logic_error("nan found in output tensor");
-	// wackadoodle conditionnals in previous expression to have 1 instead of a nan when o_coeff is zeros.
-	return std::make_tuple(E0, o_coeff, n_coeff);
+	// The special cases are selected with masks instead of branches, such that no scalar is read back from the tensors,
+	// on any device. Nan checks are left to the caller, once per sweep.
+	// crit is zero if the input is proportionnal to the identity, delt is zero along with o_coeff. Replace those zeros by
+	// ones in the denominators: the numerators are zero as well.
+	auto o_coeff = sqrt((delt / fill_where(crit, eq(crit, 0), 1)).abs()); // from arxiv.org/pdf/1908.03795.pdf
+	auto n_coeff = (b * o_coeff) / fill_where(delt, eq(delt, 0), 1); // can't use o^2+n^2 = 1: loose important phase
+	                                                                   // information that way.
+	// if o_coeff is negligible, n_coeff must be one, whatever was computed.
+	auto zero_o = eq(o_coeff + E0, E0);
+	return std::make_tuple(E0, fill_where(o_coeff, zero_o, 0), fill_where(n_coeff, zero_o, 1));
 }
 std::tuple<torch::Tensor, torch::Tensor, torch::Tensor> details::eig2x2Mat(const torch::Tensor &a0,
                                                                            const torch::Tensor &a1,
@@ -581,11 +1856,13 @@ std::tuple<btensor, btensor, btensor> details::eig2x2Mat(const btensor &a0, cons
 	return eig2x2Mat_impl(a0, a1, b);
 }
 
-template <class Tensor>
-std::tuple<Tensor, Tensor, Tensor, Tensor> one_step_lanczos_impl(const Tensor &state, const Tensor &hamil,
-                                                                 const Tensor &Lenv, const Tensor &Renv)
+/**
+ * @brief one step of lanczos from state, with the effective hamiltonian applied by hamil_times(state).
+ */
+template <class Tensor, class F>
+std::tuple<Tensor, Tensor, Tensor, Tensor> lanczos_step(const Tensor &state, F &&hamil_times)
 {
-	auto psi_ip = hamil2site_times_state(state, hamil, Lenv, Renv);
+	auto psi_ip = hamil_times(state);
 	// fmt::print("psi_ip {}\n",psi_ip);
 	// fmt::print("state {}\n",state);
 	// auto a0 = torch::real(torch::tensordot(psi_ip, state.conj(), {0, 1, 2, 3}, {0, 1, 2, 3}));//real doesn't work if
@@ -594,18 +1871,18 @@ std::tuple<Tensor, Tensor, Tensor, Tensor> one_step_lanczos_impl(const Tensor &s
 	// fmt::print("a0 {}\n",a0);
 	psi_ip -= state * a0;
 	auto b = sqrt((tensordot(psi_ip, psi_ip.conj(), {0, 1, 2, 3}, {0, 1, 2, 3})));
-	const bool non_singular = [&]()
-	{
-		btensor::Scalar X = ge(b.abs(), 1e-15).item();
-		return X.to<bool>();
-	}();
-	if (non_singular)
-		psi_ip /= b;
-	// fmt::print("\t\tnon singular {}\n",non_singular);
-	auto a1 = (tensordot(psi_ip.conj(), quantit::details::hamil2site_times_state(psi_ip, hamil, Lenv, Renv),
-	                     {0, 1, 2, 3}, {0, 1, 2, 3}));
+	// normalize psi_ip unless it vanishes. Done with a mask, such that nothing has to be read back from the device.
+	auto non_singular = ge(b.abs(), 1e-15).to(b.options());
+	psi_ip /= b * non_singular + non_singular.mul(-1).add(1);
+	auto a1 = (tensordot(psi_ip.conj(), hamil_times(psi_ip), {0, 1, 2, 3}, {0, 1, 2, 3}));
 	return std::make_tuple(psi_ip, a0, a1, b);
 }
+template <class Tensor>
+std::tuple<Tensor, Tensor, Tensor, Tensor> one_step_lanczos_impl(const Tensor &state, const Tensor &hamil,
+                                                                 const Tensor &Lenv, const Tensor &Renv)
+{
+	return lanczos_step(state, [&](const Tensor &x) { return hamil2site_times_state(x, hamil, Lenv, Renv); });
+}
 std::tuple<torch::Tensor, torch::Tensor, torch::Tensor, torch::Tensor> details::one_step_lanczos(
     const torch::Tensor &state, const torch::Tensor &hamil, const torch::Tensor &Lenv, const torch::Tensor &Renv)
 {
@@ -620,11 +1897,10 @@ std::tuple<btensor, btensor, btensor, btensor> details::one_step_lanczos(const b
 /**
  * return the energy, and the state. In that order
  */
-template <class Tensor>
-std::tuple<Tensor, Tensor> two_sites_update_impl(const Tensor &state, const Tensor &hamil, const Tensor &Lenv,
-                                                 const Tensor &Renv)
+template <class Tensor, class F>
+std::tuple<Tensor, Tensor> two_sites_update_impl(const Tensor &state, F &&hamil_times)
 {
-	auto [psi_ip, a0, a1, b] = one_step_lanczos(state, hamil, Lenv, Renv);
+	auto [psi_ip, a0, a1, b] = lanczos_step(state, hamil_times);
 	// print("STATE UPDATE\nnorm psi_ip {}\n",
 	//    tensordot(psi_ip, psi_ip.conj(), {0, 1, 2, 3}, {0, 1, 2, 3}).item().toDouble());
 	// fmt::print("Psi_ip {}\n\na0 {}\n\n a1 {}\n\nb
@@ -636,6 +1912,31 @@ std::tuple<Tensor, Tensor> two_sites_update_impl(const Tensor &state, const Tens
 	// fmt::print("psi_up {}\n\n",psi_update);
 	return std::make_tuple(E, psi_update);
 }
+template <class Tensor>
+std::tuple<Tensor, Tensor> two_sites_update_impl(const Tensor &state, const Tensor &hamil, const Tensor &Lenv,
+                                                 const Tensor &Renv)
+{
+	return two_sites_update_impl(state,
+	                             [&](const Tensor &x) { return hamil2site_times_state(x, hamil, Lenv, Renv); });
+}
+/**
+ * @brief two sites update with the hamiltonian penalized by the projectors on the references states:
+ * H + weight * sum_k |ref_k><ref_k|. references are the references states projected on the local basis.
+ */
+template <class Tensor>
+std::tuple<Tensor, Tensor> two_sites_update_impl(const Tensor &state, const Tensor &hamil, const Tensor &Lenv,
+                                                 const Tensor &Renv, const std::vector<Tensor> &references,
+                                                 double weight)
+{
+	return two_sites_update_impl(state,
+	                             [&](const Tensor &x)
+	                             {
+		                             auto out = hamil2site_times_state(x, hamil, Lenv, Renv);
+		                             for (const auto &ref : references)
+			                             out += ref * tensordot(ref.conj(), x, {0, 1, 2, 3}, {0, 1, 2, 3}).mul(weight);
+		                             return out;
+	                             });
+}
 /**
  * return the energy, and the state. In that order
  */
@@ -649,5 +1950,207 @@ std::tuple<btensor, btensor> two_sites_update(const btensor &state, const btenso
 {
 	return two_sites_update_impl(state, hamil, Lenv, Renv);
 }
+std::tuple<torch::Tensor, torch::Tensor> two_sites_update(const torch::Tensor &state, const torch::Tensor &hamil,
+                                                          const torch::Tensor &Lenv, const torch::Tensor &Renv,
+                                                          const std::vector<torch::Tensor> &references, double weight)
+{
+	return two_sites_update_impl(state, hamil, Lenv, Renv, references, weight);
+}
+std::tuple<btensor, btensor> two_sites_update(const btensor &state, const btensor &hamil, const btensor &Lenv,
+                                              const btensor &Renv, const std::vector<btensor> &references,
+                                              double weight)
+{
+	return two_sites_update_impl(state, hamil, Lenv, Renv, references, weight);
+}
+std::tuple<torch::Tensor, torch::Tensor> two_sites_update(const torch::Tensor &state, const sparse_MPO_site &left_hamil,
+                                                          const sparse_MPO_site &right_hamil, const torch::Tensor &Lenv,
+                                                          const torch::Tensor &Renv)
+{
+	return two_sites_update_impl(state, [&](const torch::Tensor &x)
+	                             { return hamil2site_times_state(x, left_hamil, right_hamil, Lenv, Renv); });
+}
+
+/**
+ * @brief exp(coefficient * H) x, with the hermitian H applied by hamil_times, computed in a Krylov subspace.
+ *
+ * The Lanczos vectors are fully reorthogonalized, the subspace is small. The exponential of the projection of H on the
+ * subspace is computed on the CPU at every step, the weight it gives to the next Krylov vector estimates the error.
+ */
+template <class Tensor, class F>
+Tensor krylov_expmv(const Tensor &x, F &&hamil_times, c10::complex<double> coefficient, size_t krylov_dimension,
+                    double tolerance)
+{
+	std::vector<int64_t> dims(x.dim());
+	std::iota(dims.begin(), dims.end(), 0);
+	const auto inner = [&dims](const Tensor &a, const Tensor &b)
+	{ return tensordot(a.conj(), b, dims, dims).item().toComplexDouble(); };
+	// a real state only ever gets real coefficients: the coefficient of the exponential is real in that case.
+	const bool complex_state = c10::isComplexType(c10::typeMetaToScalarType(x.options().dtype()));
+	const auto scalar = [complex_state](c10::complex<double> val)
+	{ return complex_state ? torch::Scalar(val) : torch::Scalar(val.real()); };
+	const double norm = std::sqrt(inner(x, x).real());
+	if (norm == 0)
+		return x;
+	std::vector<Tensor> basis{x / norm};
+	std::vector<double> alpha;
+	std::vector<double> beta;
+	torch::Tensor coefficients;
+	for (size_t j = 0;; ++j)
+	{
+		auto w = hamil_times(basis[j]);
+		alpha.push_back(inner(basis[j], w).real());
+		for (const auto &v : basis)
+			w -= v * scalar(inner(v, w));
+		const double b = std::sqrt(inner(w, w).real());
+		auto krylov_hamil = torch::diag(torch::tensor(alpha, torch::kDouble)) +
+		                    torch::diag(torch::tensor(beta, torch::kDouble), 1) +
+		                    torch::diag(torch::tensor(beta, torch::kDouble), -1);
+		coefficients = torch::matrix_exp(krylov_hamil.to(torch::kComplexDouble) * coefficient).select(1, 0);
+		const double error = b * std::abs(coefficients[j].item().toComplexDouble());
+		if (error < tolerance or b < 1e-14 or j + 1 >= krylov_dimension)
+			break;
+		beta.push_back(b);
+		basis.push_back(w / b);
+	}
+	auto out = basis[0] * scalar(norm * coefficients[0].item().toComplexDouble());
+	for (size_t k = 1; k < basis.size(); ++k)
+		out += basis[k] * scalar(norm * coefficients[k].item().toComplexDouble());
+	return out;
+}
+/**
+ * @brief effective hamiltonian of a single site, index ordering of the state: (a, s, b).
+ */
+template <class Tensor>
+Tensor hamil1site_times_state(const Tensor &state, const Tensor &hamil, const Tensor &Lenv, const Tensor &Renv)
+{
+	auto out = tensordot(Lenv, state, {0}, {0});  // (w, a', s, b)
+	out = tensordot(out, hamil, {0, 2}, {0, 3});   // (a', b, s', w)
+	return tensordot(out, Renv, {1, 3}, {0, 1}); // (a', s', b')
+}
+/**
+ * @brief effective hamiltonian of a bond, between the environments of the sites on each side. Index ordering: (a, b).
+ */
+template <class Tensor>
+Tensor hamil0site_times_state(const Tensor &bond, const Tensor &Lenv, const Tensor &Renv)
+{
+	auto out = tensordot(Lenv, bond, {0}, {0});  // (w, a', b)
+	return tensordot(out, Renv, {0, 2}, {1, 0}); // (a', b')
+}
+
+template <class MPO_t, class MPS_t>
+MPS_t &tdvp_impl(const MPO_t &hamiltonian, MPS_t &state, torch::Scalar dt, size_t steps, const tdvp_options &options,
+                 const std::function<void(size_t, const MPS_t &)> &observer)
+{
+	using Tens = typename MPS_t::Tens;
+	using MPT_t = typename dependant_tensor_network<MPO_t>::MPT_type;
+	if (hamiltonian.size() != state.size())
+		throw std::invalid_argument(
+		    fmt::format("the MPO has {} sites but the state has {}", hamiltonian.size(), state.size()));
+	const size_t length = state.size();
+	if (options.two_sites and length < 2)
+		throw std::invalid_argument("two sites tdvp requires at least two sites");
+	// each sweep evolves by half a time step: exp(-i dt/2 H).
+	const auto dt_c = dt.toComplexDouble();
+	const c10::complex<double> forward(dt_c.imag() / 2, -dt_c.real() / 2);
+	auto type = c10::typeMetaToScalarType(state[0].options().dtype());
+	if (forward.imag() != 0 and not c10::isComplexType(type))
+		type = c10::toComplexType(type);
+	state.to_(type);
+	const MPO_t H = hamiltonian.to(type);
+	state.move_oc(0);
+	auto Env = generate_env(H, state);
+	const MPT_t twosites = options.two_sites ? compute_2sitesHamil(H) : MPT_t();
+	const auto evolve = [&options](const Tens &x, auto &&hamil_times, c10::complex<double> coefficient)
+	{ return krylov_expmv(x, hamil_times, coefficient, options.krylov_dimension, options.krylov_tolerance); };
+	const auto one_site = [&](size_t i)
+	{
+		return [&, i](const Tens &x)
+		{ return hamil1site_times_state(x, H[i], Env[static_cast<int64_t>(i) - 1], Env[i + 1]); };
+	};
+	// truncation of the two sites state that keeps its norm.
+	const auto split = [&options](const Tens &theta)
+	{
+		auto [u, d, v] = quantit::svd(theta, 2, options.cutoff, options.minimum_bond, options.maximum_bond);
+		d *= sqrt((theta * theta.conj()).sum().abs()) / sqrt(sum(d.pow(2)));
+		return std::make_tuple(u, d, v);
+	};
+	for (size_t n = 0; n < steps; ++n)
+	{
+		if (options.two_sites)
+		{
+			for (size_t i = 0; i + 1 < length; ++i)
+			{
+				auto theta = evolve(
+				    tensordot(state[i], state[i + 1], {2}, {0}),
+				    [&](const Tens &x)
+				    { return hamil2site_times_state(x, twosites[i], Env[static_cast<int64_t>(i) - 1], Env[i + 2]); },
+				    forward);
+				auto [u, d, v] = split(theta);
+				state[i] = u;
+				state[i + 1] = v.mul_(d).conj().permute({2, 0, 1});
+				Env[i] = compute_left_env(H[i], state[i], Env[static_cast<int64_t>(i) - 1]);
+				if (i + 2 < length)
+					state[i + 1] = evolve(state[i + 1], one_site(i + 1), -forward);
+			}
+			for (size_t i = length - 1; i > 0; --i)
+			{
+				auto theta = evolve(
+				    tensordot(state[i - 1], state[i], {2}, {0}),
+				    [&](const Tens &x)
+				    { return hamil2site_times_state(x, twosites[i - 1], Env[static_cast<int64_t>(i) - 2], Env[i + 1]); },
+				    forward);
+				auto [u, d, v] = split(theta);
+				state[i - 1] = u.mul_(d);
+				state[i] = v.conj().permute({2, 0, 1});
+				Env[i] = compute_right_env(H[i], state[i], Env[i + 1]);
+				if (i > 1)
+					state[i - 1] = evolve(state[i - 1], one_site(i - 1), -forward);
+			}
+		}
+		else
+		{
+			for (size_t i = 0; i < length; ++i)
+			{
+				state[i] = evolve(state[i], one_site(i), forward);
+				if (i + 1 == length)
+					break;
+				auto [u, d, v] = quantit::svd(state[i], 2);
+				state[i] = u;
+				Env[i] = compute_left_env(H[i], state[i], Env[static_cast<int64_t>(i) - 1]);
+				auto bond = evolve(
+				    v.mul_(d).conj().permute({1, 0}),
+				    [&](const Tens &x) { return hamil0site_times_state(x, Env[i], Env[i + 1]); }, -forward);
+				state[i + 1] = tensordot(bond, state[i + 1], {1}, {0});
+			}
+			for (size_t i = length - 1;; --i)
+			{
+				state[i] = evolve(state[i], one_site(i), forward);
+				if (i == 0)
+					break;
+				auto [u, d, v] = quantit::svd(state[i], 1);
+				state[i] = v.conj().permute({2, 0, 1});
+				Env[i] = compute_right_env(H[i], state[i], Env[i + 1]);
+				auto bond = evolve(
+				    u.mul_(d), [&](const Tens &x) { return hamil0site_times_state(x, Env[i - 1], Env[i]); },
+				    -forward);
+				state[i - 1] = tensordot(state[i - 1], bond, {2}, {0});
+			}
+		}
+		if (observer)
+			observer(n, state);
+	}
+	return state;
+}
+
+MPS &tdvp(const MPO &hamiltonian, MPS &in_out_state, torch::Scalar dt, size_t steps, const tdvp_options &options,
+          const std::function<void(size_t, const MPS &)> &observer)
+{
+	return tdvp_impl(hamiltonian, in_out_state, dt, steps, options, observer);
+}
+bMPS &tdvp(const bMPO &hamiltonian, bMPS &in_out_state, torch::Scalar dt, size_t steps, const tdvp_options &options,
+           const std::function<void(size_t, const bMPS &)> &observer)
+{
+	return tdvp_impl(hamiltonian, in_out_state, dt, steps, options, observer);
+}
 
 } // namespace quantit
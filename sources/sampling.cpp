@@ -0,0 +1,73 @@
+/*
+ * File: sampling.cpp
+ * Project: QuantiT
+ * File Created: Sunday, 18th October 2026 9:14:05 pm
+ * Author: Alexandre Foley (Alexandre.foley@usherbrooke.ca)
+ * Copyright (c) 2026 Alexandre Foley
+ * Licensed under GPL v3
+ */
+
+#include "sampling.h"
+#include <algorithm>
+#include <stdexcept>
+#include <vector>
+
+namespace quantit
+{
+
+namespace
+{
+
+const torch::Tensor &dense(const torch::Tensor &tens) { return tens; }
+torch::Tensor dense(const btensor &tens) { return tens.to_dense(); }
+
+template <class MPS_t>
+torch::Tensor sample_impl(const MPS_t &state, size_t n_samples, size_t batch_size)
+{
+	using namespace torch::indexing;
+	if (state.size() == 0)
+		throw std::invalid_argument("cannot sample an empty MPS");
+	if (batch_size == 0)
+		throw std::invalid_argument("the batch size must be at least 1");
+	// move_oc replaces the tensors of the copy, the input is left untouched.
+	MPS_t canonical(state);
+	canonical.move_oc(0);
+	std::vector<torch::Tensor> sites;
+	sites.reserve(canonical.size());
+	for (const auto &site : canonical)
+		sites.push_back(dense(site));
+	const auto length = static_cast<int64_t>(sites.size());
+	const auto total = static_cast<int64_t>(n_samples);
+	auto out = torch::empty({total, length}, torch::TensorOptions(torch::kInt64).device(sites[0].device()));
+	for (int64_t start = 0; start < total; start += static_cast<int64_t>(batch_size))
+	{
+		const int64_t batch = std::min(static_cast<int64_t>(batch_size), total - start);
+		// left vector of every sample, normalized, index ordering: (sample, bond)
+		auto left = torch::ones({batch, sites[0].size(0)}, sites[0].options());
+		for (int64_t i = 0; i < length; ++i)
+		{
+			auto amplitudes = torch::tensordot(left, sites[i], {1}, {0}); // (sample, s, b)
+			// the sites to the right are right canonical, the norm of the amplitudes is the conditional probability.
+			auto probabilities = amplitudes.abs().square().sum(2); // (sample, s)
+			auto outcome = torch::multinomial(probabilities, 1);   // (sample, 1)
+			out.index_put_({Slice(start, start + batch), i}, outcome.squeeze(1));
+			auto index = outcome.unsqueeze(2).expand({batch, 1, amplitudes.size(2)});
+			auto selected = amplitudes.gather(1, index).squeeze(1); // (sample, b)
+			left = selected / probabilities.gather(1, outcome).sqrt();
+		}
+	}
+	return out;
+}
+
+} // namespace
+
+torch::Tensor sample(const MPS &state, size_t n_samples, size_t batch_size)
+{
+	return sample_impl(state, n_samples, batch_size);
+}
+torch::Tensor sample(const bMPS &state, size_t n_samples, size_t batch_size)
+{
+	return sample_impl(state, n_samples, batch_size);
+}
+
+} // namespace quantit
@@ -0,0 +1,204 @@
+/*
+ * File: sparse_MPO.cpp
+ * Project: QuantiT
+ * File Created: Sunday, 18th October 2026 2:12:05 pm
+ * Author: Alexandre Foley (Alexandre.foley@usherbrooke.ca)
+ * Copyright (c) 2026 Alexandre Foley
+ * Licensed under GPL v3
+ */
+
+#include "sparse_MPO.h"
+#include <fmt/core.h>
+#include <map>
+#include <stdexcept>
+#include <tuple>
+
+namespace quantit
+{
+
+sparse_MPO_site::sparse_MPO_site(const torch::Tensor &tensor, double cutoff)
+    : left_dim(tensor.sizes()[0]), right_dim(tensor.sizes()[2])
+{
+	if (tensor.dim() != 4)
+		throw std::invalid_argument(fmt::format("a MPO tensor must be of rank 4, the supplied tensor is rank {}",
+		                                        tensor.dim()));
+	for (int64_t l = 0; l < left_dim; ++l)
+	{
+		for (int64_t r = 0; r < right_dim; ++r)
+		{
+			auto entry = tensor.select(0, l).select(1, r); // (out, in)
+			auto pivot = entry.abs().argmax().item().toLong();
+			auto coefficient = entry.flatten()[pivot];
+			if (!(coefficient.abs() > cutoff).item().toBool())
+				continue;
+			// operators are stored with their largest element set to one, such that proportionnal operators are
+			// identical.
+			auto op = entry / coefficient;
+			// the tolerance is the one of the dropped entries, a relative tolerance would merge distinct operators.
+			auto known = std::find_if(operators.begin(), operators.end(), [&op, cutoff](const torch::Tensor &other)
+			                          { return torch::allclose(op, other, 0, cutoff); });
+			if (known == operators.end())
+				known = operators.insert(known, op);
+			terms.push_back({l, r, static_cast<size_t>(std::distance(operators.begin(), known)), coefficient.item()});
+		}
+	}
+}
+
+torch::Tensor sparse_MPO_site::to_dense() const
+{
+	if (operators.empty())
+		throw std::logic_error("cannot infer the physical dimension of a sparse MPO tensor without operators");
+	auto out = torch::zeros({left_dim, operators[0].sizes()[0], right_dim, operators[0].sizes()[1]},
+	                        operators[0].options());
+	for (const auto &term : terms)
+		out.select(0, term.left).select(1, term.right).add_(operators[term.op], term.coefficient);
+	return out;
+}
+
+sparse_MPO::sparse_MPO(const MPO &dense, double cutoff)
+{
+	sites.reserve(dense.size());
+	for (const auto &tens : dense)
+		sites.emplace_back(tens, cutoff);
+}
+
+MPO sparse_MPO::to_MPO() const
+{
+	MPO out(size());
+	for (size_t i = 0; i < size(); ++i)
+		out[i] = sites[i].to_dense();
+	return out;
+}
+
+sparse_MPO sparse_MPO::to(torch::ScalarType dtype) const
+{
+	sparse_MPO out(*this);
+	for (auto &site : out.sites)
+		for (auto &op : site.operators)
+			op = op.to(dtype);
+	return out;
+}
+
+torch::Tensor compute_left_env(const sparse_MPO_site &Hamil, const torch::Tensor &MPS, const torch::Tensor &left_env)
+{
+	/**
+	 * Same contraction as the dense case, one term at a time:
+	 * out[b,wr,b'] = sum_terms coeff * L[a,wl,a'] Y[a,s,b] O[s',s] Y*[a',s',b']
+	 * The environment with the state and the full contraction for each (wl,op) pair are computed once.
+	 */
+	std::map<int64_t, torch::Tensor> env_state;
+	std::map<std::tuple<int64_t, size_t>, torch::Tensor> contracted;
+	torch::Tensor out;
+	for (const auto &term : Hamil.terms)
+	{
+		auto key = std::make_tuple(term.left, term.op);
+		auto it = contracted.find(key);
+		if (it == contracted.end())
+		{
+			auto env_state_it = env_state.find(term.left);
+			if (env_state_it == env_state.end())
+				env_state_it =
+				    env_state.emplace(term.left, tensordot(left_env.select(1, term.left), MPS, {0}, {0})).first;
+			auto tmp = tensordot(env_state_it->second, Hamil.operators[term.op], {1}, {1});
+			it = contracted.emplace(key, tensordot(tmp, MPS.conj(), {0, 2}, {0, 1})).first;
+		}
+		if (!out.defined())
+			out = torch::zeros({it->second.sizes()[0], Hamil.right_dim, it->second.sizes()[1]}, it->second.options());
+		out.select(1, term.right).add_(it->second, term.coefficient);
+	}
+	if (!out.defined())
+		out = torch::zeros({MPS.sizes()[2], Hamil.right_dim, MPS.sizes()[2]}, MPS.options());
+	return out;
+}
+
+torch::Tensor compute_right_env(const sparse_MPO_site &Hamil, const torch::Tensor &MPS, const torch::Tensor &right_env)
+{
+	/**
+	 * Left-right mirror to compute_left_env, with same index ordering (no mirroring) for Y and H.
+	 */
+	std::map<int64_t, torch::Tensor> env_state;
+	std::map<std::tuple<int64_t, size_t>, torch::Tensor> contracted;
+	torch::Tensor out;
+	for (const auto &term : Hamil.terms)
+	{
+		auto key = std::make_tuple(term.right, term.op);
+		auto it = contracted.find(key);
+		if (it == contracted.end())
+		{
+			auto env_state_it = env_state.find(term.right);
+			if (env_state_it == env_state.end())
+				env_state_it =
+				    env_state.emplace(term.right, tensordot(right_env.select(1, term.right), MPS, {0}, {2})).first;
+			auto tmp = tensordot(env_state_it->second, Hamil.operators[term.op], {2}, {1});
+			it = contracted.emplace(key, tensordot(tmp, MPS.conj(), {0, 2}, {2, 1})).first;
+		}
+		if (!out.defined())
+			out = torch::zeros({it->second.sizes()[0], Hamil.left_dim, it->second.sizes()[1]}, it->second.options());
+		out.select(1, term.left).add_(it->second, term.coefficient);
+	}
+	if (!out.defined())
+		out = torch::zeros({MPS.sizes()[0], Hamil.left_dim, MPS.sizes()[0]}, MPS.options());
+	return out;
+}
+
+torch::Tensor hamil2site_times_state(const torch::Tensor &state, const sparse_MPO_site &left_hamil,
+                                     const sparse_MPO_site &right_hamil, const torch::Tensor &Lenv,
+                                     const torch::Tensor &Renv)
+{
+	/**
+	 * state index ordering: (a, s1, s2, b). The output has the same ordering.
+	 * The partial products are summed on the middle bond: middle[wm] = sum_terms1 coeff * L[wl] O1 state, of index
+	 * ordering (a', s2, b, s1'). Then the terms of the right site sharing an operator and a right bond element are summed
+	 * before their operator and the right environment are applied.
+	 */
+	std::map<int64_t, torch::Tensor> env_state;
+	std::map<std::tuple<int64_t, size_t>, torch::Tensor> left_products;
+	std::map<int64_t, torch::Tensor> middle;
+	for (const auto &term : left_hamil.terms)
+	{
+		auto key = std::make_tuple(term.left, term.op);
+		auto it = left_products.find(key);
+		if (it == left_products.end())
+		{
+			auto env_state_it = env_state.find(term.left);
+			if (env_state_it == env_state.end())
+				env_state_it = env_state.emplace(term.left, tensordot(Lenv.select(1, term.left), state, {0}, {0})).first;
+			it = left_products.emplace(key, tensordot(env_state_it->second, left_hamil.operators[term.op], {1}, {1}))
+			         .first;
+		}
+		auto middle_it = middle.find(term.right);
+		if (middle_it == middle.end())
+			middle.emplace(term.right, it->second.mul(term.coefficient));
+		else
+			middle_it->second.add_(it->second, term.coefficient);
+	}
+	std::map<std::tuple<size_t, int64_t>, torch::Tensor> right_sums;
+	for (const auto &term : right_hamil.terms)
+	{
+		auto middle_it = middle.find(term.left);
+		if (middle_it == middle.end())
+			continue;
+		auto key = std::make_tuple(term.op, term.right);
+		auto it = right_sums.find(key);
+		if (it == right_sums.end())
+			right_sums.emplace(key, middle_it->second.mul(term.coefficient));
+		else
+			it->second.add_(middle_it->second, term.coefficient);
+	}
+	torch::Tensor out;
+	for (const auto &[key, partial] : right_sums)
+	{
+		auto [op, right] = key;
+		auto tmp = tensordot(partial, right_hamil.operators[op], {1}, {1}); // (a', b, s1', s2')
+		tmp = tensordot(tmp, Renv.select(1, right), {1}, {0});               // (a', s1', s2', b')
+		if (out.defined())
+			out.add_(tmp);
+		else
+			out = tmp;
+	}
+	if (!out.defined())
+		out = torch::zeros_like(state);
+	return out;
+}
+
+} // namespace quantit
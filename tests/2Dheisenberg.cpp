@@ -156,129 +156,38 @@ std::tuple<int, int, std::vector<std::pair<std::array<int, 4>, double>>> string2
 	return std::make_tuple(lbond_size, rbond_size, list);
 }
 
-torch::Tensor make_tensor(std::tuple<int, int, std::vector<std::pair<std::array<int, 4>, double>>> descriptor)
+/**
+ * @brief coordinates, in the index order of the MPO, and values of the elements listed in the descriptor.
+ */
+std::tuple<torch::Tensor, torch::Tensor> coordinates(
+    const std::tuple<int, int, std::vector<std::pair<std::array<int, 4>, double>>> &descriptor)
 {
-	auto lbond = std::get<0>(descriptor);
-	auto rbond = std::get<1>(descriptor);
 	auto &list = std::get<2>(descriptor);
-	auto out = torch::zeros({lbond, 2, rbond, 2});
-	for (auto &ind_coeff : list)
+	const int64_t N = list.size();
+	std::vector<int64_t> indices(4 * N);
+	std::vector<double> values(N);
+	for (int64_t n = 0; n < N; ++n)
 	{
-		auto &ind = std::get<0>(ind_coeff);
-		double coeff = std::get<1>(ind_coeff);
-		out.index_put_({ind[0] - 1, ind[1] - 1, ind[3] - 1, ind[2] - 1}, coeff);
+		auto &[ind, coeff] = list[n];
+		indices[n] = ind[0] - 1;
+		indices[N + n] = ind[1] - 1;
+		indices[2 * N + n] = ind[3] - 1;
+		indices[3 * N + n] = ind[2] - 1;
+		values[n] = coeff;
 	}
-	return out;
+	return std::make_tuple(torch::tensor(indices).reshape({4, N}), torch::tensor(values));
 }
 
-std::vector<torch::indexing::TensorIndex> Tindexing(const quantit::btensor::index_list &in)
+torch::Tensor make_tensor(const std::tuple<int, int, std::vector<std::pair<std::array<int, 4>, double>>> &descriptor)
 {
-	std::vector<torch::indexing::TensorIndex> out(in.size(), 0);
-	for (size_t i = 0; i < in.size(); ++i)
-	{
-		out[i] = in[i];
-	}
+	auto lbond = std::get<0>(descriptor);
+	auto rbond = std::get<1>(descriptor);
+	auto [indices, values] = coordinates(descriptor);
+	auto out = torch::zeros({lbond, 2, rbond, 2});
+	out.index_put_({indices[0], indices[1], indices[2], indices[3]}, values.to(out.options()));
 	return out;
 }
 
-/**
- * @brief guess the missing section sizes and conserved quantity of one dimension of the torch tensor given in input,
- * assuming the first M dimensions and the last N-M-1 are characterized by the input arguments The selection_rule of the
- * output tensor is assumed to be the product of the two input btensor.
- *
- * @param before_missing
- * @param after_missing
- * @param descriptor
- * @return quantit::btensor
- */
-quantit::btensor guess_btensor(const torch::Tensor &tens, const quantit::btensor &before_missing,
-                              const quantit::btensor &after_missing, torch::Scalar cutoff = 1e-16)
-{
-	using namespace quantit;
-	auto mask = tens.abs() > cutoff;
-	assert(before_missing.selection_rule->get().same_type(after_missing.selection_rule->get()));
-	quantit::any_quantity neutral = before_missing.selection_rule->neutral();
-	quantit::any_quantity out_sel_rule = before_missing.selection_rule->get() * after_missing.selection_rule;
-	quantit::btensor::index_list index(tens.dim(), 0);
-	auto sizes = tens.sizes();
-	auto rank = tens.dim();
-	int64_t missing_dim = tens.dim() - after_missing.dim() - 1;
-	std::map<std::tuple<int64_t, quantit::any_quantity>, int64_t>
-	    missing_section_sizes; // any repeat of the int in the tuple key means we've got a non-conserving tensor on our
-	                           // hands
-	// fmt::print("{}\n\n", mask);
-	do
-	{
-		// fmt::print("{}", index);
-		if (mask.index(Tindexing(index)).item().toBool())
-		{
-			auto [block_ind_before, subelement_ind_before] = before_missing.element_index_decompose(
-			    btensor::index_list(index.begin(), index.begin() + before_missing.dim()));
-			auto [block_ind_after, subelement_ind_after] = after_missing.element_index_decompose(
-			    btensor::index_list(index.end() - after_missing.dim(), index.end()));
-			// fmt::print("\n\tblock_ind_before {} block ind after {}\n", block_ind_before, block_ind_after);
-			// fmt::print("\t subelements before {}  subelements after {}\n", subelement_ind_before,
-			// subelement_ind_after);
-			auto cval_before = before_missing.block_quantities(block_ind_before);
-			auto cval_after = after_missing.block_quantities(block_ind_after);
-			// fmt::print("\tcval before {}\n cval after {}", fmt::join(cval_before, ","), fmt::join(cval_after, ","));
-			any_quantity cval = std::accumulate(cval_before.begin(), cval_before.end(), neutral, std::multiplies()) *
-			                    std::accumulate(cval_after.begin(), cval_after.end(), neutral, std::multiplies());
-			cval.inverse_();
-			cval *= out_sel_rule;
-			// fmt::print("\tbond index {} has conserved value {}\n", index[missing_dim], cval);
-			missing_section_sizes[std::make_tuple(index[missing_dim], cval)] += 1;
-		}
-		// else
-		// 	fmt::print("\n");
-		increment_index_right(index, sizes, rank);
-	} while (quantit::any_truth(index));
-	// build the description of the missing dimension. also check for non-conservation
-	quantit::btensor::index_list out_section_sizes;
-	quantit::any_quantity_vector out_cvals(0, neutral);
-	auto max_sect_size = tens.size(missing_dim);
-	out_section_sizes.reserve(max_sect_size);
-	out_cvals.reserve(max_sect_size);
-	if (missing_section_sizes.size())
-	{
-		auto next = missing_section_sizes.begin();
-
-		auto it = next++;
-		int section_size = 0;
-		for (; it != missing_section_sizes.end(); ++it, ++next)
-		{
-			auto &key = std::get<0>(*it);
-			if (next != missing_section_sizes.end())
-			{
-				auto &next_key = std::get<0>(*next);
-				auto &next_cval = std::get<1>(*next);
-				if (std::get<0>(next_key) == std::get<0>(key) and next_key != key)
-					throw std::logic_error(fmt::format(
-					    "the input tensor cannot be conserving with the candidate shape.\n{}\nincompatible with\n{}",
-					    key, next_key));
-				bool same_section =
-				    std::get<1>(next_key) == std::get<1>(key) and !(std::get<0>(next_key) == std::get<0>(key));
-				section_size += same_section;
-				if (!same_section)
-				{
-					out_section_sizes.emplace_back(section_size + 1);
-					out_cvals.push_back((std::get<1>(key)));
-					section_size = 0;
-				}
-			}
-			else
-			{
-				out_section_sizes.emplace_back(section_size + 1);
-				out_cvals.push_back((std::get<1>(key)));
-			}
-		}
-	}
-	auto missing_side = quantit::btensor({static_cast<int64_t>(out_section_sizes.size())}, out_cvals, out_section_sizes,
-	                                    neutral, before_missing.options());
-	return from_basic_tensor_like(shape_from(before_missing, missing_side, after_missing), tens, cutoff,
-	                              before_missing.options());
-}
-
 int main()
 {
 	torch::set_num_threads(2);
@@ -290,11 +199,14 @@ int main()
 	                          "**"); // don't run the tests. with this qtt_CHECKS, qtt_REQUIRES, etc. should work
 	                                 // outside test context. not that i want to do that.
 	using namespace quantit;
+	std::vector<std::tuple<int, int, std::vector<std::pair<std::array<int, 4>, double>>>> descriptors;
+	for (const auto &mpo_string : mpo_strings)
+		descriptors.push_back(string2structure(mpo_string));
 	quantit::MPO heis(32);
 	int i = 0;
 	for (auto &tens : heis)
 	{
-		tens = make_tensor(string2structure(mpo_strings[i]));
+		tens = make_tensor(descriptors[i]);
 		++i;
 	}
 	quantit::bMPO bheis(32);
@@ -306,14 +218,21 @@ int main()
 	for (auto &tens : bheis)
 	{
 		// fmt::print("site {}\n\tleft bond {}\n\n",i, leftbond);
-		auto before_missing = shape_from(leftbond, phys);
-		tens = guess_btensor(heis[i], before_missing, physdag, 1e-4);
+		// the right bond is the missing dimension, its sections are inferred from the elements.
+		auto partial_shape = shape_from(leftbond, phys, physdag).set_selection_rule_(any_quantity(cval(0)));
+		auto [indices, values] = coordinates(descriptors[i]);
+		tens = from_coo(indices, values, partial_shape, 2, std::get<1>(descriptors[i]), 1e-4);
 		auto rightbond = tens.shape_from({0, 0, -1, 0}).set_selection_rule_(any_quantity(cval(0)));
 		// fmt::print("\tright bond {}\n\n", rightbond);
 		leftbond = rightbond.conj();
 		++i;
 	}
 	bheis.coalesce();
+	// the MPO read from the files has a redundant bond dimension.
+	fmt::print("MPO bond dimension at the middle: {}", bheis[16].sizes()[0]);
+	compress(bheis, 1e-13);
+	compress(heis, 1e-13);
+	fmt::print(", {} after compression\n", bheis[16].sizes()[0]);
 	quantit::dmrg_options dmrg_opt;
 	dmrg_opt.maximum_bond = 1000;
 	dmrg_opt.maximum_iterations = 50;
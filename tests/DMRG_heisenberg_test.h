@@ -96,6 +96,38 @@ auto Heisen_afm_test_tt(size_t size)
 	// }
 	// if (size >=4)	fmt::print("bulk hamiltonian tensor\n {}\n\n", hamil[3].permute({0,2,1,3}));
 };
+/**
+ * @brief time the real-space parallel dmrg on the heisenberg chain for 1, 2, 4, ... up to max_segments segments and
+ * report the speed-up relative to the single segment run.
+ */
+auto Heisen_afm_parallel_speedup_bt(size_t size, size_t max_segments)
+{
+	using cval = quantit::quantity<quantit::conserved::Z>;
+	quantit::btensor local_heisenberg_shape({{{1, cval(1)}, {1, cval(-1)}}}, cval(0));
+	int J = -1.;
+	fmt::print("{:=^80}\n", "Btensors real-space parallel dmrg");
+	std::string print_string =
+	    "{} sites AFM heisenberg, {} segments: Energy per sites {:.15}. obtained in {} seconds, speed-up {:.3}\n";
+	auto hamil = quantit::Heisenberg(torch::tensor(J), size, local_heisenberg_shape);
+	hamil.coalesce();
+	double reference_time = 0;
+	for (size_t segments = 1; segments <= max_segments; segments *= 2)
+	{
+		quantit::bMPS state = quantit::random_bMPS(4, hamil, cval(size % 2), {}, 0);
+		state[0] /= sqrt(contract(state, state));
+		state.move_oc(state.size() - 1);
+		state.move_oc(0);
+		quantit::dmrg_options options;
+		auto start = std::chrono::steady_clock::now();
+		auto E0 = quantit::parallel_dmrg(hamil, state, segments, options);
+		auto end = std::chrono::steady_clock::now();
+		std::chrono::duration<double> elapsed_seconds = end - start;
+		if (segments == 1)
+			reference_time = elapsed_seconds.count();
+		fmt::print(print_string, size, segments, E0.item().to<double>() / size, elapsed_seconds.count(),
+		           reference_time / elapsed_seconds.count());
+	}
+};
 qtt_TEST_CASE("Solving the heisenberg model")
 {
 	torch::InferenceMode Inference_guard;
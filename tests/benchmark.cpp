@@ -114,6 +114,7 @@ int main()
 		Heisen_afm_test_tt(50);
 		Heisen_afm_test_tt(50);
 		Heisen_afm_test_tt(50);
+		Heisen_afm_parallel_speedup_bt(200, 4);
 		// Heisen_afm_test_tt(50);
 		// Heisen_afm_test_tt(50);
 		// Heisen_afm_test_tt(50);
@@ -18,12 +18,18 @@
 #include "Conserved/Composite/cquantity.h"
 #include "Conserved/Composite/quantity_vector.h"
 #include "LinearAlgebra.h"
+#include "auto_MPO.h"
 #include "MPT.h"
+#include "MPO_apply.h"
 #include "blockTensor/btensor.h"
 #include "blockTensor/flat_map.h"
+#include "correlations.h"
+#include "sampling.h"
+#include "checkpoint.h"
 #include "dimension_manip.h"
 #include "dmrg.h"
 #include "models.h"
 #include "operators.h"
+#include "sparse_MPO.h"
 #include "tensorgdot.h"
 #include "blockTensor/LinearAlgebra.h"
\ No newline at end of file